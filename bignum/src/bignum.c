@@ -1,14 +1,98 @@
+#include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 
 #include "bignum.h"
+#include "pool.h"
+#include "stats.h"
+#include "probes.h"
+#include "memory.h"
+#include "cpu.h"
 
-/*@out@*/ void * smalloc ( size_t t )
+#ifdef BIGNUM_PROBES
+// raised by tracers attached to the probes in probes.h
+unsigned short bignum_multiply_semaphore __attribute__((section(".probes")));
+unsigned short bignum_divide_semaphore __attribute__((section(".probes")));
+unsigned short bignum_tostring_semaphore __attribute__((section(".probes")));
+unsigned short bignum_fromstring_semaphore __attribute__((section(".probes")));
+unsigned short bignum_alloc_semaphore __attribute__((section(".probes")));
+#endif
+
+///
+/// Allocates one node of a bit list.
+///
+static Bit * bit_new ( void )
+{
+  Bit * bit = _bigint_alloc_owned ( sizeof ( Bit ) );
+
+  STATS_ALLOC ( sizeof ( Bit ) );
+  return bit;
+}
+
+///
+/// Releases one node of a bit list.
+///
+static void bit_delete ( Bit * const bit )
+{
+  STATS_FREE ( sizeof ( Bit ) );
+  _bigint_free_owned ( bit, sizeof ( Bit ) );
+}
+
+///
+/// @return Whether a BigInt's bit list is shared with a copy, and must be
+/// unshared before it is modified
+///
+static inline bool is_shared ( BigInt const * const bi )
+{
+  return bi->refs && __atomic_load_n ( bi->refs, __ATOMIC_ACQUIRE ) > 1;
+}
+
+///
+/// Gives a BigInt about to get its first bit the share count its list will
+/// carry, so that bigint_copy() never has to add one to its original.
+///
+static void refs_attach ( BigInt * const bi )
+{
+  bi->refs = _bigint_alloc_owned ( sizeof*bi->refs );
+  *bi->refs = 1;
+}
+
+///
+/// bigint_reserve() without a guard, for operations that size their result:
+/// running out of memory unwinds through the caller.
+///
+static void reserve_bits ( BigInt * const bi, int const bits )
+{
+  // a shared list is about to be copied anyway, and only owned nodes count
+  if ( is_shared ( bi ) ) _bigint_unshare ( bi );
+  if ( !bi->refs && bits > 0 ) refs_attach ( bi );
+
+  while ( bi->count + bi->reserved < bits )
+  {
+    Bit * bit = bit_new ( );
+
+    bit->next = bi->spare;
+    bi->spare = bit;
+    bi->reserved ++;
+  }
+}
+
+///
+/// Takes a node for a BigInt about to grow: one set aside by
+/// bigint_reserve() if there is any, otherwise a new one.
+///
+static Bit * bit_take ( BigInt * const bi )
 {
-  void * x = malloc ( t );
-  if ( x ) return x;
-  else exit(EXIT_FAILURE);
+  Bit * bit = bi->spare;
+
+  if ( !bit ) return bit_new ( );
+
+  bi->spare = bit->next;
+  bi->reserved --;
+
+  return bit;
 }
 
 ///
@@ -19,15 +103,71 @@
 ///
 BigInt * bigint_init_empty ( void )
 {
-  BigInt * b = smalloc(sizeof*b);
+  MEMORY_GUARD ( NULL );
+
+  BigInt * b = _bigint_alloc_bigint ( );
 
   b->count = 0;
   b->msb = b->lsb = NULL;
   b->positive = true;
+  b->refs = NULL;
+  b->spare = NULL;
+  b->reserved = 0;
 
   return b;
 }
 
+///
+/// Gives a BigInt a bit list of its own before it is modified. A list shared
+/// by bigint_copy() is duplicated unless every other sharer has let go of it.
+///
+/// @param bi The BigInt about to be modified
+///
+void _bigint_unshare ( BigInt * const bi )
+{
+  int * refs = bi->refs;
+  Bit * old = bi->lsb, * next;
+  BigInt * copy;
+
+  if ( !is_shared ( bi ) ) return;
+
+  // copy on the side, so that bi still holds its share if memory runs out;
+  // the copy grows into bi's reserve and hands back what is left of it
+  copy = bigint_init_empty ( );
+  copy->spare = bi->spare;
+  copy->reserved = bi->reserved;
+  bi->spare = NULL;
+  bi->reserved = 0;
+
+  reserve_bits ( copy, bi->count );
+
+  for ( next = old; next; next = next->next )
+  {
+    append_bit ( copy, next->bit );
+  }
+
+  // the copy's list came with a share count of its own
+  bi->lsb = copy->lsb;
+  bi->msb = copy->msb;
+  bi->refs = copy->refs;
+  bi->spare = copy->spare;
+  bi->reserved = copy->reserved;
+  copy->lsb = copy->msb = copy->spare = NULL;
+  copy->refs = NULL;
+  _bigint_free_bigint ( copy );
+
+  // the other sharers may have let go while the list was being copied
+  if ( __atomic_sub_fetch ( refs, 1, __ATOMIC_ACQ_REL ) == 0 )
+  {
+    _bigint_free_owned ( refs, sizeof*refs );
+    for ( ; old; old = next )
+    {
+      next = old->next;
+      bit_delete ( old );
+    }
+  }
+}
+
 ///
 /// Removes and returns a BigInt's MSB.
 ///
@@ -35,10 +175,15 @@ BigInt * bigint_init_empty ( void )
 ///
 /// @return The value of the BigInt's MSB prior to removal
 ///
+/// This allocates only to unshare a copied list; see append_bit() about
+/// running out of memory.
+///
 bool bigint_pop_msb ( BigInt * const bi )
 {
   bool out = false;
 
+  if ( is_shared ( bi ) ) _bigint_unshare ( bi );
+
   if ( bi->msb )
   {
     Bit * new_msb = bi->msb->prev;
@@ -47,10 +192,14 @@ bool bigint_pop_msb ( BigInt * const bi )
     {
       new_msb->next = NULL;
     }
+    else
+    {
+      bi->lsb = NULL;
+    }
 
     out = bi->msb->bit;
 
-    free ( bi->msb );
+    bit_delete ( bi->msb );
     bi->msb = new_msb;
     bi->count --;
   }
@@ -65,10 +214,14 @@ bool bigint_pop_msb ( BigInt * const bi )
 ///
 /// @return The value of the BigInt's LSB prior to shifting/popping.
 ///
+/// See bigint_pop_msb().
+///
 bool bigint_pop_lsb ( BigInt * const bi )
 {
   bool out = false;
 
+  if ( is_shared ( bi ) ) _bigint_unshare ( bi );
+
   if ( bi->lsb )
   {
     Bit * new_lsb = bi->lsb->next;
@@ -77,10 +230,14 @@ bool bigint_pop_lsb ( BigInt * const bi )
     {
       new_lsb->prev = NULL;
     }
+    else
+    {
+      bi->msb = NULL;
+    }
 
     out = bi->lsb->bit;
 
-    free ( bi->lsb );
+    bit_delete ( bi->lsb );
     bi->lsb = new_lsb;
     bi->count --;
   }
@@ -94,9 +251,20 @@ bool bigint_pop_lsb ( BigInt * const bi )
 /// @param bi The BigInt being extended
 /// @param b The bit extending bi
 ///
+/// The bit primitives run once per bit inside the library's operations, so
+/// they leave running out of memory to the guard of the operation calling
+/// them. Called directly, outside any operation, running out ends the
+/// process whatever the mode set by bigint_set_oom_mode(); a bigint_reserve()
+/// beforehand, which can fail safely, leaves them nothing to allocate.
+///
 void append_bit ( BigInt * const bi, bool const b )
 {
-  Bit * bit = smalloc(sizeof*bit);
+  Bit * bit;
+
+  if ( is_shared ( bi ) ) _bigint_unshare ( bi );
+  if ( !bi->refs ) refs_attach ( bi );
+
+  bit = bit_take ( bi );
 
   bi->count ++;
 
@@ -117,26 +285,40 @@ void append_bit ( BigInt * const bi, bool const b )
 }
 
 ///
-/// Creates a new BigInt with the same value as an existing BigInt.
+/// Creates a new BigInt with the same value as an existing BigInt. This takes
+/// constant time: the two share one bit list, and whichever is modified first
+/// gets a private copy of it then.
 ///
 /// @param a The BigInt to copy.
 ///
 /// @return A pointer to a new BigInt with the same value as the parameter.
-/// This is a separate copy and must be freed with bigint_free().
-/// 
+/// This behaves as a separate copy and must be freed with bigint_free().
+///
 BigInt * bigint_copy ( BigInt const * const a )
 {
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( a->count );
   BigInt * b = bigint_init_empty ( );
-  Bit const * current = a->lsb;
 
   b->positive = a->positive;
 
-  while ( current )
+  if ( !a->lsb )
   {
-    append_bit ( b, current->bit );
-    current = walk_toward_msb ( current, 1 );
+    STATS_END ( BIGINT_OP_COPY );
+    return b;
   }
 
+  // a list has carried its share count since its first bit, so the copy
+  // only adds to the count, which a does not own, and a itself is untouched
+  __atomic_add_fetch ( a->refs, 1, __ATOMIC_ACQ_REL );
+
+  b->count = a->count;
+  b->lsb = a->lsb;
+  b->msb = a->msb;
+  b->refs = a->refs;
+
+  STATS_END ( BIGINT_OP_COPY );
   return b;
 }
 
@@ -146,9 +328,16 @@ BigInt * bigint_copy ( BigInt const * const a )
 /// @param bi The BigInt being shifted and receiving a new LSB
 /// @param b The value of the BigInt's new LSB
 ///
+/// See append_bit() about running out of memory.
+///
 void prepend_bit ( BigInt * const bi, bool b )
 {
-  Bit * bit = smalloc(sizeof*bit);
+  Bit * bit;
+
+  if ( is_shared ( bi ) ) _bigint_unshare ( bi );
+  if ( !bi->refs ) refs_attach ( bi );
+
+  bit = bit_take ( bi );
 
   bit->bit = b;
   bi->count ++;
@@ -176,6 +365,8 @@ void prepend_bit ( BigInt * const bi, bool b )
 ///
 BigInt * bigint_init ( int i )
 {
+  MEMORY_GUARD ( NULL );
+
   BigInt * bi = bigint_init_empty ( );
 
   if ( i < 0 )
@@ -202,15 +393,32 @@ BigInt * bigint_init ( int i )
 void bigint_free_innards ( BigInt * const bi )
 {
   Bit * next;
+
+  if ( bi->refs )
+  {
+    // the last sharer to let go frees the list
+    if ( __atomic_sub_fetch ( bi->refs, 1, __ATOMIC_ACQ_REL ) == 0 )
+    {
+      _bigint_free_owned ( bi->refs, sizeof*bi->refs );
+    }
+    else
+    {
+      bi->lsb = NULL;
+    }
+    bi->refs = NULL;
+  }
+
   while ( bi->lsb )
   {
     next = bi->lsb->next;
-    free ( bi->lsb );
+    bit_delete ( bi->lsb );
     bi->lsb = next;
   }
   bi->msb = NULL;
   bi->count = 0;
   bi->positive = true;
+
+  bigint_shrink_to_fit ( bi );
 }
 
 ///
@@ -221,7 +429,76 @@ void bigint_free_innards ( BigInt * const bi )
 void bigint_free ( BigInt * const bi )
 {
   if ( bi ) bigint_free_innards ( bi );
-  free ( bi );
+  _bigint_free_bigint ( bi );
+}
+
+///
+/// Creates a zero BigInt with room to grow to a number of bits without
+/// allocating. See bigint_reserve().
+///
+/// @param bits The capacity wanted
+///
+/// @return A new BigInt. Must be freed with bigint_free().
+///
+BigInt * bigint_init_reserve ( int const bits )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigInt * bi = bigint_init_empty ( );
+
+  reserve_bits ( bi, bits );
+
+  return bi;
+}
+
+///
+/// Sets aside nodes so that a BigInt can grow to a number of bits without
+/// allocating. Each bit is a node of its own, so the nodes are the same ones
+/// growth would allocate, but taken in one pass up front: operations that
+/// know their result size reserve it before changing anything, and a long
+/// accumulation need not allocate at all. A BigInt sharing its bits with a
+/// copy takes its own first. The nodes are kept until bigint_shrink_to_fit()
+/// or bigint_free().
+///
+/// @param bi The BigInt to grow
+/// @param bits The capacity wanted
+///
+/// @return false if memory ran out (see bigint_set_oom_mode()), in which case
+/// the nodes already set aside are kept
+///
+bool bigint_reserve ( BigInt * const bi, int const bits )
+{
+  MEMORY_GUARD ( false );
+
+  reserve_bits ( bi, bits );
+
+  return true;
+}
+
+///
+/// Releases the nodes a BigInt has set aside for growth.
+///
+/// @param bi The BigInt
+///
+void bigint_shrink_to_fit ( BigInt * const bi )
+{
+  while ( bi->spare )
+  {
+    Bit * next = bi->spare->next;
+    bit_delete ( bi->spare );
+    bi->spare = next;
+  }
+  bi->reserved = 0;
+}
+
+///
+/// @param bi The BigInt
+///
+/// @return The number of bits a BigInt can hold without allocating
+///
+int bigint_capacity ( BigInt const * const bi )
+{
+  return bi->count + bi->reserved;
 }
 
 ///
@@ -377,6 +654,10 @@ void single_bit_add_in_place ( bool * const a, bool B, bool * const carry )
 ///
 void bigint_add_in_place ( BigInt * const A, BigInt const * const B )
 {
+  MEMORY_GUARD ( );
+
+  STATS_BEGIN ( (uint64_t)A->count + B->count );
+
   if ( A == B || bigint_compare ( A, B ) == 0 )
   {
     bigint_shift_left ( A, 1 );
@@ -428,6 +709,8 @@ void bigint_add_in_place ( BigInt * const A, BigInt const * const B )
       _real_bigint_add_in_place ( A, B );
     }
   }
+
+  STATS_END ( BIGINT_OP_ADD );
 }
 
 ///
@@ -438,11 +721,19 @@ void bigint_add_in_place ( BigInt * const A, BigInt const * const B )
 ///
 void _real_bigint_add_in_place ( BigInt * const augend, BigInt const * const addend )
 {
+  MEMORY_GUARD ( );
+
   bool carry = false;
 
   Bit * a;
   Bit const * b;
 
+  if ( is_shared ( augend ) ) _bigint_unshare ( augend );
+
+  // the sum has at most one bit more than the longer operand; taking the
+  // nodes first means the loops below cannot fail halfway through
+  reserve_bits ( augend, MAX2 ( augend->count, addend->count ) + 1 );
+
   a = augend->lsb;
   b = addend->lsb;
 
@@ -483,10 +774,16 @@ void _real_bigint_add_in_place ( BigInt * const augend, BigInt const * const add
 ///
 void bigint_shift_right ( BigInt * const a, int count )
 {
+  MEMORY_GUARD ( );
+
+  STATS_BEGIN ( a->count );
+
   for ( ; count > 0; count -- )
   {
     bigint_pop_lsb ( a );
   }
+
+  STATS_END ( BIGINT_OP_SHIFT );
 }
 
 ///
@@ -498,10 +795,18 @@ void bigint_shift_right ( BigInt * const a, int count )
 ///
 void bigint_shift_left ( BigInt * const a, int count )
 {
+  MEMORY_GUARD ( );
+
+  STATS_BEGIN ( a->count );
+
+  reserve_bits ( a, a->count + count );
+
   for ( ; count > 0; count -- )
   {
     prepend_bit ( a, false );
   }
+
+  STATS_END ( BIGINT_OP_SHIFT );
 }
 
 ///
@@ -517,6 +822,9 @@ void bigint_shallow_copy ( BigInt * const a, BigInt const * const b )
   a->lsb = b->lsb;
   a->msb = b->msb;
   a->positive = b->positive;
+  a->refs = b->refs;
+  a->spare = b->spare;
+  a->reserved = b->reserved;
 }
 
 ///
@@ -534,153 +842,481 @@ void bigint_swap ( BigInt * const a, BigInt * const b )
 }
 
 ///
-/// Multiply two BigInts
+/// Transfers a BigInt's value to another, leaving the source zero. Whatever
+/// the destination held is released; no bits are copied.
+///
+/// @param dst The BigInt receiving the value
+/// @param src The BigInt giving up its value
+///
+void bigint_move ( BigInt * const dst, BigInt * const src )
+{
+  if ( dst == src ) return;
+
+  bigint_free_innards ( dst );
+  bigint_shallow_copy ( dst, src );
+
+  src->count = 0;
+  src->lsb = src->msb = src->spare = NULL;
+  src->positive = true;
+  src->refs = NULL;
+  src->reserved = 0;
+}
+
+///
+/// Multiplies the magnitudes of two BigInts by the shift-add method. The loop
+/// runs over the bits of the shorter operand.
 ///
 /// @param a One multiplicand
 /// @param b Another multiplicand
 ///
-/// @return A new BigInt containing the product of a and b. Must be freed with
+/// @return A new non-negative BigInt containing |a|*|b|. Must be freed with
 /// bigint_free()
 ///
-BigInt * bigint_multiply ( BigInt const * const a, BigInt const * const b )
+BigInt * _bigint_multiply_schoolbook ( BigInt const * const a, BigInt const * const b )
 {
-  // shift-add method
-  BigInt * product, *tmp;
-  Bit * current;
+  MEMORY_GUARD ( NULL );
+
+  BigInt * product, * tmp;
+  Bit const * current;
+
+  if ( a->count < b->count ) return _bigint_multiply_schoolbook ( b, a );
 
   product = bigint_init_empty ( );
 
   // if a is equal to zero
   if ( a->count == 0 ) return product;
 
+  // the product has at most as many bits as the operands together, and the
+  // shifted copy of a reaches the same length
+  reserve_bits ( product, a->count + b->count );
+
   tmp = bigint_copy ( a );
-  for ( current = b->lsb; current; current = current->next )
+  tmp->positive = true;
+  reserve_bits ( tmp, a->count + b->count );
+  for ( current = b->lsb; current; current = walk_toward_msb ( current, 1 ) )
   {
     if ( current->bit )
     {
-      bigint_add_in_place ( product, tmp );
+      _real_bigint_add_in_place ( product, tmp );
     }
     bigint_shift_left ( tmp, 1 );
   }
 
   bigint_free ( tmp );
 
-  product->positive = ( a->positive == b->positive );
+  _bigint_remove_high_zeroes ( product );
+  bigint_shrink_to_fit ( product );
 
   return product;
 }
 
 ///
-/// Determine a BigInt's sign
+/// Arguments and result of one sub-product computed on the thread pool.
 ///
-/// @param a The BigInt whose sign to check
+typedef struct _tag_multiply_job
+{
+  BigInt const * a, * b;
+  BigInt * product;
+} MultiplyJob;
+
 ///
-/// @return true if a is positive; false if a is negative; undefined if a is
-/// zero
+/// Thread pool entry point computing one sub-product.
 ///
-bool bigint_positive ( BigInt const * const a )
+/// @param arg The MultiplyJob to compute
+///
+static void multiply_job_run ( void * arg )
 {
-  return a->positive;
+  MultiplyJob * job = arg;
+  job->product = _bigint_multiply_karatsuba ( job->a, job->b );
 }
 
 ///
-/// Compute the sum of two BigInts
-///
-/// @param a First addend
-/// @param b Second addend
+/// Computes two products, on separate threads when the operands are large
+/// enough to be worth it.
 ///
-/// @return New BigInt whose value is the sum of first and second addend; must
-/// be freed with bigint_free()
+/// @param job0 The first product to compute
+/// @param job1 The second product to compute
 ///
-BigInt * bigint_add ( BigInt const * const a, BigInt const * const b )
+static void multiply_pair ( MultiplyJob * const job0, MultiplyJob * const job1 )
 {
-  BigInt * sum = bigint_copy ( a );
-  bigint_add_in_place ( sum, b );
-  return sum;
+  if ( job0->a->count + job0->b->count >= BIGINT_PARALLEL_THRESHOLD
+      && _bigint_pool_size ( ) > 1 )
+  {
+    BigIntTask task = { multiply_job_run, job1, 0 };
+    _bigint_task_spawn ( &task );
+    multiply_job_run ( job0 );
+    _bigint_task_join ( &task );
+  }
+  else
+  {
+    multiply_job_run ( job0 );
+    multiply_job_run ( job1 );
+  }
 }
 
 ///
-/// Performs an in-place single-bit subtraction, updating the minuend and
-/// borrow flag.
-///
-/// @param a The address of the minuend
-/// @param B The value of the subtrahend
-/// @param borrow The address of the borrow flag. If NULL, borrow is assumed to
-/// be unset and not updated.
+/// Copies bits [lsb,msb) of a BigInt's magnitude into a new, normalized,
+/// non-negative BigInt.
 ///
-void single_bit_subtract_in_place ( bool * const a, bool const B, bool * const borrow )
+static BigInt * magnitude_slice ( BigInt const * const a, int const lsb, int const msb )
 {
-  bool A, Borrow;
-
-  A = *a;
-  Borrow = borrow ? *borrow : false;
-
-  *a = A ^ B ^ Borrow;
-  if ( borrow ) *borrow = (Borrow & ~A) | (Borrow & B) | (~Borrow & ~A & B);
+  BigInt * out = bigint_binary_slice ( a, lsb, msb );
+  out->positive = true;
+  _bigint_remove_high_zeroes ( out );
+  return out;
 }
 
 ///
-/// Subtracts one BigInt from another, storing the result in the minuend. Calls
-/// are made to _real_bigint_add_in_place or _real_big_int_subtract_in_place
-/// depending on the signs and relative magnitudes of the arguments.
+/// Multiplies the magnitudes of two BigInts by Karatsuba's method, falling
+/// back to _bigint_multiply_schoolbook below BIGINT_KARATSUBA_THRESHOLD bits.
+/// Above BIGINT_PARALLEL_THRESHOLD bits the independent sub-products are run
+/// on the thread pool.
 ///
-/// @param A The address of the minuend
-/// @param B The address of the subtrahend
+/// @param a One multiplicand
+/// @param b Another multiplicand
 ///
-void bigint_subtract_in_place ( BigInt * const A, BigInt const * const B )
+/// @return A new non-negative BigInt containing |a|*|b|. Must be freed with
+/// bigint_free()
+///
+BigInt * _bigint_multiply_karatsuba ( BigInt const * const a, BigInt const * const b )
 {
-  if ( A == B || bigint_compare ( A, B ) == 0 )
+  MEMORY_GUARD ( NULL );
+
+  int half;
+  BigInt * a0, * a1, * product;
+
+  if ( a->count < b->count ) return _bigint_multiply_karatsuba ( b, a );
+
+  if ( b->count < BIGINT_KARATSUBA_THRESHOLD )
   {
-    bigint_free_innards ( A );
+    return _bigint_multiply_schoolbook ( a, b );
+  }
+
+  half = a->count / 2;
+  a0 = magnitude_slice ( a, 0, half );
+  a1 = magnitude_slice ( a, half, a->count );
+
+  if ( b->count <= half )
+  {
+    // unbalanced: a*b = a1*b<<half + a0*b
+    MultiplyJob low = { a0, b, NULL }, high = { a1, b, NULL };
+
+    multiply_pair ( &high, &low );
+
+    product = high.product;
+    reserve_bits ( product, a->count + b->count + 1 );
+    bigint_shift_left ( product, half );
+    _real_bigint_add_in_place ( product, low.product );
+
+    bigint_free ( low.product );
   }
   else
   {
-    if ( A->positive )
-    {
-      if ( B->positive )
-      {
-        if ( bigint_compare_magnitude ( A, B ) > 0 )
-        {
-          _real_bigint_subtract_in_place ( A, B );
-        }
-        else
-        {
-          BigInt * b = bigint_copy ( B );
-          _real_bigint_subtract_in_place ( b, A );
-          bigint_swap ( b, A );
-          A->positive = false;
-          bigint_free ( b );
-        }
-      }
-      else
-      {
-        _real_bigint_add_in_place ( A, B );
-      }
-    }
-    else
+    // a*b = z2<<2half + z1<<half + z0, z1 = (a0+a1)(b0+b1) - z2 - z0; a
+    // square shares a's halves, so all three sub-products stay squares
+    bool const square = a == b;
+    BigInt * b0 = square ? a0 : magnitude_slice ( b, 0, half );
+    BigInt * b1 = square ? a1 : magnitude_slice ( b, half, b->count );
+    MultiplyJob z0 = { a0, b0, NULL }, z2 = { a1, b1, NULL };
+    BigInt * z1;
+
+    multiply_pair ( &z2, &z0 );
+
+    _real_bigint_add_in_place ( a0, a1 );
+    if ( !square ) _real_bigint_add_in_place ( b0, b1 );
+    z1 = _bigint_multiply_karatsuba ( a0, b0 );
+    _real_bigint_subtract_in_place ( z1, z2.product );
+    _real_bigint_subtract_in_place ( z1, z0.product );
+    _bigint_remove_high_zeroes ( z1 );
+
+    product = z2.product;
+    reserve_bits ( product, a->count + b->count + 1 );
+    bigint_shift_left ( product, half );
+    _real_bigint_add_in_place ( product, z1 );
+    bigint_shift_left ( product, half );
+    _real_bigint_add_in_place ( product, z0.product );
+
+    bigint_free ( z0.product );
+    bigint_free ( z1 );
+    if ( !square )
     {
-      if ( B->positive )
-      {
-        _real_bigint_add_in_place ( A, B );
-      }
-      else
-      {
-        // both are negative
-        if ( bigint_compare_magnitude ( A, B ) > 0 )
-        { // i.e. -100 - -72 = -28
-          _real_bigint_subtract_in_place ( A, B );
-        }
-        else
-        { // i.e. -100 - -1000 = 900
-          BigInt * b = bigint_copy ( B );
-          _real_bigint_subtract_in_place ( b, A );
-          bigint_swap ( b, A );
-          A->positive = true;
-          bigint_free ( b );
-        }
-      }
+      bigint_free ( b1 );
+      bigint_free ( b0 );
     }
   }
+
+  bigint_free ( a1 );
+  bigint_free ( a0 );
+
+  _bigint_remove_high_zeroes ( product );
+  bigint_shrink_to_fit ( product );
+
+  return product;
+}
+
+#ifdef BIGNUM_PROBES
+///
+/// Names the method _bigint_multiply_karatsuba() takes at the top level, for
+/// tracing.
+///
+static char const * multiply_algorithm ( BigInt const * const a, BigInt const * const b )
+{
+  int shorter = a->count < b->count ? a->count : b->count;
+
+  if ( shorter < BIGINT_KARATSUBA_THRESHOLD ) return "schoolbook";
+  if ( a->count + b->count >= 2 * BIGINT_PARALLEL_THRESHOLD && _bigint_pool_size ( ) > 1 ) return "karatsuba-parallel";
+  return "karatsuba";
+}
+#endif
+
+///
+/// Multiply two BigInts
+///
+/// @param a One multiplicand
+/// @param b Another multiplicand
+///
+/// @return A new BigInt containing the product of a and b. Must be freed with
+/// bigint_free()
+///
+BigInt * bigint_multiply ( BigInt const * const a, BigInt const * const b )
+{
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( (uint64_t)a->count + b->count );
+  PROBE_BEGIN ( multiply );
+  BigInt * product = _bigint_multiply_karatsuba ( a, b );
+
+  product->positive = ( a->positive == b->positive ) || product->count == 0;
+
+  PROBE_END ( multiply, a->count, b->count, multiply_algorithm ( a, b ) );
+  STATS_END ( BIGINT_OP_MULTIPLY );
+  return product;
+}
+
+///
+/// Accumulates r + (-1)^negate * a*b into r. When the product's sign matches
+/// r's, shifted copies of a are added straight into r's bits, one per set
+/// bit of b, so no product is ever materialized. Operands long enough for
+/// Karatsuba, a product of the opposite sign, or an accumulator that is also
+/// a multiplicand go through a temporary.
+///
+static void accumulate_product ( BigInt * const r, BigInt const * const a, BigInt const * const b, bool const negate )
+{
+  bool positive = ( a->positive == b->positive ) != negate;
+  Bit * start, * x;
+  Bit const * bbit, * abit;
+  int width = a->count + b->count + 1;
+
+  if ( a->count == 0 || b->count == 0 ) return;
+
+  if ( r == a || r == b || MAX2 ( a->count, b->count ) >= BIGINT_KARATSUBA_THRESHOLD
+      || ( r->positive != positive && _bigint_significant_bits ( r ) > 0 ) )
+  {
+    BigInt * product = bigint_multiply ( a, b );
+    product->positive = positive;
+    bigint_add_in_place ( r, product );
+    bigint_free ( product );
+    return;
+  }
+
+  // room for the sum, so that carries never run off the end
+  while ( r->count < width ) append_bit ( r, false );
+  append_bit ( r, false );
+  r->positive = positive;
+
+  for ( bbit = b->lsb, start = r->lsb; bbit; bbit = walk_toward_msb ( bbit, 1 ), start = start->next )
+  {
+    bool carry = false;
+
+    if ( !bbit->bit ) continue;
+
+    for ( abit = a->lsb, x = start; abit; abit = walk_toward_msb ( abit, 1 ), x = x->next )
+    {
+      single_bit_add_in_place ( &(x->bit), abit->bit, &carry );
+    }
+
+    for ( ; carry; x = x->next )
+    {
+      single_bit_add_in_place ( &(x->bit), false, &carry );
+    }
+  }
+
+  _bigint_remove_high_zeroes ( r );
+  r->positive = r->positive || r->count == 0;
+}
+
+///
+/// Adds the product of two BigInts to a third in place, without forming the
+/// product separately when the operands are small.
+///
+/// @param r The accumulator, receiving r + a*b
+/// @param a One multiplicand
+/// @param b Another multiplicand
+///
+void bigint_addmul ( BigInt * const r, BigInt const * const a, BigInt const * const b )
+{
+  MEMORY_GUARD ( );
+
+  STATS_BEGIN ( (uint64_t)r->count + a->count + b->count );
+
+  accumulate_product ( r, a, b, false );
+
+  STATS_END ( BIGINT_OP_ADDMUL );
+}
+
+///
+/// Subtracts the product of two BigInts from a third in place. See
+/// bigint_addmul().
+///
+/// @param r The accumulator, receiving r - a*b
+/// @param a One multiplicand
+/// @param b Another multiplicand
+///
+void bigint_submul ( BigInt * const r, BigInt const * const a, BigInt const * const b )
+{
+  MEMORY_GUARD ( );
+
+  STATS_BEGIN ( (uint64_t)r->count + a->count + b->count );
+
+  accumulate_product ( r, a, b, true );
+
+  STATS_END ( BIGINT_OP_ADDMUL );
+}
+
+///
+/// Sets the number of threads used by large multiplications. This must be
+/// called before the first parallel operation; afterwards the thread count is
+/// fixed and the call only reports it.
+///
+/// @param threads The total number of threads to use, counting the caller; 0
+/// to use the BIGNUM_THREADS environment variable or the processor count.
+///
+/// @return The number of threads that will be used.
+///
+int bigint_set_threads ( int threads )
+{
+  return _bigint_pool_set_size ( threads );
+}
+
+///
+/// Determine a BigInt's sign
+///
+/// @param a The BigInt whose sign to check
+///
+/// @return true if a is positive; false if a is negative; undefined if a is
+/// zero
+///
+bool bigint_positive ( BigInt const * const a )
+{
+  return a->positive;
+}
+
+///
+/// Compute the sum of two BigInts
+///
+/// @param a First addend
+/// @param b Second addend
+///
+/// @return New BigInt whose value is the sum of first and second addend; must
+/// be freed with bigint_free()
+///
+BigInt * bigint_add ( BigInt const * const a, BigInt const * const b )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigInt * sum = bigint_copy ( a );
+  bigint_add_in_place ( sum, b );
+  return sum;
+}
+
+///
+/// Performs an in-place single-bit subtraction, updating the minuend and
+/// borrow flag.
+///
+/// @param a The address of the minuend
+/// @param B The value of the subtrahend
+/// @param borrow The address of the borrow flag. If NULL, borrow is assumed to
+/// be unset and not updated.
+///
+void single_bit_subtract_in_place ( bool * const a, bool const B, bool * const borrow )
+{
+  bool A, Borrow;
+
+  A = *a;
+  Borrow = borrow ? *borrow : false;
+
+  *a = A ^ B ^ Borrow;
+  if ( borrow ) *borrow = (Borrow & ~A) | (Borrow & B) | (~Borrow & ~A & B);
+}
+
+///
+/// Subtracts one BigInt from another, storing the result in the minuend. Calls
+/// are made to _real_bigint_add_in_place or _real_big_int_subtract_in_place
+/// depending on the signs and relative magnitudes of the arguments.
+///
+/// @param A The address of the minuend
+/// @param B The address of the subtrahend
+///
+void bigint_subtract_in_place ( BigInt * const A, BigInt const * const B )
+{
+  MEMORY_GUARD ( );
+
+  STATS_BEGIN ( (uint64_t)A->count + B->count );
+
+  if ( A == B || bigint_compare ( A, B ) == 0 )
+  {
+    bigint_free_innards ( A );
+  }
+  else
+  {
+    if ( A->positive )
+    {
+      if ( B->positive )
+      {
+        if ( bigint_compare_magnitude ( A, B ) > 0 )
+        {
+          _real_bigint_subtract_in_place ( A, B );
+        }
+        else
+        {
+          BigInt * b = bigint_copy ( B );
+          _real_bigint_subtract_in_place ( b, A );
+          bigint_swap ( b, A );
+          A->positive = false;
+          bigint_free ( b );
+        }
+      }
+      else
+      {
+        _real_bigint_add_in_place ( A, B );
+      }
+    }
+    else
+    {
+      if ( B->positive )
+      {
+        _real_bigint_add_in_place ( A, B );
+      }
+      else
+      {
+        // both are negative
+        if ( bigint_compare_magnitude ( A, B ) > 0 )
+        { // i.e. -100 - -72 = -28
+          _real_bigint_subtract_in_place ( A, B );
+        }
+        else
+        { // i.e. -100 - -1000 = 900
+          BigInt * b = bigint_copy ( B );
+          _real_bigint_subtract_in_place ( b, A );
+          bigint_swap ( b, A );
+          A->positive = true;
+          bigint_free ( b );
+        }
+      }
+    }
+  }
+
+  STATS_END ( BIGINT_OP_SUBTRACT );
 }
 
 ///
@@ -691,9 +1327,13 @@ void bigint_subtract_in_place ( BigInt * const A, BigInt const * const B )
 ///
 void _real_bigint_subtract_in_place ( BigInt * const A, BigInt const * const B )
 {
+  MEMORY_GUARD ( );
+
   Bit * a, *b;
   bool borrow;
 
+  if ( is_shared ( A ) ) _bigint_unshare ( A );
+
   a = A->lsb;
   b = B->lsb;
   borrow = false;
@@ -713,65 +1353,44 @@ void _real_bigint_subtract_in_place ( BigInt * const A, BigInt const * const B )
   }
 }
 
-///
-/// Find the end of a C-string
-///
-/// @param str The C-string whose last character to find
-///
-/// @return A pointer to the last (non-NULL) character in the NULL-terminated
-/// C-string
-///
-char const * find_string_end ( char const * str )
-{
-  while ( *str ) str ++;
-  return str-1;
-}
-
 ///
 /// Create a BigInt from a C-string describing a decimal integer value. This
 /// is meant to overcome limits on the argument to bigint_init(). In fact there
 /// is otherwise intended to be no difference between bigint_init_from_string
 /// and bigint_init
 ///
-/// @param str C-string describing a decimal integer value
+/// @param str C-string describing a decimal integer value, optionally preceded
+/// by a sign
 ///
-/// @return A new BigInt whose value is equal to the argument's
+/// @return A new BigInt whose value is equal to the argument's, or NULL if the
+/// string is not a decimal integer
 ///
 BigInt * bigint_init_from_string ( char const * const str )
 {
-  char const * end;
-  BigInt * a = bigint_init_empty ( );
-  BigInt * place = bigint_init ( 1 );
-  BigInt * ten = bigint_init ( 10 );
-
-  for ( end = find_string_end ( str ); end >= str; -- end )
-  {
-    if ( *end != '-' )
-    {
-      BigInt * current_digit, * new_place, * new_place_value;
+  MEMORY_GUARD ( NULL );
 
-      current_digit = bigint_init ( (*end) - '0' );
-      new_place_value = bigint_multiply ( current_digit, place );
+  STATS_BEGIN ( 0 );
+  PROBE_BEGIN ( fromstring );
+  BigIntParser * p = bigint_parser_new ( 10 );
+  BigInt * out;
+  MemoryFrame frame;
 
-      bigint_free ( current_digit );
-      bigint_add_in_place ( a, new_place_value );
-      bigint_free ( new_place_value );
-
-      new_place = bigint_multiply ( place, ten );
-      bigint_swap ( new_place, place );
-      bigint_free ( new_place );
-    }
-    else
-    {
-      a->positive = false;
-      break;
-    }
+  // the parser's stack is not recorded by the guard
+  MEMORY_CATCH ( frame )
+  {
+    bigint_parser_free ( p );
+    _bigint_memory_rethrow ( );
   }
 
-  bigint_free ( place );
-  bigint_free ( ten );
+  bigint_parser_feed ( p, str, strlen ( str ) );
+  out = bigint_parser_finish ( p );
 
-  return a;
+  _bigint_memory_pop ( &frame );
+
+  PROBE_END ( fromstring, out ? out->count : 0, 10, "subquadratic" );
+  STATS_BITS ( out ? out->count : 0 );
+  STATS_END ( BIGINT_OP_FROMSTRING );
+  return out;
 }
 
 ///
@@ -843,6 +1462,14 @@ Bit const * walk_toward_lsb ( Bit const * b, int count )
 ///
 BigInt * bigint_divide ( BigInt const * const dividend, BigInt const * const divisor, BigInt ** premainder )
 {
+  MEMORY_GUARD_CATCH ( )
+  {
+    if ( premainder ) *premainder = NULL;
+    return NULL;
+  }
+
+  STATS_BEGIN ( (uint64_t)dividend->count + divisor->count );
+  PROBE_BEGIN ( divide );
   BigInt * quotient, * subby;
   Bit const * dividend_pointer;
 
@@ -852,7 +1479,10 @@ BigInt * bigint_divide ( BigInt const * const dividend, BigInt const * const div
 
   if ( dividend_pointer )
   {
-    subby = bigint_init_empty ( );
+    // one quotient bit per dividend bit; the partial remainder never
+    // outgrows the divisor by more than the bit just brought down
+    reserve_bits ( quotient, dividend->count );
+    subby = bigint_init_reserve ( divisor->count + 1 );
     do
     {
       prepend_bit ( subby, dividend_pointer->bit );
@@ -867,8 +1497,16 @@ BigInt * bigint_divide ( BigInt const * const dividend, BigInt const * const div
         prepend_bit ( quotient, true );
         _real_bigint_subtract_in_place ( subby, divisor );
       }
+
+      // keep the partial remainder no longer than the divisor so each
+      // comparison costs O(divisor) rather than O(dividend)
+      _bigint_remove_high_zeroes ( subby );
     }
     while ( dividend_pointer );
+
+    _bigint_remove_high_zeroes ( quotient );
+    bigint_shrink_to_fit ( quotient );
+    bigint_shrink_to_fit ( subby );
   }
   else
   {
@@ -878,68 +1516,221 @@ BigInt * bigint_divide ( BigInt const * const dividend, BigInt const * const div
   premainder ? *premainder = subby
              : bigint_free ( subby );
 
+  PROBE_END ( divide, dividend->count, divisor->count, "binary-long" );
+  STATS_END ( BIGINT_OP_DIVIDE );
   return quotient;
 }
 
 ///
-/// Copies a forward-oriented non-wrapping consecutive range of bits from one
-/// BigInt into a new BigInt.
+/// Copies the magnitude of a BigInt, from a given bit up, into new 32-bit
+/// limbs, least significant first.
 ///
-/// @param a The BigInt to slice from
-/// @param lsb The index of the least significant bit in the slice
-/// @param msb The index of the first bit to stop copying at
+/// @param bi The BigInt to copy
+/// @param skip The number of low bits to leave out
+/// @param pn Receives the number of limbs, not counting the spare ones
+/// @param spare The number of zero limbs to add on top
 ///
-/// @return A new BigInt whose bits consist of [lsb,msb) from the argument. If
-/// lsb is greater than the index of the last bit in the argument, no bits are
-/// copied. If msb implies a longer sequence than the argument contains,
-/// copying will stop at the last bit in the argument. The new BigInt's sign is
-/// the same as the source BigInt's sign.
+/// @return The limbs. Must be freed with _bigint_free(), size
+/// (*pn+spare)*sizeof(uint32_t).
 ///
-BigInt * bigint_binary_slice ( BigInt const * const a, int lsb, int const msb )
+static uint32_t * magnitude_limbs ( BigInt const * const bi, int const skip, size_t * const pn, size_t const spare )
 {
-  BigInt * out = bigint_init_empty ( );
-  Bit const * c = walk_toward_msb ( a->lsb, lsb );
-  out->positive = a->positive;
-  while ( c && lsb ++ < msb )
+  int const bits = _bigint_significant_bits ( bi ) - skip;
+  size_t const n = bits > 0 ? ( (size_t)bits + 31 ) / 32 : 0;
+  uint32_t * const limbs = _bigint_alloc ( (n + spare)*sizeof*limbs );
+  Bit const * bit = walk_toward_msb ( bi->lsb, skip );
+  int i;
+
+  memset ( limbs, 0, (n + spare)*sizeof*limbs );
+  for ( i = 0; i < bits; ++ i, bit = walk_toward_msb ( bit, 1 ) )
   {
-    append_bit ( out, c->bit );
-    c = walk_toward_msb ( c, 1 );
+    limbs[i/32] |= (uint32_t)bit->bit << (i%32);
   }
-  return out;
+
+  *pn = n;
+  return limbs;
 }
 
+#ifndef NDEBUG
 ///
-/// Reverses the bits in a BigInt. No zeroes are hacked off.
+/// @return Whether n limbs are all zero
 ///
-/// @param bi The BigInt to reverse.
+static bool limbs_zero ( uint32_t const * const a, size_t const n )
+{
+  size_t i;
+
+  for ( i = 0; i < n && !a[i]; ++ i );
+  return i == n;
+}
+
 ///
-void _bigint_reverse_bits ( BigInt * const bi )
+/// @return Whether the low count bits of a BigInt are all zero
+///
+static bool low_bits_zero ( BigInt const * const bi, int count )
 {
-  Bit * next, * a;
+  Bit const * bit;
 
-  for ( a = bi->lsb; a; a = a->prev )
+  for ( bit = bi->lsb; bit && count -- > 0; bit = walk_toward_msb ( bit, 1 ) )
   {
-    next = a->next;
-    a->next = a->prev;
-    a->prev = next;
+    if ( bit->bit ) return false;
   }
-
-  next = bi->lsb;
-  bi->lsb = bi->msb;
-  bi->msb = next;
+  return true;
 }
+#endif
 
 ///
-/// Converts a BigInt to a binary string representation
+/// Divides a BigInt by another that is known to divide it exactly, as for
+/// binomial coefficients or cancelling a common factor, by Jebelean's
+/// word-at-a-time Hensel division. After the common low zero bits are
+/// dropped the divisor is odd, so each quotient limb, from the least
+/// significant up, is the low limb of what remains times the inverse of the
+/// divisor modulo 2^32, and subtracting it times the divisor clears that
+/// limb. That is one pass of schoolbook multiplication on limbs, with no
+/// comparisons, no trial subtractions and no remainder. Unless NDEBUG is
+/// defined, an assertion checks that nothing remains.
 ///
-/// @param bi The BigInt to convert to a string
+/// The result is meaningless if the division is not exact.
 ///
-/// @return A pointer to the C-string containing the BigInt's string
-/// representation. Must be free()d.
+/// @param n The dividend
+/// @param d The divisor, a factor of n
+///
+/// @return A new BigInt containing n/d, negative when exactly one of them
+/// is, or NULL if d is zero. Must be freed with bigint_free().
+///
+BigInt * bigint_divexact ( BigInt const * const n, BigInt const * const d )
+{
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( (uint64_t)n->count + d->count );
+  PROBE_BEGIN ( divide );
+  Kernels const * const kernels = _bigint_kernels ( );
+  BigInt * quotient;
+  Bit const * bit;
+  uint32_t * r, * v, inv;
+  size_t rn, vn, i, j;
+  int zeroes = 0, k;
+
+  if ( _bigint_significant_bits ( d ) == 0 )
+  {
+    STATS_END ( BIGINT_OP_DIVEXACT );
+    return NULL;
+  }
+
+  for ( bit = d->lsb; !bit->bit; bit = walk_toward_msb ( bit, 1 ) ) zeroes ++;
+
+  // the remainder gets two spare limbs, so that if the division is not exact
+  // a borrow off the top shows up there rather than vanishing
+  r = magnitude_limbs ( n, zeroes, &rn, 2 );
+  v = magnitude_limbs ( d, zeroes, &vn, 0 );
+
+  // Newton's iteration doubles the correct low bits of an inverse; an odd
+  // number is its own inverse modulo 8
+  inv = v[0];
+  for ( k = 0; k < 4; ++ k ) inv *= 2 - v[0]*inv;
+
+  quotient = bigint_init_reserve ( rn >= vn ? 32*(int)( rn - vn + 1 ) : 0 );
+
+  for ( i = 0; i + vn <= rn; ++ i )
+  {
+    uint32_t const q = r[i]*inv;
+    // r -= q*v << 32i, the borrow running on into the spare limbs
+    uint32_t borrow = kernels->submul_1 ( r + i, v, vn, q );
+
+    for ( j = i + vn; borrow && j < rn + 2; ++ j )
+    {
+      uint32_t const low = r[j];
+
+      r[j] = low - borrow;
+      borrow = low < borrow;
+    }
+
+    for ( k = 0; k < 32; ++ k ) append_bit ( quotient, ( q >> k ) & 1 );
+  }
+
+  // debug builds check the caller's promise: nothing may remain, including
+  // the dividend's bits below the divisor's low zeroes
+  assert ( limbs_zero ( r, rn + 2 ) && low_bits_zero ( n, zeroes ) );
+
+  _bigint_free ( v, vn*sizeof*v );
+  _bigint_free ( r, (rn + 2)*sizeof*r );
+
+  _bigint_remove_high_zeroes ( quotient );
+  bigint_shrink_to_fit ( quotient );
+  quotient->positive = n->positive == d->positive || quotient->count == 0;
+
+  PROBE_END ( divide, n->count, d->count, "hensel" );
+  STATS_END ( BIGINT_OP_DIVEXACT );
+  return quotient;
+}
+
+///
+/// Copies a forward-oriented non-wrapping consecutive range of bits from one
+/// BigInt into a new BigInt.
+///
+/// @param a The BigInt to slice from
+/// @param lsb The index of the least significant bit in the slice
+/// @param msb The index of the first bit to stop copying at
+///
+/// @return A new BigInt whose bits consist of [lsb,msb) from the argument. If
+/// lsb is greater than the index of the last bit in the argument, no bits are
+/// copied. If msb implies a longer sequence than the argument contains,
+/// copying will stop at the last bit in the argument. The new BigInt's sign is
+/// the same as the source BigInt's sign.
+///
+BigInt * bigint_binary_slice ( BigInt const * const a, int lsb, int const msb )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigInt * out = bigint_init_empty ( );
+  Bit const * c = walk_toward_msb ( a->lsb, lsb );
+  out->positive = a->positive;
+  reserve_bits ( out, ( msb < a->count ? msb : a->count ) - lsb );
+  while ( c && lsb ++ < msb )
+  {
+    append_bit ( out, c->bit );
+    c = walk_toward_msb ( c, 1 );
+  }
+  return out;
+}
+
+///
+/// Reverses the bits in a BigInt. No zeroes are hacked off.
+///
+/// @param bi The BigInt to reverse.
+///
+void _bigint_reverse_bits ( BigInt * const bi )
+{
+  MEMORY_GUARD ( );
+
+  Bit * next, * a;
+
+  if ( is_shared ( bi ) ) _bigint_unshare ( bi );
+
+  for ( a = bi->lsb; a; a = a->prev )
+  {
+    next = a->next;
+    a->next = a->prev;
+    a->prev = next;
+  }
+
+  next = bi->lsb;
+  bi->lsb = bi->msb;
+  bi->msb = next;
+}
+
+///
+/// Converts a BigInt to a binary string representation
+///
+/// @param bi The BigInt to convert to a string
+///
+/// @return A pointer to the C-string containing the BigInt's string
+/// representation. Must be released with bigint_free_string().
 ///
 char * bigint_tostring_base2 ( BigInt const * const bi )
 {
-  char * out = smalloc((sizeof*out)*(1+bi->count));
+  MEMORY_GUARD ( NULL );
+
+  char * out = _bigint_alloc((sizeof*out)*(1+bi->count));
   int i;
 
   Bit const * bit = bi->msb;
@@ -962,6 +1753,8 @@ char * bigint_tostring_base2 ( BigInt const * const bi )
 ///
 int _bigint_remove_high_zeroes ( BigInt * const bi )
 {
+  MEMORY_GUARD ( 0 );
+
   int count_removed;
 
   for (
@@ -973,6 +1766,38 @@ int _bigint_remove_high_zeroes ( BigInt * const bi )
   return count_removed;
 }
 
+///
+/// Counts the bits of a BigInt up to and including its highest set bit,
+/// ignoring any high zeroes.
+///
+/// @param bi The BigInt to measure
+///
+/// @return The number of significant bits; 0 for zero
+///
+int _bigint_significant_bits ( BigInt const * const bi )
+{
+  Bit const * bit;
+  int count = bi->count;
+
+  for ( bit = bi->msb; bit && !bit->bit; bit = walk_toward_lsb ( bit, 1 ) )
+  {
+    count --;
+  }
+
+  return count;
+}
+
+///
+/// @param bi The BigInt to measure
+///
+/// @return The number of bits in the magnitude of a BigInt up to its highest
+/// set bit; 0 for zero
+///
+int bigint_bit_length ( BigInt const * const bi )
+{
+  return _bigint_significant_bits ( bi );
+}
+
 ///
 /// Returns a C-string containing the BigInt in decimal (base 10).
 ///
@@ -983,72 +1808,266 @@ int _bigint_remove_high_zeroes ( BigInt * const bi )
 ///
 char * bigint_tostring_base10 ( BigInt const * const bi )
 {
-  int index = 0, len;
-  char * out = smalloc ( (sizeof*out)*(bi->count+2) );
-  char const * const chars = "0123456789";
+  return bigint_tostring_radix ( bi, 10 );
+}
 
-  BigInt * running_quotient, * remainder, * divisor, * zero;
+///
+/// Returns the remainder of long division of the first operand by the second,
+/// regardless of sign.
+///
+/// @param dividend The number being divided.
+/// @param divisor The number dividing.
+///
+/// @return The remainder of division of the operands.
+///
+BigInt * bigint_modulo ( BigInt const * const dividend, BigInt const * const divisor )
+{
+  MEMORY_GUARD ( NULL );
 
-  running_quotient = bigint_copy ( bi );
-  divisor = bigint_init ( 10 );
-  zero = bigint_init ( 0 );
+  STATS_BEGIN ( (uint64_t)dividend->count + divisor->count );
+  BigInt * remainder;
 
-  if ( !bi->positive )
+  bigint_free ( bigint_divide ( dividend, divisor, &remainder ) );
+
+  STATS_END ( BIGINT_OP_MODULO );
+  return remainder;
+}
+
+///
+/// Creates a new non-negative BigInt from a native unsigned value.
+///
+/// @param u The value of the new BigInt
+///
+/// @return A new BigInt equal to the argument. Must be freed with bigint_free()
+///
+BigInt * _bigint_init_uint64 ( uint64_t u )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigInt * bi = bigint_init_empty ( );
+
+  while ( u > 0 )
   {
-    out[0] = '-';
-    out ++;
+    append_bit ( bi, u & 1 );
+    u >>= 1;
   }
 
-  while ( bigint_compare_magnitude ( running_quotient, zero ) > 0 )
+  return bi;
+}
+
+///
+/// Reads a BigInt's magnitude into a native unsigned value if it fits.
+///
+/// @param bi The BigInt to read
+/// @param out The address receiving the magnitude of bi
+///
+/// @return true if the magnitude fits in 64 bits; otherwise false, and out is
+/// unspecified.
+///
+bool _bigint_to_uint64 ( BigInt const * const bi, uint64_t * const out )
+{
+  Bit const * bit;
+  int bits = 0;
+
+  for ( bit = bi->msb; bit && !bit->bit; bit = walk_toward_lsb ( bit, 1 ) );
+
+  for ( *out = 0; bit && bits < 64; bit = walk_toward_lsb ( bit, 1 ), ++ bits )
   {
-    BigInt * tmp = bigint_divide ( running_quotient, divisor, &remainder );
-    bigint_swap ( tmp, running_quotient );
-    bigint_free ( tmp );
-    out[index++] = chars[bigint_low_dword(remainder)];
-    bigint_free ( remainder );
+    *out = (*out << 1) | bit->bit;
   }
 
-  bigint_free ( running_quotient );
-  bigint_free ( divisor );
-  bigint_free ( zero );
+  return bit == NULL;
+}
 
-  len = index;
+///
+/// Arguments and result of one subtree of a product tree.
+///
+typedef struct _tag_product_job
+{
+  BigInt * const * factors;
+  size_t n;
+  BigInt * product;
+} ProductJob;
 
-  for ( index = 0; index < (len/2); ++ index )
+///
+/// Multiplies a range of factors as a balanced binary tree. The two halves of
+/// a large enough range are evaluated in parallel.
+///
+/// @param arg The ProductJob to compute
+///
+static void product_tree_run ( void * arg )
+{
+  ProductJob * job = arg;
+
+  if ( job->n == 1 )
   {
-    char t = out[index];
-    out[index] = out[len-index-1];
-    out[len-index-1] = t;
+    job->product = bigint_copy ( job->factors[0] );
   }
+  else
+  {
+    size_t half = job->n / 2, i;
+    ProductJob low = { job->factors, half, NULL };
+    ProductJob high = { job->factors + half, job->n - half, NULL };
+    long bits = 0;
 
-  if ( !bi->positive )
+    for ( i = 0; i < job->n; ++ i ) bits += job->factors[i]->count;
+
+    if ( bits >= BIGINT_PARALLEL_THRESHOLD && _bigint_pool_size ( ) > 1 )
+    {
+      BigIntTask task = { product_tree_run, &high, 0 };
+      _bigint_task_spawn ( &task );
+      product_tree_run ( &low );
+      _bigint_task_join ( &task );
+    }
+    else
+    {
+      product_tree_run ( &low );
+      product_tree_run ( &high );
+    }
+
+    job->product = _bigint_multiply_karatsuba ( low.product, high.product );
+
+    bigint_free ( high.product );
+    bigint_free ( low.product );
+  }
+}
+
+///
+/// Multiplies a list of non-negative leaves as a balanced product tree and
+/// frees them.
+///
+/// @param leaves The leaves; the array itself is not freed
+/// @param n The number of leaves
+/// @param positive The sign to give the product
+///
+/// @return A new BigInt containing the product. Must be freed with
+/// bigint_free().
+///
+static BigInt * product_tree ( BigInt ** const leaves, size_t n, bool positive )
+{
+  ProductJob job = { leaves, n, NULL };
+  size_t i;
+
+  if ( n == 0 ) return bigint_init ( 1 );
+
+  product_tree_run ( &job );
+
+  for ( i = 0; i < n; ++ i ) bigint_free ( leaves[i] );
+
+  job.product->positive = positive || job.product->count == 0;
+
+  return job.product;
+}
+
+///
+/// Accumulates a factor into a native leaf, starting a new leaf when the
+/// running product would overflow.
+///
+/// @param leaves The leaves built so far
+/// @param n The address of the number of leaves built so far
+/// @param acc The address of the native leaf being accumulated
+/// @param u The factor to accumulate
+///
+static void accumulate_leaf ( BigInt ** const leaves, size_t * const n, uint64_t * const acc, uint64_t u )
+{
+  if ( u != 0 && *acc > UINT64_MAX / u )
   {
-    out --;
-    len ++;
+    leaves[(*n)++] = _bigint_init_uint64 ( *acc );
+    *acc = 1;
   }
+  *acc *= u;
+}
 
-  out = realloc ( out, (sizeof*out)*(len+1) );
-  out[len] = '\0';
+///
+/// Computes the product of a list of BigInts with a balanced product tree.
+/// Runs of factors that fit in 64 bits are first multiplied natively, and the
+/// upper levels of the tree are evaluated in parallel once they are large.
+///
+/// @param factors The factors to multiply
+/// @param n The number of factors
+///
+/// @return A new BigInt containing the product of the factors (1 if n is
+/// zero). Must be freed with bigint_free().
+///
+BigInt * bigint_product_list ( BigInt const * const * const factors, size_t n )
+{
+  MEMORY_GUARD ( NULL );
 
-  return out;
+  STATS_BEGIN ( 0 );
+  BigInt ** leaves = _bigint_alloc ( (sizeof*leaves)*(n+1) );
+  BigInt * product;
+  size_t i, count = 0;
+  uint64_t acc = 1;
+  bool positive = true;
+
+  for ( i = 0; i < n; ++ i )
+  {
+    BigInt const * f = factors[i];
+    uint64_t u;
+
+    positive = ( positive == f->positive );
+
+    if ( _bigint_to_uint64 ( f, &u ) )
+    {
+      accumulate_leaf ( leaves, &count, &acc, u );
+    }
+    else
+    {
+      leaves[count] = bigint_copy ( f );
+      leaves[count++]->positive = true;
+    }
+  }
+
+  if ( acc != 1 || count == 0 ) leaves[count++] = _bigint_init_uint64 ( acc );
+
+  product = product_tree ( leaves, count, positive );
+
+  _bigint_free ( leaves, (sizeof*leaves)*(n+1) );
+
+  STATS_BITS ( product->count );
+  STATS_END ( BIGINT_OP_PRODUCT_LIST );
+  return product;
 }
 
 ///
-/// Returns the remainder of long division of the first operand by the second,
-/// regardless of sign.
+/// Computes the product of a list of native integers with a balanced product
+/// tree. See bigint_product_list().
 ///
-/// @param dividend The number being divided.
-/// @param divisor The number dividing.
+/// @param factors The factors to multiply
+/// @param n The number of factors
 ///
-/// @return The remainder of division of the operands.
+/// @return A new BigInt containing the product of the factors (1 if n is
+/// zero). Must be freed with bigint_free().
 ///
-BigInt * bigint_modulo ( BigInt const * const dividend, BigInt const * const divisor )
+BigInt * bigint_product_list_int64 ( int64_t const * const factors, size_t n )
 {
-  BigInt * remainder;
+  MEMORY_GUARD ( NULL );
 
-  bigint_free ( bigint_divide ( dividend, divisor, &remainder ) );
+  STATS_BEGIN ( 0 );
+  BigInt ** leaves = _bigint_alloc ( (sizeof*leaves)*(n+1) );
+  BigInt * product;
+  size_t i, count = 0;
+  uint64_t acc = 1;
+  bool positive = true;
 
-  return remainder;
+  for ( i = 0; i < n; ++ i )
+  {
+    int64_t f = factors[i];
+
+    positive = ( positive == ( f >= 0 ) );
+
+    accumulate_leaf ( leaves, &count, &acc, f < 0 ? 0 - (uint64_t)f : (uint64_t)f );
+  }
+
+  if ( acc != 1 || count == 0 ) leaves[count++] = _bigint_init_uint64 ( acc );
+
+  product = product_tree ( leaves, count, positive );
+
+  _bigint_free ( leaves, (sizeof*leaves)*(n+1) );
+
+  STATS_BITS ( product->count );
+  STATS_END ( BIGINT_OP_PRODUCT_LIST );
+  return product;
 }
 
 ///
@@ -1061,20 +2080,596 @@ BigInt * bigint_modulo ( BigInt const * const dividend, BigInt const * const div
 ///
 BigInt * bigint_factorial ( BigInt const * const bi )
 {
-  BigInt * one = bigint_init ( 1 );
-  BigInt * factorial = bigint_copy ( one );
-  BigInt * p = bigint_copy ( bi );
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( bi->count );
+  BigInt * factorial;
+  int64_t * factors;
+  int n, i;
 
-  while ( bigint_compare ( p, one ) >= 0 )
+  if ( !bi->positive )
   {
-    BigInt * tmp = bigint_multiply ( factorial, p );
-    bigint_swap ( factorial, tmp );
-    bigint_free ( tmp );
-    bigint_subtract_in_place ( p, one );
+    STATS_END ( BIGINT_OP_FACTORIAL );
+    return bigint_init ( 1 );
   }
 
-  bigint_free ( p );
+  n = bigint_low_dword ( bi );
+  factors = _bigint_alloc ( (sizeof*factors)*(n > 0 ? n : 1) );
+
+  for ( i = 0; i < n; ++ i ) factors[i] = i + 1;
 
+  factorial = bigint_product_list_int64 ( factors, n > 0 ? n : 0 );
+
+  _bigint_free ( factors, (sizeof*factors)*(n > 0 ? n : 1) );
+
+  STATS_END ( BIGINT_OP_FACTORIAL );
   return factorial;
 }
 
+///
+/// Raise a BigInt to a power by left-to-right binary exponentiation. A base
+/// whose magnitude is a power of two is a single shift; otherwise the running
+/// power is squared once per bit of the exponent, which
+/// _bigint_multiply_karatsuba() does with square sub-products only.
+///
+/// @param base The base
+/// @param k The exponent
+///
+/// @return A new BigInt containing base^k, which is 1 when k is 0. Must be
+/// freed with bigint_free().
+///
+BigInt * bigint_pow ( BigInt const * const base, unsigned long const k )
+{
+  MEMORY_GUARD ( NULL );
+
+  int const bits = _bigint_significant_bits ( base );
+  bool const positive = base->positive || k % 2 == 0;
+  STATS_BEGIN ( bits );
+  BigInt * power;
+  Bit const * bit;
+  unsigned long mask;
+
+  if ( k == 0 || bits == 0 )
+  {
+    STATS_END ( BIGINT_OP_POW );
+    return bigint_init ( k == 0 );
+  }
+
+  for ( bit = base->lsb; !bit->bit; bit = walk_toward_msb ( bit, 1 ) );
+
+  if ( bit == walk_toward_lsb ( base->msb, base->count - bits ) )
+  {
+    // |base| = 2^(bits-1); a bit count must fit an int
+    if ( (unsigned long)( bits - 1 ) > (unsigned long)( INT_MAX - 1 ) / k )
+    {
+      _bigint_memory_exhausted ( );
+      _bigint_memory_rethrow ( );
+    }
+    power = bigint_init ( 1 );
+    bigint_shift_left ( power, ( bits - 1 )*(int)k );
+  }
+  else
+  {
+    power = bigint_copy ( base );
+    power->positive = true;
+    _bigint_remove_high_zeroes ( power );
+
+    for ( mask = 1; mask <= k / 2; mask <<= 1 );
+    while ( mask >>= 1 )
+    {
+      BigInt * tmp = bigint_multiply ( power, power );
+      bigint_swap ( tmp, power );
+      bigint_free ( tmp );
+
+      if ( k & mask )
+      {
+        tmp = bigint_multiply ( power, base );
+        bigint_swap ( tmp, power );
+        bigint_free ( tmp );
+      }
+    }
+  }
+
+  power->positive = positive;
+
+  STATS_BITS ( power->count );
+  STATS_END ( BIGINT_OP_POW );
+  return power;
+}
+
+///
+/// Like bigint_modulo(), except that a dividend with no bits leaves a zero
+/// remainder rather than a copy of the divisor.
+///
+static BigInt * remainder_of ( BigInt const * const dividend, BigInt const * const divisor )
+{
+  return dividend->count > 0 ? bigint_modulo ( dividend, divisor ) : bigint_init ( 0 );
+}
+
+///
+/// Reduces a BigInt to its least non-negative residue modulo a positive
+/// modulus, taking the sign of the BigInt into account (unlike
+/// bigint_modulo()).
+///
+/// @param a The number to reduce
+/// @param m The modulus
+///
+/// @return A new BigInt in [0,m). Must be freed with bigint_free().
+///
+BigInt * _bigint_mod_nonnegative ( BigInt const * const a, BigInt const * const m )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigInt * r = remainder_of ( a, m );
+
+  if ( !a->positive && r->count > 0 )
+  {
+    BigInt * tmp = bigint_copy ( m );
+    tmp->positive = true;
+    _real_bigint_subtract_in_place ( tmp, r );
+    _bigint_remove_high_zeroes ( tmp );
+    bigint_swap ( tmp, r );
+    bigint_free ( tmp );
+  }
+
+  return r;
+}
+
+///
+/// Multiplies two BigInts modulo a third by interleaving the shift-and-add
+/// product with reduction: the bits of b are taken from the top, and after
+/// each doubling-and-add step at most two subtractions of m bring the
+/// running value back below m. Nothing wider than m plus two bits is ever
+/// held, and no division takes place.
+///
+/// @param a One multiplicand
+/// @param b Another multiplicand
+/// @param m The modulus, which must be positive
+///
+/// @return A new BigInt in [0,m) equal to a*b mod m. Must be freed with
+/// bigint_free().
+///
+BigInt * bigint_mulmod ( BigInt const * const a, BigInt const * const b, BigInt const * const m )
+{
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( (uint64_t)a->count + b->count + m->count );
+  BigInt * x = _bigint_mod_nonnegative ( a, m );
+  BigInt * y = _bigint_mod_nonnegative ( b, m );
+  BigInt * r = bigint_init_empty ( );
+  Bit const * bit;
+
+  for ( bit = y->msb; bit; bit = walk_toward_lsb ( bit, 1 ) )
+  {
+    if ( r->count > 0 ) prepend_bit ( r, false );
+    if ( bit->bit ) _real_bigint_add_in_place ( r, x );
+
+    while ( bigint_compare_magnitude ( r, m ) >= 0 )
+    {
+      _real_bigint_subtract_in_place ( r, m );
+      _bigint_remove_high_zeroes ( r );
+    }
+  }
+
+  bigint_free ( y );
+  bigint_free ( x );
+
+  STATS_END ( BIGINT_OP_MULMOD );
+  return r;
+}
+
+///
+/// Computes the inverse of a BigInt modulo another BigInt by the extended
+/// Euclidean algorithm.
+///
+/// @param a The number to invert
+/// @param m The modulus, which must be positive
+///
+/// @return A new BigInt x in [0,m) with a*x = 1 (mod m), or NULL if a and m
+/// are not coprime. Must be freed with bigint_free().
+///
+BigInt * bigint_invmod ( BigInt const * const a, BigInt const * const m )
+{
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( (uint64_t)a->count + m->count );
+  BigInt * r0 = bigint_copy ( m ), * r1 = _bigint_mod_nonnegative ( a, m );
+  BigInt * s0 = bigint_init ( 0 ), * s1 = bigint_init ( 1 );
+  BigInt * one = bigint_init ( 1 ), * inverse = NULL;
+
+  r0->positive = true;
+
+  // invariant: s_i * a = r_i (mod m)
+  while ( r1->count > 0 )
+  {
+    BigInt * r2, * q = bigint_divide ( r0, r1, &r2 );
+    BigInt * qs1 = bigint_multiply ( q, s1 );
+
+    bigint_subtract_in_place ( s0, qs1 );
+    bigint_swap ( s0, s1 );
+    bigint_swap ( r0, r1 );
+    bigint_swap ( r1, r2 );
+
+    bigint_free ( r2 );
+    bigint_free ( qs1 );
+    bigint_free ( q );
+  }
+
+  if ( bigint_compare ( r0, one ) == 0 )
+  {
+    inverse = _bigint_mod_nonnegative ( s0, m );
+  }
+
+  bigint_free ( one );
+  bigint_free ( s1 );
+  bigint_free ( s0 );
+  bigint_free ( r1 );
+  bigint_free ( r0 );
+
+  STATS_END ( BIGINT_OP_INVMOD );
+  return inverse;
+}
+
+///
+/// A node of a product tree over a list of moduli. Leaves borrow the modulus;
+/// interior nodes own the product of their subtree.
+///
+typedef struct _tag_product_node
+{
+  BigInt const * value;
+  BigInt * owned;
+  size_t leaves;
+  struct _tag_product_node * low, * high;
+} ProductNode;
+
+///
+/// Builds the product tree over a list of moduli.
+///
+/// @param moduli The leaves of the tree
+/// @param n The number of leaves, at least one
+///
+/// @return The root of the tree. Must be freed with product_node_free().
+///
+static ProductNode * product_node_build ( BigInt const * const * const moduli, size_t n )
+{
+  ProductNode * node = _bigint_alloc ( sizeof*node );
+
+  node->leaves = n;
+
+  if ( n == 1 )
+  {
+    node->value = moduli[0];
+    node->owned = NULL;
+    node->low = node->high = NULL;
+  }
+  else
+  {
+    node->low = product_node_build ( moduli, n / 2 );
+    node->high = product_node_build ( moduli + n / 2, n - n / 2 );
+    node->owned = _bigint_multiply_karatsuba ( node->low->value, node->high->value );
+    node->value = node->owned;
+  }
+
+  return node;
+}
+
+///
+/// Releases a product tree.
+///
+/// @param node The root of the tree
+///
+static void product_node_free ( ProductNode * const node )
+{
+  if ( node->low ) product_node_free ( node->low );
+  if ( node->high ) product_node_free ( node->high );
+  bigint_free ( node->owned );
+  _bigint_free ( node, sizeof*node );
+}
+
+///
+/// Arguments of one subtree of a remainder tree.
+///
+typedef struct _tag_remainder_job
+{
+  ProductNode const * node;
+  BigInt const * x;
+  BigInt ** out;
+} RemainderJob;
+
+///
+/// Reduces a number modulo a product-tree node, then recursively modulo the
+/// node's children, storing the remainders at the leaves into the output
+/// array. Large subtrees are reduced in parallel.
+///
+/// @param arg The RemainderJob to compute
+///
+static void remainder_tree_run ( void * arg )
+{
+  RemainderJob * job = arg;
+  BigInt * r = remainder_of ( job->x, job->node->value );
+
+  if ( !job->node->low )
+  {
+    *job->out = r;
+  }
+  else
+  {
+    RemainderJob low = { job->node->low, r, job->out };
+    RemainderJob high = { job->node->high, r, job->out + job->node->low->leaves };
+
+    if ( r->count >= BIGINT_PARALLEL_THRESHOLD && _bigint_pool_size ( ) > 1 )
+    {
+      BigIntTask task = { remainder_tree_run, &high, 0 };
+      _bigint_task_spawn ( &task );
+      remainder_tree_run ( &low );
+      _bigint_task_join ( &task );
+    }
+    else
+    {
+      remainder_tree_run ( &low );
+      remainder_tree_run ( &high );
+    }
+
+    bigint_free ( r );
+  }
+}
+
+// the word moduli bigint_mod_many() reduces together
+#define MOD_WORD_LANES 4
+
+///
+/// A modulus below 2^32 prepared for mod_words(): shifted up until its top
+/// bit is set, with v = floor((2^64 - 1)/d) - 2^32, the reciprocal of Moller
+/// and Granlund's "Improved division by invariant integers" (2011).
+///
+typedef struct _tag_word_divisor
+{
+  uint32_t d, v;
+  int shift;
+} WordDivisor;
+
+///
+/// @return m prepared for mod_words(), with its one hardware division
+///
+static WordDivisor word_divisor ( uint32_t const m )
+{
+  WordDivisor wd;
+
+  wd.shift = __builtin_clz ( m );
+  wd.d = m << wd.shift;
+  wd.v = (uint32_t)( UINT64_MAX / wd.d );
+
+  return wd;
+}
+
+///
+/// @return (u1*2^32 + u0) mod d for u1 < d, from a multiplication by the
+/// reciprocal and at most two corrections
+///
+static inline uint32_t mod_word_step ( WordDivisor const * const wd, uint32_t const u1, uint32_t const u0 )
+{
+  uint64_t const q = (uint64_t)wd->v*u1 + ( (uint64_t)u1 << 32 | u0 );
+  uint32_t r = u0 - ( (uint32_t)( q >> 32 ) + 1 )*wd->d;
+
+  if ( r > (uint32_t)q ) r += wd->d;
+  if ( r >= wd->d ) r -= wd->d;
+
+  return r;
+}
+
+///
+/// Reduces 32-bit words, least significant first, by Horner's rule modulo
+/// MOD_WORD_LANES divisors side by side: each step waits on the one before
+/// it, so the lanes' multiplications overlap. The words are shifted up with
+/// each divisor as they are read, which scales its remainder by the same
+/// power of two.
+///
+/// @param wd The divisors
+/// @param w The words
+/// @param words The number of words
+/// @param r Receives the words' value modulo each divisor
+///
+static void mod_words ( WordDivisor const * const wd, uint32_t const * const w, size_t const words, uint32_t * const r )
+{
+  size_t j;
+  int k;
+
+  for ( k = 0; k < MOD_WORD_LANES; ++ k )
+  {
+    r[k] = wd[k].shift && words ? w[words-1] >> ( 32 - wd[k].shift ) : 0;
+  }
+
+  for ( j = words; j > 0; -- j )
+  {
+    uint32_t const high = w[j-1], low = j > 1 ? w[j-2] : 0;
+
+    for ( k = 0; k < MOD_WORD_LANES; ++ k )
+    {
+      int const s = wd[k].shift;
+      r[k] = mod_word_step ( &wd[k], r[k], s ? high << s | low >> ( 32 - s ) : high );
+    }
+  }
+
+  for ( k = 0; k < MOD_WORD_LANES; ++ k ) r[k] >>= wd[k].shift;
+}
+
+///
+/// Computes the remainders of one BigInt modulo each of a list of moduli,
+/// regardless of sign (as bigint_modulo() does). Moduli of at most 32 bits
+/// reduce the 32-bit words of the dividend with precomputed reciprocals, a
+/// few moduli at a time and a multiplication per word in place of a
+/// division; larger moduli share a product/remainder tree, so the dividend
+/// is reduced once against their product and the remainders are pushed down
+/// the tree.
+///
+/// @param x The number being divided
+/// @param moduli The moduli, all nonzero
+/// @param n The number of moduli
+/// @param out An array of n pointers receiving the new remainders, each of
+/// which must be freed with bigint_free()
+///
+void bigint_mod_many ( BigInt const * const x, BigInt const * const * const moduli, size_t n, BigInt ** const out )
+{
+  MEMORY_GUARD_CATCH ( )
+  {
+    // the remainders already made have been freed
+    for ( size_t j = 0; j < n; ++ j ) out[j] = NULL;
+    return;
+  }
+
+  STATS_BEGIN ( x->count );
+  size_t words = ( (size_t)x->count + 31 ) / 32, i, k, large = 0, small = 0;
+  // the word moduli are padded out to whole groups of lanes with 1s
+  size_t const lanes = ( n + MOD_WORD_LANES - 1 ) / MOD_WORD_LANES * MOD_WORD_LANES;
+  uint32_t * w = _bigint_alloc ( (sizeof*w)*(words ? words : 1) );
+  BigInt const ** big = _bigint_alloc ( (sizeof*big)*(n ? n : 1) );
+  size_t * big_index = _bigint_alloc ( (sizeof*big_index)*(n ? n : 1) );
+  WordDivisor * wd = _bigint_alloc ( (sizeof*wd)*(lanes ? lanes : 1) );
+  size_t * word_index = _bigint_alloc ( (sizeof*word_index)*(n ? n : 1) );
+  Bit const * bit;
+
+  memset ( w, 0, (sizeof*w)*(words ? words : 1) );
+
+  for ( i = 0, bit = x->lsb; bit; bit = walk_toward_msb ( bit, 1 ), ++ i )
+  {
+    w[i/32] |= (uint32_t)bit->bit << (i%32);
+  }
+
+  for ( i = 0; i < n; ++ i )
+  {
+    uint64_t m;
+
+    if ( _bigint_to_uint64 ( moduli[i], &m ) && m != 0 && m <= UINT32_MAX )
+    {
+      wd[small] = word_divisor ( (uint32_t)m );
+      word_index[small++] = i;
+    }
+    else
+    {
+      big[large] = moduli[i];
+      big_index[large++] = i;
+    }
+  }
+
+  for ( k = small; k % MOD_WORD_LANES; ++ k ) wd[k] = word_divisor ( 1 );
+
+  for ( k = 0; k < small; k += MOD_WORD_LANES )
+  {
+    uint32_t r[MOD_WORD_LANES];
+
+    mod_words ( wd + k, w, words, r );
+    for ( i = 0; i < MOD_WORD_LANES && k + i < small; ++ i )
+    {
+      out[word_index[k+i]] = _bigint_init_uint64 ( r[i] );
+    }
+  }
+
+  if ( large > 0 )
+  {
+    BigInt ** remainders = _bigint_alloc ( (sizeof*remainders)*large );
+    ProductNode * root = product_node_build ( big, large );
+    RemainderJob job = { root, x, remainders };
+
+    remainder_tree_run ( &job );
+
+    for ( i = 0; i < large; ++ i ) out[big_index[i]] = remainders[i];
+
+    product_node_free ( root );
+    _bigint_free ( remainders, (sizeof*remainders)*large );
+  }
+
+  _bigint_free ( word_index, (sizeof*word_index)*(n ? n : 1) );
+  _bigint_free ( wd, (sizeof*wd)*(lanes ? lanes : 1) );
+  _bigint_free ( big_index, (sizeof*big_index)*(n ? n : 1) );
+  _bigint_free ( big, (sizeof*big)*(n ? n : 1) );
+  _bigint_free ( w, (sizeof*w)*(words ? words : 1) );
+
+  STATS_END ( BIGINT_OP_MOD_MANY );
+}
+
+///
+/// Solves a system of congruences over a contiguous range of moduli, merging
+/// the two halves of the range with one modular inversion.
+///
+/// @param residues The residues
+/// @param moduli The moduli
+/// @param n The number of congruences, at least one
+/// @param px The address receiving the solution in [0,M)
+/// @param pm The address receiving M, the product of the moduli
+///
+/// @return false if two of the moduli are not coprime (nothing is stored)
+///
+static bool crt_merge ( BigInt const * const * const residues, BigInt const * const * const moduli, size_t n, BigInt ** px, BigInt ** pm )
+{
+  BigInt * x1, * m1, * x2, * m2, * inverse, * t, * u;
+
+  if ( n == 1 )
+  {
+    *px = _bigint_mod_nonnegative ( residues[0], moduli[0] );
+    *pm = bigint_copy ( moduli[0] );
+    return true;
+  }
+
+  if ( !crt_merge ( residues, moduli, n / 2, &x1, &m1 ) ) return false;
+
+  if ( !crt_merge ( residues + n / 2, moduli + n / 2, n - n / 2, &x2, &m2 ) )
+  {
+    bigint_free ( x1 );
+    bigint_free ( m1 );
+    return false;
+  }
+
+  inverse = bigint_invmod ( m1, m2 );
+
+  if ( inverse )
+  {
+    // x = x1 + m1 * ((x2 - x1) * m1^-1 mod m2)
+    bigint_subtract_in_place ( x2, x1 );
+    t = _bigint_mod_nonnegative ( x2, m2 );
+    u = bigint_multiply ( t, inverse );
+    bigint_free ( t );
+    t = _bigint_mod_nonnegative ( u, m2 );
+    bigint_free ( u );
+
+    *px = bigint_multiply ( m1, t );
+    bigint_add_in_place ( *px, x1 );
+    *pm = bigint_multiply ( m1, m2 );
+
+    bigint_free ( t );
+    bigint_free ( inverse );
+  }
+
+  bigint_free ( x2 );
+  bigint_free ( m2 );
+  bigint_free ( x1 );
+  bigint_free ( m1 );
+
+  return inverse != NULL;
+}
+
+///
+/// Reconstructs a number from its residues by the Chinese remainder theorem,
+/// merging congruences pairwise up a balanced tree.
+///
+/// @param residues The residues of the number modulo each modulus
+/// @param moduli The moduli, which must be positive and pairwise coprime
+/// @param n The number of congruences
+///
+/// @return A new BigInt x in [0,M), M the product of the moduli, with x
+/// congruent to each residue modulo its modulus; or NULL if the moduli are not
+/// pairwise coprime. Must be freed with bigint_free().
+///
+BigInt * bigint_crt_reconstruct ( BigInt const * const * const residues, BigInt const * const * const moduli, size_t n )
+{
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( 0 );
+  BigInt * x = NULL, * m;
+
+  if ( n == 0 ) x = bigint_init ( 0 );
+  else if ( crt_merge ( residues, moduli, n, &x, &m ) ) bigint_free ( m );
+
+  STATS_BITS ( x ? x->count : 0 );
+  STATS_END ( BIGINT_OP_CRT );
+  return x;
+}
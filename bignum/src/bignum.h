@@ -2,9 +2,46 @@
 #define _BIGNUM_H
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define MAX2(x,y) (((x)>=(y))?x:y)
 
+// operands shorter than this many bits are multiplied by shift-and-add
+#define BIGINT_KARATSUBA_THRESHOLD 128
+// products of at least this many bits compute their sub-products in parallel
+#define BIGINT_PARALLEL_THRESHOLD 8192
+
+// binary serialization (see serialize.c)
+#define BIGINT_FORMAT_VERSION 1
+#define BIGINT_FORMAT_HEADER 16
+#define BIGINT_EXPORT_CHECKSUM 0x01
+#define BIGINT_FORMAT_NEGATIVE 0x02
+
+// memory-mapped store files (see store.c)
+#define BIGINT_STORE_VERSION 1
+#define BIGINT_STORE_SEQUENTIAL 1
+#define BIGINT_STORE_RANDOM 2
+#define BIGINT_STORE_WILLNEED 3
+
+// instruction set levels for kernel dispatch (see cpu.c); BIGNUM_CPU may
+// force a lower one by name. SSE4 is an x86-64 host with SSE4.2 and PCLMUL
+#define BIGINT_CPU_GENERIC 0
+#define BIGINT_CPU_SSE4 1
+
+// default budget, in bits, for radix power tables kept between conversions
+#define BIGINT_RADIX_CACHE_BITS (1 << 20)
+
+// what happens when memory runs out (see memory.c): the process exits, or the
+// failing call returns NULL, -1 or false and bigint_out_of_memory() is true
+#define BIGINT_OOM_EXIT 0
+#define BIGINT_OOM_STATUS 1
+
 typedef struct _tag_bit
 {
   bool bit;
@@ -17,8 +54,75 @@ typedef struct _tag_bigint
   int count;
   bool positive;
   Bit * lsb, * msb;
+  // number of BigInts sharing the bit list; allocated with the list's first
+  // bit (NULL before) and only counted by bigint_copy()
+  int * refs;
+  // nodes set aside by bigint_reserve() for growth, chained through next
+  Bit * spare;
+  int reserved;
 } BigInt;
 
+// operations counted when configured with --enable-stats (see stats.c)
+enum
+{
+  BIGINT_OP_COPY,
+  BIGINT_OP_ADD,
+  BIGINT_OP_SUBTRACT,
+  BIGINT_OP_SHIFT,
+  BIGINT_OP_MULTIPLY,
+  BIGINT_OP_ADDMUL,
+  BIGINT_OP_DIVIDE,
+  BIGINT_OP_MODULO,
+  BIGINT_OP_FACTORIAL,
+  BIGINT_OP_PRODUCT_LIST,
+  BIGINT_OP_MULMOD,
+  BIGINT_OP_INVMOD,
+  BIGINT_OP_MOD_MANY,
+  BIGINT_OP_CRT,
+  BIGINT_OP_TOSTRING,
+  BIGINT_OP_FROMSTRING,
+  BIGINT_OP_POWMOD,
+  BIGINT_OP_POW,
+  BIGINT_OP_DIVEXACT,
+  BIGINT_OP_INVMOD_BATCH,
+  BIGINT_OP_MULTI_POWMOD,
+  BIGINT_OP_COUNT
+};
+
+// latency histogram bucket k counts calls taking [2^k, 2^(k+1)) nanoseconds
+#define BIGINT_STATS_BUCKETS 48
+
+typedef struct _tag_bigint_op_stats
+{
+  uint64_t calls;
+  // operand bits summed over all calls
+  uint64_t bits;
+  // wall time, including library calls made along the way
+  uint64_t ns;
+  uint64_t histogram[BIGINT_STATS_BUCKETS];
+} BigIntOpStats;
+
+typedef struct _tag_bigint_stats
+{
+  BigIntOpStats ops[BIGINT_OP_COUNT];
+  uint64_t bit_allocs, bit_frees;
+  // bytes held in bit nodes now, and the most since the last reset
+  uint64_t live_bytes, peak_live_bytes;
+} BigIntStats;
+
+typedef struct _tag_bigint_store BigIntStore;
+typedef struct _tag_bigint_parser BigIntParser;
+typedef struct _tag_bigint_modctx BigModCtx;
+
+// receives successive pieces of a BigInt's text; nonzero return stops output
+typedef int (*BigIntWriteFn) ( void *, char const *, size_t );
+
+// replacements for malloc(), realloc() and free(); each is told the size of
+// the block and passed the context given to bigint_set_memory_functions()
+typedef void * (*BigIntAllocFn) ( size_t, void * );
+typedef void * (*BigIntReallocFn) ( void *, size_t, size_t, void * );
+typedef void (*BigIntFreeFn) ( void *, size_t, void * );
+
 /**
   * These functions form the public interface of this library.
   **/
@@ -39,8 +143,10 @@ bool bigint_pop_msb ( BigInt * const );
 bool bigint_positive ( BigInt const * const );
 void bigint_subtract_in_place ( BigInt * const, BigInt const * const );
 void bigint_swap ( BigInt * const, BigInt * const );
+void bigint_move ( BigInt * const, BigInt * const );
 BigInt * bigint_init_from_string ( char const * const );
 BigInt * bigint_divide ( BigInt const * const, BigInt const * const, BigInt ** );
+BigInt * bigint_divexact ( BigInt const * const, BigInt const * const );
 int bitlist_compare_magnitude_forward ( Bit const * const, Bit const * const, int );
 BigInt * bigint_binary_slice ( BigInt const * const, int const, int const );
 char * bigint_tostring_base2 ( BigInt const * const );
@@ -49,6 +155,83 @@ char * bigint_tostring_base10 ( BigInt const * const );
 int bigint_slice_bits ( BigInt const * const, int const, int const, int * const );
 BigInt * bigint_modulo ( BigInt const * const, BigInt const * const );
 BigInt * bigint_factorial ( BigInt const * const );
+BigInt * bigint_pow ( BigInt const * const, unsigned long const );
+BigInt * bigint_pow_ui ( unsigned long const, unsigned long const );
+int bigint_set_threads ( int );
+BigInt * bigint_product_list ( BigInt const * const * const, size_t );
+BigInt * bigint_product_list_int64 ( int64_t const * const, size_t );
+BigInt * bigint_invmod ( BigInt const * const, BigInt const * const );
+void bigint_addmul ( BigInt * const, BigInt const * const, BigInt const * const );
+void bigint_submul ( BigInt * const, BigInt const * const, BigInt const * const );
+BigInt * bigint_mulmod ( BigInt const * const, BigInt const * const, BigInt const * const );
+void bigint_mod_many ( BigInt const * const, BigInt const * const * const, size_t, BigInt ** const );
+BigInt * bigint_crt_reconstruct ( BigInt const * const * const, BigInt const * const * const, size_t );
+size_t bigint_export_size ( BigInt const * const, int const );
+size_t bigint_export_into ( BigInt const * const, int const, unsigned char * const, size_t const );
+unsigned char * bigint_export ( BigInt const * const, int const, size_t * const );
+size_t bigint_import_check ( unsigned char const * const, size_t const );
+BigInt * bigint_import ( unsigned char const * const, size_t const );
+int bigint_store_write ( char const * const, BigInt const * const * const, size_t const, int const );
+BigIntStore * bigint_store_open ( char const * const );
+void bigint_store_close ( BigIntStore * const );
+size_t bigint_store_count ( BigIntStore const * const );
+unsigned char const * bigint_store_record ( BigIntStore const * const, size_t const, size_t * const );
+BigInt * bigint_store_get ( BigIntStore const * const, size_t const );
+int bigint_store_advise ( BigIntStore const * const, int const );
+int bigint_write_base10 ( BigInt const * const, BigIntWriteFn const, void * const );
+int bigint_write_base10_file ( BigInt const * const, FILE * const );
+int bigint_write_base10_fd ( BigInt const * const, int );
+int bigint_write_radix ( BigInt const * const, int const, BigIntWriteFn const, void * const );
+char * bigint_tostring_radix ( BigInt const * const, int const );
+size_t bigint_sizeinbase ( BigInt const * const, int const );
+size_t bigint_tostring_base10_into ( BigInt const * const, char * const, size_t const );
+BigInt * bigint_init_from_radix ( char const * const, int const );
+size_t bigint_set_radix_cache_limit ( size_t const );
+BigIntParser * bigint_parser_new ( int const );
+int bigint_parser_feed ( BigIntParser * const, char const * const, size_t const );
+BigInt * bigint_parser_finish ( BigIntParser * const );
+void bigint_parser_free ( BigIntParser * const );
+char * bigint_tostring_pow2 ( BigInt const * const, int const );
+BigInt * bigint_init_from_pow2 ( char const * const, int const );
+char * bigint_tostring_base16 ( BigInt const * const );
+BigInt * bigint_init_from_hex ( char const * const );
+char * bigint_tostring_base32 ( BigInt const * const );
+BigInt * bigint_init_from_base32 ( char const * const );
+char * bigint_tostring_base64 ( BigInt const * const );
+BigInt * bigint_init_from_base64 ( char const * const );
+int bigint_cpu_level ( void );
+char const * bigint_cpu_level_name ( int const );
+bool bigint_stats_enabled ( void );
+void bigint_stats_snapshot ( BigIntStats * const );
+void bigint_stats_reset ( void );
+char const * bigint_stats_op_name ( int const );
+char * bigint_stats_json ( BigIntStats const * const );
+void bigint_set_memory_functions ( BigIntAllocFn const, BigIntReallocFn const, BigIntFreeFn const, void * const );
+void bigint_get_memory_functions ( BigIntAllocFn * const, BigIntReallocFn * const, BigIntFreeFn * const, void ** const );
+size_t bigint_set_memory_limit ( size_t const );
+size_t bigint_memory_in_use ( void );
+int bigint_set_oom_mode ( int const );
+bool bigint_out_of_memory ( void );
+void bigint_free_string ( char * const );
+void bigint_free_buffer ( void * const, size_t const );
+BigInt * bigint_init_reserve ( int const );
+bool bigint_reserve ( BigInt * const, int const );
+void bigint_shrink_to_fit ( BigInt * const );
+int bigint_capacity ( BigInt const * const );
+int bigint_bit_length ( BigInt const * const );
+BigModCtx * bigint_modctx_new ( BigInt const * const );
+void bigint_modctx_free ( BigModCtx * const );
+size_t bigint_modctx_limbs ( BigModCtx const * const );
+size_t bigint_modctx_scratch_limbs ( BigModCtx const * const );
+void bigint_modctx_in ( BigModCtx const * const, uint32_t * const, BigInt const * const, uint32_t * const );
+BigInt * bigint_modctx_out ( BigModCtx const * const, uint32_t const * const, uint32_t * const );
+void bigint_modctx_mulmod ( BigModCtx const * const, uint32_t * const, uint32_t const * const, uint32_t const * const, uint32_t * const );
+void bigint_modctx_sqrmod ( BigModCtx const * const, uint32_t * const, uint32_t const * const, uint32_t * const );
+void bigint_modctx_addmod ( BigModCtx const * const, uint32_t * const, uint32_t const * const, uint32_t const * const );
+void bigint_modctx_submod ( BigModCtx const * const, uint32_t * const, uint32_t const * const, uint32_t const * const );
+void bigint_modctx_powmod ( BigModCtx const * const, uint32_t * const, uint32_t const * const, BigInt const * const, uint32_t * const );
+int bigint_invmod_batch ( BigInt const * const * const, size_t const, BigInt const * const, BigInt ** const );
+BigInt * bigint_multi_powmod ( BigInt const * const * const, BigInt const * const * const, size_t const, BigInt const * const );
 
 /**
   * These are considered private. Please don't use them!
@@ -63,6 +246,18 @@ void _real_bigint_subtract_in_place ( BigInt * const, BigInt const * const );
 Bit const * walk_toward_msb ( Bit const *, int );
 Bit const * walk_toward_lsb ( Bit const *, int );
 int _bigint_remove_high_zeroes ( BigInt * const );
+void _bigint_unshare ( BigInt * const );
+BigInt * _bigint_multiply_schoolbook ( BigInt const * const, BigInt const * const );
+BigInt * _bigint_multiply_karatsuba ( BigInt const * const, BigInt const * const );
+BigInt * _bigint_init_uint64 ( uint64_t );
+bool _bigint_to_uint64 ( BigInt const * const, uint64_t * const );
+int _bigint_significant_bits ( BigInt const * const );
+BigInt * _bigint_mod_nonnegative ( BigInt const * const, BigInt const * const );
+uint32_t _bigint_crc32 ( unsigned char const * const, size_t const );
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // _BIGNUM_H
 
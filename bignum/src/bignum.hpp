@@ -0,0 +1,593 @@
+#ifndef _BIGNUM_HPP
+#define _BIGNUM_HPP
+
+/**
+  * A C++17 value type over the C interface in bignum.h. Each Int owns one
+  * BigInt and frees it when it goes out of scope. Copies are constant time
+  * (bigint_copy() shares bits until one side is modified) and moves only
+  * transfer the pointer; a moved-from Int is zero.
+  *
+  * Products are not computed by operator* itself but described by small
+  * expression objects, so that the kernel matching the whole expression runs
+  * when it is assigned: r = a*b + c accumulates into r with bigint_addmul(),
+  * a += b*c and a -= b*c use bigint_addmul() and bigint_submul(), and
+  * (a*b) % m calls bigint_mulmod(). The expression objects refer to their
+  * operands, so assign them to an Int straight away rather than keeping them
+  * in an auto variable.
+  **/
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_three_way_comparison) && __has_include(<compare>)
+#include <compare>
+#define BIGNUM_HAS_SPACESHIP 1
+#endif
+
+#include "bignum.h"
+
+namespace bignum
+{
+
+class Int;
+template <unsigned Bits> class FixedInt;
+struct MulExpr;
+struct AddMulExpr;
+struct MulMulExpr;
+struct MulModExpr;
+
+class Int
+{
+public:
+
+  ///
+  /// Constructs zero.
+  ///
+  Int ( ) noexcept : bi ( nullptr ) { }
+
+  ///
+  /// Constructs an Int from a native integer.
+  ///
+  template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+  Int ( T v ) : bi ( nullptr )
+  {
+    bool negative = v < 0;
+    uint64_t magnitude = negative ? 0 - (uint64_t)v : (uint64_t)v;
+
+    bi = checked ( _bigint_init_uint64 ( magnitude ) );
+    bi->positive = !negative;
+  }
+
+  ///
+  /// Parses an Int. See bigint_init_from_radix() for the digits accepted.
+  ///
+  /// @param text The digits, optionally preceded by a sign
+  /// @param base 2 to 62; or 0 to accept a "0x" or "0b" prefix
+  ///
+  /// @throws std::invalid_argument if the text is not a number in the base
+  ///
+  explicit Int ( std::string_view text, int base = 10 ) : bi ( nullptr )
+  {
+    BigIntParser * p = bigint_parser_new ( base );
+
+    if ( p )
+    {
+      bigint_parser_feed ( p, text.data ( ), text.size ( ) );
+      bi = bigint_parser_finish ( p );
+    }
+
+    if ( !bi )
+    {
+      check_memory ( );
+      throw std::invalid_argument ( "bignum::Int: malformed number" );
+    }
+  }
+
+  explicit Int ( std::string const & text, int base = 10 ) : Int ( std::string_view ( text ), base ) { }
+  explicit Int ( char const * text, int base = 10 ) : Int ( std::string_view ( text ), base ) { }
+
+  ///
+  /// Takes ownership of a BigInt from the C interface.
+  ///
+  static Int adopt ( BigInt * p ) noexcept
+  {
+    Int out;
+    out.bi = p;
+    return out;
+  }
+
+  Int ( Int const & other ) : bi ( other.bi ? checked ( bigint_copy ( other.bi ) ) : nullptr ) { }
+
+  Int ( Int && other ) noexcept : bi ( other.bi )
+  {
+    other.bi = nullptr;
+  }
+
+  Int & operator= ( Int const & other )
+  {
+    if ( this != &other ) Int ( other ).swap ( *this );
+    return *this;
+  }
+
+  Int & operator= ( Int && other ) noexcept
+  {
+    Int ( std::move ( other ) ).swap ( *this );
+    return *this;
+  }
+
+  ~Int ( )
+  {
+    bigint_free ( bi );
+  }
+
+  void swap ( Int & other ) noexcept
+  {
+    std::swap ( bi, other.bi );
+  }
+
+  ///
+  /// @return The underlying BigInt, for calls into the C interface; never
+  /// NULL. The Int keeps ownership.
+  ///
+  BigInt const * get ( ) const noexcept { return c ( ); }
+  BigInt * get ( ) { return m ( ); }
+
+  ///
+  /// Gives up ownership of the underlying BigInt, leaving this Int zero.
+  ///
+  /// @return The BigInt, which must be freed with bigint_free()
+  ///
+  BigInt * release ( )
+  {
+    BigInt * out = m ( );
+    bi = nullptr;
+    return out;
+  }
+
+  bool is_zero ( ) const noexcept { return _bigint_significant_bits ( c ( ) ) == 0; }
+  bool is_negative ( ) const noexcept { return !c ( )->positive && !is_zero ( ); }
+  explicit operator bool ( ) const noexcept { return !is_zero ( ); }
+  int bit_length ( ) const noexcept { return bigint_bit_length ( c ( ) ); }
+
+  ///
+  /// @param base 2 to 62
+  ///
+  /// @return The digits in the base. See bigint_write_radix().
+  ///
+  std::string str ( int base = 10 ) const
+  {
+    std::string out;
+
+    if ( base < 2 || base > 62 ) throw std::invalid_argument ( "bignum::Int: unsupported base" );
+    out.reserve ( bigint_sizeinbase ( c ( ), base ) + 1 );
+    bigint_write_radix ( c ( ), base, append_to, &out );
+    check_memory ( );
+
+    return out;
+  }
+
+  explicit operator std::string ( ) const { return str ( ); }
+
+  Int & operator+= ( Int const & rhs )
+  {
+    bigint_add_in_place ( m ( ), rhs.c ( ) );
+    check_memory ( );
+    return *this;
+  }
+
+  Int & operator-= ( Int const & rhs )
+  {
+    bigint_subtract_in_place ( m ( ), rhs.c ( ) );
+    check_memory ( );
+    return *this;
+  }
+
+  Int & operator*= ( Int const & rhs )
+  {
+    return *this = adopt ( checked ( bigint_multiply ( c ( ), rhs.c ( ) ) ) );
+  }
+
+  ///
+  /// Divides, truncating toward zero as the built-in integers do.
+  ///
+  /// @throws std::domain_error on division by zero
+  ///
+  Int & operator/= ( Int const & rhs )
+  {
+    divide ( rhs, this, nullptr );
+    return *this;
+  }
+
+  ///
+  /// Takes the remainder of truncating division; it has the sign of the
+  /// dividend, as with the built-in integers.
+  ///
+  /// @throws std::domain_error on division by zero
+  ///
+  Int & operator%= ( Int const & rhs )
+  {
+    divide ( rhs, nullptr, this );
+    return *this;
+  }
+
+  ///
+  /// Shifts the magnitude; the sign is kept.
+  ///
+  Int & operator<<= ( int bits )
+  {
+    bigint_shift_left ( m ( ), bits );
+    check_memory ( );
+    return *this;
+  }
+
+  Int & operator>>= ( int bits )
+  {
+    bigint_shift_right ( m ( ), bits );
+    check_memory ( );
+    if ( is_zero ( ) ) m ( )->positive = true;
+    return *this;
+  }
+
+  Int operator- ( ) const
+  {
+    Int out ( *this );
+    out.negate ( );
+    return out;
+  }
+
+  Int operator+ ( ) const { return *this; }
+
+  Int & operator++ ( ) { return *this += 1; }
+  Int & operator-- ( ) { return *this -= 1; }
+
+  // evaluation of the expressions built by the operators below
+  Int ( MulExpr const & );
+  Int ( AddMulExpr const & );
+  Int ( MulMulExpr const & );
+  Int ( MulModExpr const & );
+  Int & operator= ( MulExpr const & );
+  Int & operator= ( AddMulExpr const & );
+  Int & operator= ( MulMulExpr const & );
+  Int & operator= ( MulModExpr const & );
+  Int & operator+= ( MulExpr const & );
+  Int & operator-= ( MulExpr const & );
+
+  ///
+  /// @return A negative number, zero or a positive number as lhs is less
+  /// than, equal to or greater than rhs
+  ///
+  static int compare ( Int const & lhs, Int const & rhs ) noexcept
+  {
+    // zero may carry either sign
+    if ( lhs.is_zero ( ) && rhs.is_zero ( ) ) return 0;
+    return bigint_compare ( lhs.c ( ), rhs.c ( ) );
+  }
+
+  ///
+  /// @return A hash of the value; equal Ints hash equally
+  ///
+  std::size_t hash ( ) const noexcept
+  {
+    BigInt const * v = c ( );
+    int bits = _bigint_significant_bits ( v ), i;
+    Bit const * bit = v->lsb;
+    uint64_t h = ( bits && !v->positive ) ? 0x9e3779b97f4a7c15u : 0, word = 0;
+
+    for ( i = 0; i < bits; ++ i, bit = walk_toward_msb ( bit, 1 ) )
+    {
+      word |= (uint64_t)bit->bit << ( i % 64 );
+      if ( i % 64 == 63 || i == bits - 1 )
+      {
+        h = ( h ^ word ) * 0x100000001b3u;
+        h ^= h >> 29;
+        word = 0;
+      }
+    }
+
+    return std::hash<uint64_t> { } ( h );
+  }
+
+  ///
+  /// Writes the value in the stream's base (std::hex, std::oct or decimal).
+  ///
+  std::ostream & write ( std::ostream & os ) const
+  {
+    std::ios_base::fmtflags base = os.flags ( ) & std::ios_base::basefield;
+
+    bigint_write_radix ( c ( ),
+                         base == std::ios_base::hex ? 16 : base == std::ios_base::oct ? 8 : 10,
+                         write_to_stream, &os );
+    check_memory ( );
+    return os;
+  }
+
+private:
+
+  template <unsigned> friend class FixedInt;
+
+  // NULL stands for zero, so that moves never allocate
+  BigInt * bi;
+
+  inline static BigInt const zero = { 0, true, nullptr, nullptr, nullptr, nullptr, 0 };
+
+  BigInt const * c ( ) const noexcept
+  {
+    return bi ? bi : &zero;
+  }
+
+  BigInt * m ( )
+  {
+    if ( !bi ) bi = checked ( bigint_init_empty ( ) );
+    return bi;
+  }
+
+  ///
+  /// Turns a NULL result, or a call that ran out of memory, into
+  /// std::bad_alloc when the library is in BIGINT_OOM_STATUS mode.
+  ///
+  static BigInt * checked ( BigInt * p )
+  {
+    if ( !p ) throw std::bad_alloc ( );
+    return p;
+  }
+
+  static void check_memory ( )
+  {
+    if ( bigint_out_of_memory ( ) ) throw std::bad_alloc ( );
+  }
+
+  ///
+  /// Truncating division on magnitudes with the signs fixed up afterwards.
+  ///
+  void divide ( Int const & rhs, Int * quotient, Int * remainder ) const
+  {
+    Int a ( *this ), b ( rhs );
+    BigInt * r;
+    bool negative = is_negative ( );
+
+    if ( rhs.is_zero ( ) ) throw std::domain_error ( "bignum::Int: division by zero" );
+
+    // bigint_divide() works on magnitudes and hands back the divisor as the
+    // remainder of a zero dividend
+    if ( is_zero ( ) )
+    {
+      if ( quotient ) *quotient = Int ( );
+      if ( remainder ) *remainder = Int ( );
+      return;
+    }
+
+    a.m ( )->positive = true;
+    b.m ( )->positive = true;
+
+    Int q = adopt ( checked ( bigint_divide ( a.c ( ), b.c ( ), &r ) ) );
+    Int rem = adopt ( r );
+
+    _bigint_remove_high_zeroes ( rem.m ( ) );
+    check_memory ( );
+    if ( quotient )
+    {
+      if ( negative != rhs.is_negative ( ) && !q.is_zero ( ) ) q.m ( )->positive = false;
+      *quotient = std::move ( q );
+    }
+    if ( remainder )
+    {
+      if ( negative && !rem.is_zero ( ) ) rem.m ( )->positive = false;
+      *remainder = std::move ( rem );
+    }
+  }
+
+  ///
+  /// Adds or subtracts a product into this Int.
+  ///
+  void accumulate ( MulExpr const & p, bool negate );
+
+  ///
+  /// Flips the sign of a nonzero value.
+  ///
+  void negate ( )
+  {
+    if ( !is_zero ( ) ) m ( )->positive = !c ( )->positive;
+  }
+
+  static int append_to ( void * ctx, char const * buf, size_t len )
+  {
+    static_cast<std::string *> ( ctx )->append ( buf, len );
+    return 0;
+  }
+
+  static int write_to_stream ( void * ctx, char const * buf, size_t len )
+  {
+    std::ostream & os = *static_cast<std::ostream *> ( ctx );
+    os.write ( buf, len );
+    return os ? 0 : -1;
+  }
+};
+
+///
+/// a*b, computed when it is assigned or combined.
+///
+struct MulExpr
+{
+  Int const & a;
+  Int const & b;
+};
+
+///
+/// c + p or c - p for a product p, with c optionally negated: the shape
+/// bigint_addmul() and bigint_submul() compute in place.
+///
+struct AddMulExpr
+{
+  Int const & c;
+  MulExpr p;
+  bool negate_c;
+  bool negate_p;
+};
+
+///
+/// x + y or x - y for products x and y.
+///
+struct MulMulExpr
+{
+  MulExpr x;
+  MulExpr y;
+  bool negate_y;
+};
+
+///
+/// p % m for a product p, with the sign of p as for Int::operator%=.
+///
+struct MulModExpr
+{
+  MulExpr p;
+  Int const & m;
+};
+
+inline void Int::accumulate ( MulExpr const & p, bool negate )
+{
+  negate ? bigint_submul ( m ( ), p.a.c ( ), p.b.c ( ) )
+         : bigint_addmul ( m ( ), p.a.c ( ), p.b.c ( ) );
+  check_memory ( );
+}
+
+inline Int::Int ( MulExpr const & e ) : bi ( checked ( bigint_multiply ( e.a.c ( ), e.b.c ( ) ) ) ) { }
+
+inline Int::Int ( AddMulExpr const & e ) : Int ( e.c )
+{
+  if ( e.negate_c ) negate ( );
+  accumulate ( e.p, e.negate_p );
+}
+
+inline Int::Int ( MulMulExpr const & e ) : Int ( e.x )
+{
+  accumulate ( e.y, e.negate_y );
+}
+
+inline Int::Int ( MulModExpr const & e ) : bi ( nullptr )
+{
+  Int x ( e.p.a ), y ( e.p.b ), modulus ( e.m );
+
+  if ( e.m.is_zero ( ) ) throw std::domain_error ( "bignum::Int: division by zero" );
+
+  // bigint_mulmod() reduces magnitudes into [0,m); the sign follows the
+  // product as it does for operator%
+  x.m ( )->positive = y.m ( )->positive = modulus.m ( )->positive = true;
+  *this = adopt ( checked ( bigint_mulmod ( x.c ( ), y.c ( ), modulus.c ( ) ) ) );
+  if ( e.p.a.is_negative ( ) != e.p.b.is_negative ( ) ) negate ( );
+}
+
+inline Int & Int::operator= ( MulExpr const & e )
+{
+  return *this = adopt ( checked ( bigint_multiply ( e.a.c ( ), e.b.c ( ) ) ) );
+}
+
+inline Int & Int::operator= ( AddMulExpr const & e )
+{
+  // the product's operands must stay intact while it accumulates
+  if ( this == &e.p.a || this == &e.p.b ) return *this = Int ( e );
+
+  if ( this != &e.c ) *this = e.c;
+  if ( e.negate_c ) negate ( );
+  accumulate ( e.p, e.negate_p );
+
+  return *this;
+}
+
+inline Int & Int::operator= ( MulMulExpr const & e )
+{
+  if ( this == &e.y.a || this == &e.y.b ) return *this = Int ( e );
+
+  *this = e.x;
+  accumulate ( e.y, e.negate_y );
+
+  return *this;
+}
+
+inline Int & Int::operator= ( MulModExpr const & e )
+{
+  return *this = Int ( e );
+}
+
+inline Int & Int::operator+= ( MulExpr const & e )
+{
+  accumulate ( e, false );
+  return *this;
+}
+
+inline Int & Int::operator-= ( MulExpr const & e )
+{
+  accumulate ( e, true );
+  return *this;
+}
+
+inline MulExpr operator* ( Int const & a, Int const & b ) { return { a, b }; }
+inline AddMulExpr operator+ ( MulExpr const & p, Int const & c ) { return { c, p, false, false }; }
+inline AddMulExpr operator+ ( Int const & c, MulExpr const & p ) { return { c, p, false, false }; }
+inline AddMulExpr operator- ( MulExpr const & p, Int const & c ) { return { c, p, true, false }; }
+inline AddMulExpr operator- ( Int const & c, MulExpr const & p ) { return { c, p, false, true }; }
+inline MulMulExpr operator+ ( MulExpr const & x, MulExpr const & y ) { return { x, y, false }; }
+inline MulMulExpr operator- ( MulExpr const & x, MulExpr const & y ) { return { x, y, true }; }
+inline MulModExpr operator% ( MulExpr const & p, Int const & m ) { return { p, m }; }
+inline Int operator- ( MulExpr const & p ) { return -Int ( p ); }
+
+inline Int operator+ ( Int lhs, Int const & rhs ) { return std::move ( lhs += rhs ); }
+inline Int operator- ( Int lhs, Int const & rhs ) { return std::move ( lhs -= rhs ); }
+inline Int operator/ ( Int lhs, Int const & rhs ) { return std::move ( lhs /= rhs ); }
+inline Int operator% ( Int lhs, Int const & rhs ) { return std::move ( lhs %= rhs ); }
+inline Int operator<< ( Int lhs, int bits ) { return std::move ( lhs <<= bits ); }
+inline Int operator>> ( Int lhs, int bits ) { return std::move ( lhs >>= bits ); }
+
+inline bool operator== ( Int const & lhs, Int const & rhs ) noexcept { return Int::compare ( lhs, rhs ) == 0; }
+inline bool operator!= ( Int const & lhs, Int const & rhs ) noexcept { return Int::compare ( lhs, rhs ) != 0; }
+inline bool operator< ( Int const & lhs, Int const & rhs ) noexcept { return Int::compare ( lhs, rhs ) < 0; }
+inline bool operator<= ( Int const & lhs, Int const & rhs ) noexcept { return Int::compare ( lhs, rhs ) <= 0; }
+inline bool operator> ( Int const & lhs, Int const & rhs ) noexcept { return Int::compare ( lhs, rhs ) > 0; }
+inline bool operator>= ( Int const & lhs, Int const & rhs ) noexcept { return Int::compare ( lhs, rhs ) >= 0; }
+
+#ifdef BIGNUM_HAS_SPACESHIP
+inline std::strong_ordering operator<=> ( Int const & lhs, Int const & rhs ) noexcept
+{
+  return Int::compare ( lhs, rhs ) <=> 0;
+}
+#endif
+
+inline std::ostream & operator<< ( std::ostream & os, Int const & v )
+{
+  return v.write ( os );
+}
+
+inline void swap ( Int & a, Int & b ) noexcept
+{
+  a.swap ( b );
+}
+
+inline std::string to_string ( Int const & v )
+{
+  return v.str ( );
+}
+
+} // namespace bignum
+
+namespace std
+{
+
+template <>
+struct hash<bignum::Int>
+{
+  size_t operator() ( bignum::Int const & v ) const noexcept
+  {
+    return v.hash ( );
+  }
+};
+
+} // namespace std
+
+#endif // _BIGNUM_HPP
@@ -0,0 +1,412 @@
+#ifndef _BIGNUM_FIXED_HPP
+#define _BIGNUM_FIXED_HPP
+
+/**
+  * bignum::FixedInt<Bits> is an unsigned integer of a fixed width, kept in an
+  * array of 64-bit limbs on the stack. Arithmetic wraps modulo 2^Bits like
+  * the built-in unsigned types, never allocates, and is constexpr, so
+  * constants such as moduli and powers of ten can be computed at compile
+  * time. Every loop runs over a compile-time number of limbs, which the
+  * compiler unrolls for the width.
+  *
+  * FixedInt converts to and from bignum::Int; converting an Int that does not
+  * fit keeps its low Bits bits (two's complement for negative values).
+  **/
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "bignum.hpp"
+
+namespace bignum
+{
+
+template <unsigned Bits>
+class FixedInt
+{
+  static_assert ( Bits > 0, "FixedInt needs at least one bit" );
+
+public:
+
+  static constexpr unsigned bits = Bits;
+  static constexpr std::size_t limbs = ( Bits + 63 ) / 64;
+
+  constexpr FixedInt ( ) noexcept : limb { } { }
+
+  constexpr FixedInt ( uint64_t v ) noexcept : limb { }
+  {
+    limb[0] = v;
+    trim ( );
+  }
+
+  ///
+  /// Parses digits at compile time or run time.
+  ///
+  /// @param text Decimal digits, or hexadecimal after "0x"
+  ///
+  /// @throws std::invalid_argument if a character is not a digit (a compile
+  /// error in a constant expression)
+  ///
+  static constexpr FixedInt parse ( std::string_view text )
+  {
+    FixedInt out;
+    uint64_t base = 10;
+    std::size_t i = 0;
+
+    if ( text.size ( ) > 2 && text[0] == '0' && ( text[1] == 'x' || text[1] == 'X' ) )
+    {
+      base = 16;
+      i = 2;
+    }
+
+    if ( i == text.size ( ) ) throw std::invalid_argument ( "bignum::FixedInt: no digits" );
+
+    for ( ; i < text.size ( ); ++ i )
+    {
+      char c = text[i];
+      uint64_t v = c >= '0' && c <= '9' ? c - '0'
+                 : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                 : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                 : 99;
+
+      if ( v >= base ) throw std::invalid_argument ( "bignum::FixedInt: bad digit" );
+
+      out = out.mul_small ( base );
+      out += FixedInt ( v );
+    }
+
+    return out;
+  }
+
+  ///
+  /// Converts from the dynamic type, keeping the low Bits bits.
+  ///
+  explicit FixedInt ( Int const & v ) : limb { }
+  {
+    Bit const * bit = v.get ( )->lsb;
+    unsigned i;
+
+    for ( i = 0; i < Bits && bit; ++ i, bit = walk_toward_msb ( bit, 1 ) )
+    {
+      limb[i / 64] |= (uint64_t)bit->bit << ( i % 64 );
+    }
+
+    if ( v.is_negative ( ) ) *this = -*this;
+  }
+
+  ///
+  /// Converts to the dynamic type.
+  ///
+  Int to_int ( ) const
+  {
+    unsigned i, top = bit_length ( );
+    // the nodes are all taken up front, so running out of memory throws here
+    // and the appends below only link reserved nodes
+    BigInt * out = Int::checked ( bigint_init_reserve ( (int)top ) );
+
+    for ( i = 0; i < top; ++ i )
+    {
+      append_bit ( out, ( limb[i / 64] >> ( i % 64 ) ) & 1 );
+    }
+
+    return Int::adopt ( out );
+  }
+
+  explicit operator Int ( ) const { return to_int ( ); }
+
+  std::string str ( int base = 10 ) const { return to_int ( ).str ( base ); }
+
+  constexpr uint64_t word ( std::size_t i ) const noexcept { return limb[i]; }
+
+  constexpr bool is_zero ( ) const noexcept
+  {
+    for ( std::size_t i = 0; i < limbs; ++ i ) if ( limb[i] ) return false;
+    return true;
+  }
+
+  explicit constexpr operator bool ( ) const noexcept { return !is_zero ( ); }
+
+  ///
+  /// @return The number of bits up to and including the highest set bit
+  ///
+  constexpr unsigned bit_length ( ) const noexcept
+  {
+    for ( std::size_t i = limbs; i -- > 0; )
+    {
+      if ( limb[i] )
+      {
+        unsigned n = 64 * i;
+        for ( uint64_t w = limb[i]; w; w >>= 1 ) ++ n;
+        return n;
+      }
+    }
+    return 0;
+  }
+
+  constexpr bool bit ( unsigned i ) const noexcept
+  {
+    return i < Bits && ( ( limb[i / 64] >> ( i % 64 ) ) & 1 );
+  }
+
+  constexpr FixedInt & operator+= ( FixedInt const & rhs ) noexcept
+  {
+    uint64_t carry = 0;
+
+    for ( std::size_t i = 0; i < limbs; ++ i )
+    {
+      uint64_t s = limb[i] + rhs.limb[i];
+      uint64_t c = s < limb[i];
+      limb[i] = s + carry;
+      carry = c | ( limb[i] < s );
+    }
+
+    trim ( );
+    return *this;
+  }
+
+  constexpr FixedInt & operator-= ( FixedInt const & rhs ) noexcept
+  {
+    uint64_t borrow = 0;
+
+    for ( std::size_t i = 0; i < limbs; ++ i )
+    {
+      uint64_t d = limb[i] - rhs.limb[i];
+      uint64_t b = limb[i] < rhs.limb[i];
+      limb[i] = d - borrow;
+      borrow = b | ( d < borrow );
+    }
+
+    trim ( );
+    return *this;
+  }
+
+  ///
+  /// Multiplies, keeping the low Bits bits of the product.
+  ///
+  constexpr FixedInt & operator*= ( FixedInt const & rhs ) noexcept
+  {
+    FixedInt out;
+
+    for ( std::size_t i = 0; i < limbs; ++ i )
+    {
+      uint64_t carry = 0;
+
+      for ( std::size_t j = 0; i + j < limbs; ++ j )
+      {
+        uint64_t hi = 0, lo = mul64 ( limb[i], rhs.limb[j], hi );
+
+        lo += carry;
+        hi += lo < carry;
+        out.limb[i+j] += lo;
+        hi += out.limb[i+j] < lo;
+        carry = hi;
+      }
+    }
+
+    out.trim ( );
+    return *this = out;
+  }
+
+  ///
+  /// @throws std::domain_error on division by zero
+  ///
+  constexpr FixedInt & operator/= ( FixedInt const & rhs )
+  {
+    FixedInt r;
+    divmod ( *this, rhs, *this, r );
+    return *this;
+  }
+
+  ///
+  /// @throws std::domain_error on division by zero
+  ///
+  constexpr FixedInt & operator%= ( FixedInt const & rhs )
+  {
+    FixedInt q;
+    divmod ( *this, rhs, q, *this );
+    return *this;
+  }
+
+  ///
+  /// Computes the quotient and remainder together by shift-and-subtract.
+  ///
+  /// @throws std::domain_error on division by zero
+  ///
+  static constexpr void divmod ( FixedInt const & a, FixedInt const & b, FixedInt & q, FixedInt & r )
+  {
+    FixedInt quotient, rem;
+
+    if ( b.is_zero ( ) ) throw std::domain_error ( "bignum::FixedInt: division by zero" );
+
+    for ( unsigned i = a.bit_length ( ); i -- > 0; )
+    {
+      // rem < b, so doubling it can overflow only when b uses the top bit
+      bool overflow = rem.bit ( Bits - 1 );
+
+      rem <<= 1;
+      rem.limb[0] |= a.bit ( i );
+
+      if ( overflow || rem >= b )
+      {
+        rem -= b;
+        quotient.limb[i / 64] |= (uint64_t)1 << ( i % 64 );
+      }
+    }
+
+    q = quotient;
+    r = rem;
+  }
+
+  constexpr FixedInt & operator<<= ( unsigned n ) noexcept
+  {
+    std::size_t shift = n / 64;
+    unsigned part = n % 64;
+
+    for ( std::size_t i = limbs; i -- > 0; )
+    {
+      uint64_t v = i >= shift ? limb[i - shift] << part : 0;
+      if ( part && i > shift ) v |= limb[i - shift - 1] >> ( 64 - part );
+      limb[i] = n < Bits ? v : 0;
+    }
+
+    trim ( );
+    return *this;
+  }
+
+  constexpr FixedInt & operator>>= ( unsigned n ) noexcept
+  {
+    std::size_t shift = n / 64;
+    unsigned part = n % 64;
+
+    for ( std::size_t i = 0; i < limbs; ++ i )
+    {
+      uint64_t v = i + shift < limbs ? limb[i + shift] >> part : 0;
+      if ( part && i + shift + 1 < limbs ) v |= limb[i + shift + 1] << ( 64 - part );
+      limb[i] = n < Bits ? v : 0;
+    }
+
+    return *this;
+  }
+
+  constexpr FixedInt & operator&= ( FixedInt const & rhs ) noexcept
+  {
+    for ( std::size_t i = 0; i < limbs; ++ i ) limb[i] &= rhs.limb[i];
+    return *this;
+  }
+
+  constexpr FixedInt & operator|= ( FixedInt const & rhs ) noexcept
+  {
+    for ( std::size_t i = 0; i < limbs; ++ i ) limb[i] |= rhs.limb[i];
+    return *this;
+  }
+
+  constexpr FixedInt & operator^= ( FixedInt const & rhs ) noexcept
+  {
+    for ( std::size_t i = 0; i < limbs; ++ i ) limb[i] ^= rhs.limb[i];
+    return *this;
+  }
+
+  constexpr FixedInt operator~ ( ) const noexcept
+  {
+    FixedInt out;
+    for ( std::size_t i = 0; i < limbs; ++ i ) out.limb[i] = ~limb[i];
+    out.trim ( );
+    return out;
+  }
+
+  constexpr FixedInt operator- ( ) const noexcept
+  {
+    return ~*this + FixedInt ( 1 );
+  }
+
+  ///
+  /// @return -1, 0 or 1 as a is less than, equal to or greater than b
+  ///
+  static constexpr int compare ( FixedInt const & a, FixedInt const & b ) noexcept
+  {
+    for ( std::size_t i = limbs; i -- > 0; )
+    {
+      if ( a.limb[i] != b.limb[i] ) return a.limb[i] < b.limb[i] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  friend constexpr FixedInt operator+ ( FixedInt a, FixedInt const & b ) noexcept { return a += b; }
+  friend constexpr FixedInt operator- ( FixedInt a, FixedInt const & b ) noexcept { return a -= b; }
+  friend constexpr FixedInt operator* ( FixedInt a, FixedInt const & b ) noexcept { return a *= b; }
+  friend constexpr FixedInt operator/ ( FixedInt a, FixedInt const & b ) { return a /= b; }
+  friend constexpr FixedInt operator% ( FixedInt a, FixedInt const & b ) { return a %= b; }
+  friend constexpr FixedInt operator<< ( FixedInt a, unsigned n ) noexcept { return a <<= n; }
+  friend constexpr FixedInt operator>> ( FixedInt a, unsigned n ) noexcept { return a >>= n; }
+  friend constexpr FixedInt operator& ( FixedInt a, FixedInt const & b ) noexcept { return a &= b; }
+  friend constexpr FixedInt operator| ( FixedInt a, FixedInt const & b ) noexcept { return a |= b; }
+  friend constexpr FixedInt operator^ ( FixedInt a, FixedInt const & b ) noexcept { return a ^= b; }
+
+  friend constexpr bool operator== ( FixedInt const & a, FixedInt const & b ) noexcept { return compare ( a, b ) == 0; }
+  friend constexpr bool operator!= ( FixedInt const & a, FixedInt const & b ) noexcept { return compare ( a, b ) != 0; }
+  friend constexpr bool operator< ( FixedInt const & a, FixedInt const & b ) noexcept { return compare ( a, b ) < 0; }
+  friend constexpr bool operator<= ( FixedInt const & a, FixedInt const & b ) noexcept { return compare ( a, b ) <= 0; }
+  friend constexpr bool operator> ( FixedInt const & a, FixedInt const & b ) noexcept { return compare ( a, b ) > 0; }
+  friend constexpr bool operator>= ( FixedInt const & a, FixedInt const & b ) noexcept { return compare ( a, b ) >= 0; }
+
+private:
+
+  uint64_t limb[limbs];
+
+  ///
+  /// Clears the bits of the top limb above Bits.
+  ///
+  constexpr void trim ( ) noexcept
+  {
+    if ( Bits % 64 ) limb[limbs - 1] &= ( (uint64_t)1 << ( Bits % 64 ) ) - 1;
+  }
+
+  ///
+  /// Multiplies by a single limb.
+  ///
+  constexpr FixedInt mul_small ( uint64_t v ) const noexcept
+  {
+    FixedInt out;
+    uint64_t carry = 0;
+
+    for ( std::size_t i = 0; i < limbs; ++ i )
+    {
+      uint64_t hi = 0, lo = mul64 ( limb[i], v, hi );
+
+      lo += carry;
+      hi += lo < carry;
+      out.limb[i] = lo;
+      carry = hi;
+    }
+
+    out.trim ( );
+    return out;
+  }
+
+  ///
+  /// Full 64x64-bit product from 32-bit halves, usable in constant
+  /// expressions on every compiler.
+  ///
+  /// @return The low 64 bits; the high 64 bits go to hi
+  ///
+  static constexpr uint64_t mul64 ( uint64_t a, uint64_t b, uint64_t & hi ) noexcept
+  {
+    uint64_t a0 = a & 0xffffffffu, a1 = a >> 32;
+    uint64_t b0 = b & 0xffffffffu, b1 = b >> 32;
+    uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    uint64_t mid = ( p00 >> 32 ) + ( p01 & 0xffffffffu ) + ( p10 & 0xffffffffu );
+
+    hi = p11 + ( p01 >> 32 ) + ( p10 >> 32 ) + ( mid >> 32 );
+    return ( mid << 32 ) | ( p00 & 0xffffffffu );
+  }
+};
+
+using UInt256 = FixedInt<256>;
+using UInt512 = FixedInt<512>;
+
+} // namespace bignum
+
+#endif // _BIGNUM_FIXED_HPP
@@ -0,0 +1,30 @@
+#ifndef _BIGNUM_BYTEORDER_H
+#define _BIGNUM_BYTEORDER_H
+
+/**
+  * Little-endian byte order for the serialization and store formats, which
+  * read the same on every host. This is private to the library.
+  **/
+
+#include <stdint.h>
+
+///
+/// Stores a value as little-endian bytes.
+///
+static inline void put_le ( unsigned char * const out, uint64_t v, int bytes )
+{
+  int i;
+  for ( i = 0; i < bytes; ++ i, v >>= 8 ) out[i] = v & 0xff;
+}
+
+///
+/// Loads a value from little-endian bytes.
+///
+static inline uint64_t get_le ( unsigned char const * const in, int bytes )
+{
+  uint64_t v = 0;
+  while ( bytes -- ) v = ( v << 8 ) | in[bytes];
+  return v;
+}
+
+#endif // _BIGNUM_BYTEORDER_H
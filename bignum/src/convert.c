@@ -0,0 +1,1432 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bignum.h"
+#include "stats.h"
+#include "probes.h"
+#include "memory.h"
+
+// digits are handed to the writer in pieces of at most this many bytes
+#define SINK_SIZE 4096
+
+// a power table never needs more levels than a bit count has bits
+#define RADIX_LEVELS 64
+
+// digit alphabets: bases up to 36 are written in lowercase and read in either
+// case; larger bases use both cases as distinct digits
+static char const radix_digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+static char const wide_digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+static char const base32_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static char const base64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// log(2)/log(base) as a 64-bit binary fraction, rounded up; 0 for powers of
+// two, which bigint_sizeinbase() counts exactly
+static uint64_t const log2_fractions[63] =
+{
+  0, 0, 0, 0xa1849cc1a9a9e94f,
+  0, 0x6e40d1a4143dcb95, 0x6308c91b702a7cf5, 0x5b3064eb3aa6d389,
+  0, 0x50c24e60d4d4f4a8, 0x4d104d427de7fbcd, 0x4a00270775914e89,
+  0x4768ce0d05818e13, 0x452e53e365907bdb, 0x433cfffb4b5aae56, 0x41867711b4f85356,
+  0, 0x3ea16afd58b10967, 0x3d64598d154dc4df, 0x3c43c23018bb5564,
+  0x3b3b9a42873069c8, 0x3a4898f06cf41aca, 0x39680b13582e7c19, 0x3897b2b751ae561b,
+  0x37d5aed131f19c99, 0x372068d20a1ee5cb, 0x3676867e5d60de2a, 0x35d6deeb388df870,
+  0x354071d61c77fa2f, 0x34b260c5671b18ad, 0x342be986572b45cd, 0x33ac61b998fbbdf3,
+  0, 0x32bfd90114c12862, 0x3251dcf6169e45f3, 0x31e8d59f180dc631,
+  0x3184648db8153e7b, 0x312434e89c35dace, 0x30c7fa349460a542, 0x306f6f4c8432bc6e,
+  0x301a557ffbfdd253, 0x2fc873d1fda55f3c, 0x2f799652a4e6dc4a, 0x2f2d8d8f64460aae,
+  0x2ee42e164e8f53a5, 0x2e9d500984041dbe, 0x2e58cec05a6a8145, 0x2e1688743ef9104d,
+  0x2dd65df7a5835990, 0x2d9832759d5369c5, 0x2d5beb38dcd1394d, 0x2d216f7943e2ba6b,
+  0x2ce8a82efbb3ff2d, 0x2cb17fea7ad7e333, 0x2c7be2b0cfa1ba51, 0x2c47bddba92d7464,
+  0x2c14fffcaa8b131f, 0x2be398c3a38be054, 0x2bb378e758451069, 0x2b8492108be5e5f8,
+  0x2b56d6c70d55481c, 0x2b2a3a608c72ddd6, 0x2afeb0f1060c7e42,
+};
+
+///
+/// The powers of one base used to split numbers for output and to join them
+/// on input. A chunk is the largest power base^digits below 2^32, and
+/// powers[k] = chunk^(2^k). Entries are only ever appended, so a thread may
+/// read any entry below a level it has ensured while others extend the table.
+///
+typedef struct _tag_radix_table
+{
+  int base;
+  int digits;
+  uint32_t chunk;
+
+  // guards powers, levels and bits
+  pthread_mutex_t lock;
+  BigInt * powers[RADIX_LEVELS];
+  int levels;
+  size_t bits;
+
+  // guarded by cache_lock
+  int users;
+  bool cached;
+  size_t accounted;
+  unsigned long stamp;
+} RadixTable;
+
+// tables shared across calls, one per base, within a budget of cache_limit
+// bits in total; the least recently used tables are dropped first
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static RadixTable * cache[63];
+static size_t cache_bits = 0;
+static size_t cache_limit = BIGINT_RADIX_CACHE_BITS;
+static unsigned long cache_clock = 0;
+
+///
+/// Releases a table's powers and the table itself.
+///
+static void radix_table_free ( RadixTable * const t )
+{
+  while ( t->levels > 0 ) bigint_free ( t->powers[--t->levels] );
+  pthread_mutex_destroy ( &t->lock );
+  _bigint_free_owned ( t, sizeof*t );
+}
+
+///
+/// Drops least recently used tables until the cache fits its budget. Tables
+/// still in use are freed by their last radix_release(). Call with cache_lock
+/// held.
+///
+static void cache_trim ( void )
+{
+  while ( cache_bits > cache_limit || cache_limit == 0 )
+  {
+    RadixTable * lru = NULL;
+    int base;
+
+    for ( base = 2; base <= 62; ++ base )
+    {
+      if ( cache[base] && ( !lru || cache[base]->stamp < lru->stamp ) ) lru = cache[base];
+    }
+
+    if ( !lru ) break;
+
+    cache[lru->base] = NULL;
+    cache_bits -= lru->accounted;
+    lru->cached = false;
+
+    if ( lru->users == 0 ) radix_table_free ( lru );
+  }
+}
+
+///
+/// Takes a reference to the power table of a base, creating it if it is not
+/// cached.
+///
+/// @param base The base, 2 to 62
+///
+/// @return The table. Must be returned with radix_release().
+///
+static RadixTable * radix_acquire ( int const base )
+{
+  RadixTable * t, * fresh = NULL;
+
+  // allocate outside cache_lock, which must not be held if memory runs out
+  for ( ;; )
+  {
+    pthread_mutex_lock ( &cache_lock );
+    t = cache[base];
+    if ( t || fresh ) break;
+    pthread_mutex_unlock ( &cache_lock );
+
+    fresh = _bigint_alloc_owned ( sizeof*fresh );
+  }
+
+  if ( !t )
+  {
+    t = fresh;
+    fresh = NULL;
+
+    t->base = base;
+    t->digits = 1;
+    t->chunk = base;
+    while ( (uint64_t)t->chunk * base < ( (uint64_t)1 << 32 ) )
+    {
+      t->chunk *= base;
+      t->digits ++;
+    }
+
+    pthread_mutex_init ( &t->lock, NULL );
+    t->levels = 0;
+    t->bits = 0;
+    t->users = 0;
+    t->accounted = 0;
+    t->cached = cache_limit > 0;
+    if ( t->cached ) cache[base] = t;
+  }
+
+  t->users ++;
+  t->stamp = ++ cache_clock;
+
+  pthread_mutex_unlock ( &cache_lock );
+
+  // another thread cached the base meanwhile
+  if ( fresh ) _bigint_free_owned ( fresh, sizeof*fresh );
+
+  return t;
+}
+
+///
+/// Returns a reference taken by radix_acquire().
+///
+static void radix_release ( RadixTable * const t )
+{
+  pthread_mutex_lock ( &cache_lock );
+  if ( -- t->users == 0 && !t->cached ) radix_table_free ( t );
+  pthread_mutex_unlock ( &cache_lock );
+}
+
+///
+/// Charges a table's growth to the cache budget.
+///
+static void radix_account ( RadixTable * const t, size_t const bits )
+{
+  pthread_mutex_lock ( &cache_lock );
+  if ( t->cached && bits > t->accounted )
+  {
+    cache_bits += bits - t->accounted;
+    t->accounted = bits;
+    cache_trim ( );
+  }
+  pthread_mutex_unlock ( &cache_lock );
+}
+
+///
+/// Squares up a table to at least the given number of levels. Call with
+/// t->lock held; it is released if memory runs out.
+///
+static void radix_extend ( RadixTable * const t, int const levels )
+{
+  MemoryFrame frame;
+
+  MEMORY_CATCH ( frame )
+  {
+    pthread_mutex_unlock ( &t->lock );
+    _bigint_memory_rethrow ( );
+  }
+
+  while ( t->levels < levels )
+  {
+    t->powers[t->levels] = t->levels == 0
+                         ? _bigint_init_uint64 ( t->chunk )
+                         : bigint_multiply ( t->powers[t->levels-1], t->powers[t->levels-1] );
+    // the table owns its powers, whatever becomes of the call adding them
+    _bigint_memory_keep ( t->powers[t->levels] );
+    t->bits += t->powers[t->levels]->count;
+    t->levels ++;
+  }
+
+  _bigint_memory_pop ( &frame );
+}
+
+///
+/// Returns chunk^(2^k) from a table, computing it if necessary.
+///
+static BigInt const * radix_power ( RadixTable * const t, int const k )
+{
+  BigInt const * power;
+  size_t bits;
+
+  pthread_mutex_lock ( &t->lock );
+  radix_extend ( t, k + 1 );
+  power = t->powers[k];
+  bits = t->bits;
+  pthread_mutex_unlock ( &t->lock );
+
+  radix_account ( t, bits );
+
+  return power;
+}
+
+///
+/// Ensures a table covers a number.
+///
+/// @return The number of levels needed for powers[levels-1] to exceed the
+/// magnitude of x; those entries may then be read without locking.
+///
+static int radix_levels_for ( RadixTable * const t, BigInt const * const x )
+{
+  int levels = 1;
+  size_t bits;
+
+  pthread_mutex_lock ( &t->lock );
+  for ( ;; )
+  {
+    radix_extend ( t, levels );
+    if ( bigint_compare_magnitude ( t->powers[levels-1], x ) > 0 ) break;
+    levels ++;
+  }
+  bits = t->bits;
+  pthread_mutex_unlock ( &t->lock );
+
+  radix_account ( t, bits );
+
+  return levels;
+}
+
+///
+/// Sets the budget for power tables kept between conversions. Tables beyond
+/// the budget are dropped, least recently used first; a limit of 0 disables
+/// caching and frees every cached table that is not in use.
+///
+/// @param bits The budget, in total bits held by the cached powers
+///
+/// @return The previous budget
+///
+size_t bigint_set_radix_cache_limit ( size_t const bits )
+{
+  size_t previous;
+
+  pthread_mutex_lock ( &cache_lock );
+  previous = cache_limit;
+  cache_limit = bits;
+  cache_trim ( );
+  pthread_mutex_unlock ( &cache_lock );
+
+  return previous;
+}
+
+///
+/// Raise a small number to a power. Bases from 3 to 62 that are not powers
+/// of two take chunk^(2^j) from the power tables conversions share (see
+/// bigint_set_radix_cache_limit()), one per set bit of k / digits, so a power
+/// already squared up for a conversion, or for an earlier call, is not
+/// computed again. Other bases go to bigint_pow().
+///
+/// @param b The base
+/// @param k The exponent
+///
+/// @return A new BigInt containing b^k. Must be freed with bigint_free().
+///
+BigInt * bigint_pow_ui ( unsigned long const b, unsigned long const k )
+{
+  MEMORY_GUARD ( NULL );
+
+  RadixTable * table;
+  BigInt * power;
+  MemoryFrame frame;
+  unsigned long q, i;
+  uint32_t tail = 1;
+  int level;
+
+  if ( b < 3 || b > 62 || ( b & ( b - 1 ) ) == 0 )
+  {
+    BigInt * base = _bigint_init_uint64 ( b );
+    power = bigint_pow ( base, k );
+    bigint_free ( base );
+    return power;
+  }
+
+  STATS_BEGIN ( 0 );
+  table = radix_acquire ( (int)b );
+
+  MEMORY_CATCH ( frame )
+  {
+    radix_release ( table );
+    _bigint_memory_rethrow ( );
+  }
+
+  // b^k = chunk^q * b^(k - q*digits), the last factor below the chunk
+  q = k / table->digits;
+  for ( i = q*table->digits; i < k; ++ i ) tail *= b;
+
+  power = _bigint_init_uint64 ( tail );
+  for ( level = 0; q >> level; ++ level )
+  {
+    if ( q >> level & 1 )
+    {
+      BigInt * tmp = bigint_multiply ( power, radix_power ( table, level ) );
+      bigint_swap ( tmp, power );
+      bigint_free ( tmp );
+    }
+  }
+
+  _bigint_memory_pop ( &frame );
+  radix_release ( table );
+
+  STATS_BITS ( power->count );
+  STATS_END ( BIGINT_OP_POW );
+  return power;
+}
+
+///
+/// Buffers digits on their way to a BigIntWriteFn.
+///
+typedef struct _tag_digit_sink
+{
+  BigIntWriteFn write;
+  void * ctx;
+  int status;
+  RadixTable const * table;
+  char const * alphabet;
+  size_t used;
+  char buf[SINK_SIZE];
+} DigitSink;
+
+///
+/// Hands the buffered digits to the writer.
+///
+static void sink_flush ( DigitSink * const sink )
+{
+  if ( sink->used > 0 && sink->status == 0 )
+  {
+    sink->status = sink->write ( sink->ctx, sink->buf, sink->used );
+  }
+  sink->used = 0;
+}
+
+///
+/// Appends one character to the sink.
+///
+static void sink_put ( DigitSink * const sink, char const c )
+{
+  if ( sink->used == SINK_SIZE ) sink_flush ( sink );
+  sink->buf[sink->used++] = c;
+}
+
+///
+/// Writes a value below one chunk, optionally zero-padded to a full chunk of
+/// digits.
+///
+static void emit_chunk ( DigitSink * const sink, uint32_t v, bool const pad )
+{
+  char digits[32];
+  int i = 0, base = sink->table->base;
+
+  do
+  {
+    digits[i++] = sink->alphabet[v % base];
+    v /= base;
+  }
+  while ( v > 0 );
+
+  while ( pad && i < sink->table->digits ) digits[i++] = '0';
+
+  while ( i > 0 ) sink_put ( sink, digits[--i] );
+}
+
+///
+/// Writes the digits of a non-negative number x < powers[k+1], most
+/// significant first, by splitting it at powers[k] and recursing on both
+/// halves. Only one quotient/remainder pair per level is alive at a time.
+///
+/// @param sink Where the digits go
+/// @param x The number to write
+/// @param k The level to split at; -1 once x is a single chunk
+/// @param pad Whether to zero-pad to exactly digits*2^(k+1) digits
+///
+static void emit_digits ( DigitSink * const sink, BigInt const * const x, int const k, bool const pad )
+{
+  BigInt * q, * r;
+
+  if ( sink->status ) return;
+
+  if ( k < 0 )
+  {
+    uint64_t v;
+    _bigint_to_uint64 ( x, &v );
+    emit_chunk ( sink, (uint32_t)v, pad );
+    return;
+  }
+
+  if ( x->count == 0 )
+  {
+    size_t i;
+    for ( i = 0; pad && i < ( (size_t)sink->table->digits << (k+1) ); ++ i ) sink_put ( sink, '0' );
+    return;
+  }
+
+  q = bigint_divide ( x, sink->table->powers[k], &r );
+
+  if ( pad || q->count > 0 )
+  {
+    emit_digits ( sink, q, k - 1, pad );
+  }
+  emit_digits ( sink, r, k - 1, pad || q->count > 0 );
+
+  bigint_free ( r );
+  bigint_free ( q );
+}
+
+///
+/// Writes the digits of a non-negative number in a power-of-two base straight
+/// from its bits, most significant first.
+///
+static void emit_pow2_digits ( DigitSink * const sink, BigInt const * const x, int const base )
+{
+  int bits = 0, width, significant = _bigint_significant_bits ( x );
+  Bit const * bit = x->msb;
+
+  while ( ( 1 << bits ) < base ) bits ++;
+
+  for ( ; bit && !bit->bit; bit = walk_toward_lsb ( bit, 1 ) );
+
+  // the top digit holds whatever is left over above the whole digits
+  width = significant % bits ? significant % bits : bits;
+
+  while ( bit )
+  {
+    int v = 0;
+
+    for ( ; width > 0; -- width, bit = walk_toward_lsb ( bit, 1 ) )
+    {
+      v = ( v << 1 ) | bit->bit;
+    }
+
+    sink_put ( sink, sink->alphabet[v] );
+    width = bits;
+  }
+}
+
+///
+/// Writes the digits of a non-negative number in a base that is not a power
+/// of two, holding a reference to its power table meanwhile.
+///
+static void emit_radix_digits ( DigitSink * const sink, BigInt const * const x, int const base )
+{
+  RadixTable * const table = radix_acquire ( base );
+  MemoryFrame frame;
+
+  MEMORY_CATCH ( frame )
+  {
+    radix_release ( table );
+    _bigint_memory_rethrow ( );
+  }
+
+  sink->table = table;
+  emit_digits ( sink, x, radix_levels_for ( table, x ) - 2, false );
+
+  _bigint_memory_pop ( &frame );
+  radix_release ( table );
+}
+
+///
+/// Streams a BigInt's representation in any base from 2 to 62 to a writer,
+/// most significant digit first, in pieces of at most a few kilobytes. Bases
+/// up to 36 use the digits 0-9 then a-z; larger bases use 0-9, A-Z, then a-z.
+///
+/// Power-of-two bases are read straight off the bits. Other bases divide by
+/// chunk^(2^k) recursively, where the chunk is the largest power of the base
+/// below 2^32; the powers are kept between calls (see
+/// bigint_set_radix_cache_limit()). Besides the number's own size only a
+/// small output buffer is needed; the full string is never held in memory.
+///
+/// @param bi The BigInt to write
+/// @param base The base, 2 to 62
+/// @param write The function receiving each piece of output
+/// @param ctx Passed through to the writer
+///
+/// @return 0 on success, -1 for an unsupported base or when out of memory
+/// (see bigint_set_oom_mode()), otherwise the first nonzero value returned
+/// by the writer (after which no more output is produced)
+///
+int bigint_write_radix ( BigInt const * const bi, int const base, BigIntWriteFn const write, void * const ctx )
+{
+  MEMORY_GUARD ( -1 );
+
+  DigitSink * sink;
+  int status;
+  uint64_t v;
+
+  if ( base < 2 || base > 62 ) return -1;
+
+  STATS_BEGIN ( bi->count );
+  PROBE_BEGIN ( tostring );
+  sink = _bigint_alloc ( sizeof*sink );
+
+  sink->write = write;
+  sink->ctx = ctx;
+  sink->status = 0;
+  sink->used = 0;
+  sink->alphabet = base <= 36 ? radix_digits : wide_digits;
+
+  if ( _bigint_to_uint64 ( bi, &v ) && v == 0 )
+  {
+    sink_put ( sink, '0' );
+  }
+  else
+  {
+    if ( !bi->positive ) sink_put ( sink, '-' );
+
+    if ( ( base & ( base - 1 ) ) == 0 )
+    {
+      emit_pow2_digits ( sink, bi, base );
+    }
+    else
+    {
+      emit_radix_digits ( sink, bi, base );
+    }
+  }
+
+  sink_flush ( sink );
+  status = sink->status;
+  _bigint_free ( sink, sizeof*sink );
+
+  PROBE_END ( tostring, bi->count, base, ( base & ( base - 1 ) ) == 0 ? "pow2" : "subquadratic" );
+  STATS_END ( BIGINT_OP_TOSTRING );
+  return status;
+}
+
+///
+/// Streams a BigInt's decimal representation to a writer. See
+/// bigint_write_radix().
+///
+/// @param bi The BigInt to write
+/// @param write The function receiving each piece of output
+/// @param ctx Passed through to the writer
+///
+/// @return 0 on success, otherwise the first nonzero value returned by the
+/// writer (after which no more output is produced)
+///
+int bigint_write_base10 ( BigInt const * const bi, BigIntWriteFn const write, void * const ctx )
+{
+  return bigint_write_radix ( bi, 10, write, ctx );
+}
+
+///
+/// BigIntWriteFn writing to a stdio stream.
+///
+static int write_to_file ( void * ctx, char const * buf, size_t len )
+{
+  return fwrite ( buf, 1, len, ctx ) == len ? 0 : EOF;
+}
+
+///
+/// Streams a BigInt's decimal representation to a stdio stream. See
+/// bigint_write_base10().
+///
+/// @param bi The BigInt to write
+/// @param f The stream to write to
+///
+/// @return 0 on success, EOF on a write error
+///
+int bigint_write_base10_file ( BigInt const * const bi, FILE * const f )
+{
+  return bigint_write_base10 ( bi, write_to_file, f );
+}
+
+///
+/// BigIntWriteFn writing to a file descriptor, retrying short writes.
+///
+static int write_to_fd ( void * ctx, char const * buf, size_t len )
+{
+  int fd = *(int *)ctx;
+
+  while ( len > 0 )
+  {
+    ssize_t n = write ( fd, buf, len );
+
+    if ( n < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      return -1;
+    }
+
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+///
+/// Streams a BigInt's decimal representation to a file descriptor such as a
+/// pipe or socket. See bigint_write_base10().
+///
+/// @param bi The BigInt to write
+/// @param fd The descriptor to write to
+///
+/// @return 0 on success, -1 on a write error (see errno)
+///
+int bigint_write_base10_fd ( BigInt const * const bi, int fd )
+{
+  return bigint_write_base10 ( bi, write_to_fd, &fd );
+}
+
+///
+/// Destination of bigint_tostring_radix()'s writer.
+///
+typedef struct _tag_string_sink
+{
+  char * out;
+  size_t len;
+} StringSink;
+
+///
+/// BigIntWriteFn appending to a StringSink.
+///
+static int write_to_string ( void * ctx, char const * buf, size_t len )
+{
+  StringSink * sink = ctx;
+  memcpy ( sink->out + sink->len, buf, len );
+  sink->len += len;
+  return 0;
+}
+
+///
+/// Returns a C-string containing the BigInt in any base from 2 to 62. See
+/// bigint_write_radix() for the digits used.
+///
+/// @param bi The BigInt to render
+/// @param base The base, 2 to 62
+///
+/// @return A new C-string, or NULL for an unsupported base. Must be released
+/// with bigint_free_string().
+///
+char * bigint_tostring_radix ( BigInt const * const bi, int const base )
+{
+  MEMORY_GUARD ( NULL );
+
+  StringSink sink;
+  size_t size;
+
+  if ( base < 2 || base > 62 ) return NULL;
+
+  // the digits, a sign and the terminator; at most one byte to give back
+  size = bigint_sizeinbase ( bi, base ) + 2;
+
+  sink.out = _bigint_alloc ( size );
+  sink.len = 0;
+
+  bigint_write_radix ( bi, base, write_to_string, &sink );
+
+  if ( sink.len + 1 != size )
+  {
+    sink.out = _bigint_realloc ( sink.out, size, sink.len + 1 );
+  }
+  sink.out[sink.len] = '\0';
+
+  return sink.out;
+}
+
+///
+/// Counts the digits of a BigInt's magnitude in a base, without the sign.
+/// Power-of-two bases are counted exactly; other bases are estimated from the
+/// bit length alone and may come out one too many.
+///
+/// @param bi The BigInt to measure
+/// @param base The base, 2 to 62
+///
+/// @return The number of digits, 1 for zero, or 0 for an unsupported base
+///
+size_t bigint_sizeinbase ( BigInt const * const bi, int const base )
+{
+  uint64_t const bits = _bigint_significant_bits ( bi );
+  uint64_t f;
+  int k = 0;
+
+  if ( base < 2 || base > 62 ) return 0;
+  if ( bits == 0 ) return 1;
+
+  f = log2_fractions[base];
+
+  if ( f == 0 )
+  {
+    while ( ( 1 << k ) < base ) ++ k;
+    return ( bits + k - 1 ) / k;
+  }
+
+  // |bi| < 2^bits has at most floor(bits*log(2)/log(base))+1 digits, and at
+  // least the same bound for bits-1; the two differ by at most one
+  return ( ( bits * ( f >> 32 ) + ( ( bits * ( f & 0xffffffff ) ) >> 32 ) ) >> 32 ) + 1;
+}
+
+///
+/// Accesses the 32-bit limbs bigint_tostring_base10_into() keeps at the end
+/// of the caller's buffer, limb 0 last, so that dropping the top limb frees
+/// the lowest bytes.
+///
+static uint32_t limb_get ( char const * const end, size_t const i )
+{
+  uint32_t v;
+  memcpy ( &v, end - 4*(i+1), 4 );
+  return v;
+}
+
+static void limb_set ( char * const end, size_t const i, uint32_t const v )
+{
+  memcpy ( end - 4*(i+1), &v, 4 );
+}
+
+///
+/// Writes a BigInt's decimal representation into a caller-provided buffer
+/// without allocating. bigint_sizeinbase(bi, 10) + 2 bytes always suffice.
+///
+/// The magnitude is copied into the unused end of the buffer as 32-bit limbs
+/// and divided down by 10^9, the digits filling the buffer from the front
+/// faster than the limbs give it back. This takes time quadratic in the
+/// length, which is the right trade for the many small numbers it is meant
+/// for; bigint_write_base10() is subquadratic.
+///
+/// @param bi The BigInt to render
+/// @param buf The buffer to write to
+/// @param len The size of the buffer
+///
+/// @return The length of the string written, not counting the terminator,
+/// or 0 if the buffer is too small (in which case its contents are
+/// unspecified)
+///
+size_t bigint_tostring_base10_into ( BigInt const * const bi, char * const buf, size_t const len )
+{
+  char * const end = buf + len;
+  size_t const bits = _bigint_significant_bits ( bi );
+  size_t const sign = !bi->positive && bits > 0;
+  size_t limbs = ( bits + 31 ) / 32, digits = 0, i;
+  Bit const * bit;
+  uint64_t v = 0;
+
+  STATS_BEGIN ( bi->count );
+
+  if ( limbs > 2 )
+  {
+    if ( 4*limbs > len ) return 0;
+
+    for ( i = 0; i < limbs; ++ i ) limb_set ( end, i, 0 );
+    for ( i = 0, bit = bi->lsb; i < bits; ++ i, bit = walk_toward_msb ( bit, 1 ) )
+    {
+      limb_set ( end, i/32, limb_get ( end, i/32 ) | (uint32_t)bit->bit << (i%32) );
+    }
+
+    while ( limbs > 2 )
+    {
+      uint64_t r = 0;
+      int k;
+
+      for ( i = limbs; i-- > 0; )
+      {
+        r = ( r << 32 ) | limb_get ( end, i );
+        limb_set ( end, i, (uint32_t)( r / 1000000000 ) );
+        r %= 1000000000;
+      }
+      while ( limb_get ( end, limbs - 1 ) == 0 ) limbs --;
+
+      // the quotient has more digits than limb bytes, so this only fails
+      // when the whole string would not fit
+      if ( sign + digits + 9 > len - 4*limbs ) return 0;
+
+      for ( k = 0; k < 9; ++ k, r /= 10 ) buf[sign + digits++] = '0' + r % 10;
+    }
+
+    v = (uint64_t)( limbs > 1 ? limb_get ( end, 1 ) : 0 ) << 32 | limb_get ( end, 0 );
+  }
+  else
+  {
+    _bigint_to_uint64 ( bi, &v );
+  }
+
+  do
+  {
+    if ( sign + digits + 1 >= len ) return 0;
+    buf[sign + digits++] = '0' + v % 10;
+    v /= 10;
+  }
+  while ( v > 0 );
+
+  for ( i = 0; i < digits / 2; ++ i )
+  {
+    char t = buf[sign + i];
+    buf[sign + i] = buf[sign + digits - 1 - i];
+    buf[sign + digits - 1 - i] = t;
+  }
+  if ( sign ) buf[0] = '-';
+  buf[sign + digits] = '\0';
+
+  STATS_END ( BIGINT_OP_TOSTRING );
+  return sign + digits;
+}
+
+///
+/// Creates a BigInt from a C-string in any base from 2 to 62, with an
+/// optional sign. See bigint_write_radix() for the digits accepted; the input
+/// is joined by the same cached power tables used for output.
+///
+/// @param str The digits
+/// @param base The base, 2 to 62
+///
+/// @return A new BigInt, or NULL if the string is malformed or the base is
+/// unsupported. Must be freed with bigint_free().
+///
+BigInt * bigint_init_from_radix ( char const * const str, int const base )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigIntParser * p;
+  BigInt * out;
+  MemoryFrame frame;
+
+  if ( base < 2 ) return NULL;
+
+  p = bigint_parser_new ( base );
+  if ( !p ) return NULL;
+
+  // the parser's stack is not recorded by the guard
+  MEMORY_CATCH ( frame )
+  {
+    bigint_parser_free ( p );
+    _bigint_memory_rethrow ( );
+  }
+
+  STATS_BEGIN ( 0 );
+  PROBE_BEGIN ( fromstring );
+  bigint_parser_feed ( p, str, strlen ( str ) );
+  out = bigint_parser_finish ( p );
+
+  _bigint_memory_pop ( &frame );
+
+  PROBE_END ( fromstring, out ? out->count : 0, base, ( base & ( base - 1 ) ) == 0 ? "pow2" : "subquadratic" );
+  STATS_BITS ( out ? out->count : 0 );
+  STATS_END ( BIGINT_OP_FROMSTRING );
+  return out;
+}
+
+// parser states
+#define PARSE_START 0
+#define PARSE_SIGNED 1
+#define PARSE_ZERO 2
+// a 0x or 0b prefix, with no digit after it yet
+#define PARSE_PREFIX 3
+#define PARSE_DIGITS 4
+// from PARSE_ERROR on, input is ignored
+#define PARSE_ERROR 5
+#define PARSE_NOMEM 6
+
+// the binary-counter stack of chunk blocks never exceeds one entry per bit
+// of the block count
+#define PARSE_DEPTH 64
+
+struct _tag_bigint_parser
+{
+  int base;
+  int state;
+  bool positive;
+
+  // power-of-two bases: digits are shifted straight into value
+  BigInt * value;
+
+  // other bases: digits are gathered into a native chunk of table->digits
+  // digits, and complete chunks are merged pairwise on a stack so that
+  // equal-sized blocks are always combined, i.e. stack[i] holds 2^level[i]
+  // chunks
+  RadixTable * table;
+  uint32_t chunk;
+  int chunk_digits;
+  BigInt * stack[PARSE_DEPTH];
+  int level[PARSE_DEPTH];
+  int depth;
+};
+
+///
+/// Fixes the base of a parser, taking the shared power table it joins chunks
+/// with unless the base is a power of two.
+///
+static void parser_set_base ( BigIntParser * const p, int const base )
+{
+  p->base = base;
+  if ( base & ( base - 1 ) ) p->table = radix_acquire ( base );
+}
+
+///
+/// Creates an incremental parser for an integer arriving in pieces.
+///
+/// @param base 2 to 62 (see bigint_write_radix() for the digits); or 0 to
+/// choose from a "0x" (hex) or "0b" (binary) prefix after the optional sign,
+/// defaulting to decimal
+///
+/// @return A new parser, or NULL for an unsupported base. Must be released
+/// with bigint_parser_finish() or bigint_parser_free().
+///
+BigIntParser * bigint_parser_new ( int const base )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigIntParser * p;
+
+  if ( base < 0 || base == 1 || base > 62 ) return NULL;
+
+  p = _bigint_alloc ( sizeof*p );
+
+  p->base = 0;
+  p->table = NULL;
+  p->state = PARSE_START;
+  p->positive = true;
+  p->value = bigint_init_empty ( );
+  p->chunk = 0;
+  p->chunk_digits = 0;
+  p->depth = 0;
+
+  if ( base ) parser_set_base ( p, base );
+
+  // from here on the parser frees what it holds
+  _bigint_memory_keep ( p->value );
+  _bigint_memory_keep ( p );
+
+  return p;
+}
+
+///
+/// Pushes a complete chunk and merges equal-sized blocks.
+///
+static void parser_push_chunk ( BigIntParser * const p )
+{
+  p->stack[p->depth] = _bigint_init_uint64 ( p->chunk );
+  _bigint_memory_keep ( p->stack[p->depth] );
+  p->level[p->depth++] = 0;
+  p->chunk = 0;
+  p->chunk_digits = 0;
+
+  while ( p->depth >= 2 && p->level[p->depth-1] == p->level[p->depth-2] )
+  {
+    BigInt * high = p->stack[p->depth-2], * low = p->stack[p->depth-1];
+    BigInt * merged = bigint_multiply ( high, radix_power ( p->table, p->level[p->depth-1] ) );
+
+    _real_bigint_add_in_place ( merged, low );
+    _bigint_memory_keep ( merged );
+    bigint_free ( low );
+    bigint_free ( high );
+
+    p->depth --;
+    p->stack[p->depth-1] = merged;
+    p->level[p->depth-1] ++;
+  }
+}
+
+///
+/// Converts a character to its digit value.
+///
+/// @return The value, or -1 if the character is not a digit in the base
+///
+static int digit_value ( char const c, int const base )
+{
+  int v = -1;
+
+  if ( c >= '0' && c <= '9' ) v = c - '0';
+  else if ( c >= 'A' && c <= 'Z' ) v = c - 'A' + 10;
+  else if ( c >= 'a' && c <= 'z' ) v = c - 'a' + ( base <= 36 ? 10 : 36 );
+
+  return v < base ? v : -1;
+}
+
+///
+/// Consumes one digit.
+///
+static void parser_digit ( BigIntParser * const p, int const v )
+{
+  if ( p->table )
+  {
+    p->chunk = p->chunk * p->base + v;
+    if ( ++ p->chunk_digits == p->table->digits ) parser_push_chunk ( p );
+  }
+  else
+  {
+    int bit;
+
+    // prepending a bit at the LSB computes value*2 + bit
+    for ( bit = p->base >> 1; bit > 0; bit >>= 1 )
+    {
+      prepend_bit ( p->value, ( v & bit ) != 0 );
+    }
+  }
+}
+
+///
+/// Feeds the next piece of text to a parser. Pieces may split the number
+/// anywhere, including inside the sign or base prefix.
+///
+/// @param p The parser
+/// @param buf The text, which need not be NUL-terminated
+/// @param len The number of characters in buf
+///
+/// @return 0 if the text so far is valid; -1 once an invalid character has
+/// been seen or memory has run out, after which further input is ignored
+///
+int bigint_parser_feed ( BigIntParser * const p, char const * const buf, size_t const len )
+{
+  MEMORY_GUARD_CATCH ( )
+  {
+    p->state = PARSE_NOMEM;
+    return -1;
+  }
+
+  size_t i;
+
+  for ( i = 0; i < len && p->state < PARSE_ERROR; ++ i )
+  {
+    char c = buf[i];
+    int v;
+
+    if ( p->state == PARSE_START && ( c == '-' || c == '+' ) )
+    {
+      p->positive = ( c == '+' );
+      p->state = PARSE_SIGNED;
+      continue;
+    }
+
+    if ( p->state == PARSE_ZERO )
+    {
+      p->state = PARSE_DIGITS;
+
+      if ( c == 'x' || c == 'X' )
+      {
+        parser_set_base ( p, 16 );
+        p->state = PARSE_PREFIX;
+        continue;
+      }
+      if ( c == 'b' || c == 'B' )
+      {
+        parser_set_base ( p, 2 );
+        p->state = PARSE_PREFIX;
+        continue;
+      }
+
+      parser_set_base ( p, 10 );
+    }
+    else if ( p->base == 0 && c == '0' )
+    {
+      p->state = PARSE_ZERO;
+      continue;
+    }
+    else if ( p->base == 0 )
+    {
+      parser_set_base ( p, 10 );
+    }
+
+    v = digit_value ( c, p->base );
+
+    if ( v < 0 )
+    {
+      p->state = PARSE_ERROR;
+    }
+    else
+    {
+      p->state = PARSE_DIGITS;
+      parser_digit ( p, v );
+    }
+  }
+
+  return p->state >= PARSE_ERROR ? -1 : 0;
+}
+
+///
+/// Releases a parser without producing a value.
+///
+/// @param p The parser
+///
+void bigint_parser_free ( BigIntParser * const p )
+{
+  if ( !p ) return;
+
+  while ( p->depth > 0 ) bigint_free ( p->stack[--p->depth] );
+  if ( p->table ) radix_release ( p->table );
+  bigint_free ( p->value );
+  _bigint_free ( p, sizeof*p );
+}
+
+///
+/// Completes parsing and releases the parser.
+///
+/// @param p The parser
+///
+/// @return A new BigInt with the parsed value, or NULL if the input contained
+/// an invalid character or no digits, or memory ran out (see
+/// bigint_out_of_memory()). Must be freed with bigint_free().
+///
+BigInt * bigint_parser_finish ( BigIntParser * const p )
+{
+  MEMORY_GUARD_CATCH ( )
+  {
+    bigint_parser_free ( p );
+    return NULL;
+  }
+
+  BigInt * out = NULL;
+
+  if ( p->state == PARSE_NOMEM )
+  {
+    bigint_parser_free ( p );
+    _bigint_memory_exhausted ( );
+    return NULL;
+  }
+
+  if ( p->state == PARSE_ZERO )
+  {
+    out = bigint_init ( 0 );
+  }
+  else if ( p->state == PARSE_DIGITS && p->table )
+  {
+    // fold the stack from the least significant block upwards:
+    // out = stack[i] * base^digits + out
+    uint32_t scale = 1;
+    BigInt * place;
+    int i;
+
+    for ( i = 0; i < p->chunk_digits; ++ i ) scale *= p->base;
+
+    out = _bigint_init_uint64 ( p->chunk );
+    place = _bigint_init_uint64 ( scale );
+
+    for ( i = p->depth - 1; i >= 0; -- i )
+    {
+      BigInt * tmp = bigint_multiply ( p->stack[i], place );
+      _real_bigint_add_in_place ( tmp, out );
+      bigint_swap ( tmp, out );
+      bigint_free ( tmp );
+
+      if ( i > 0 )
+      {
+        tmp = bigint_multiply ( place, radix_power ( p->table, p->level[i] ) );
+        bigint_swap ( tmp, place );
+        bigint_free ( tmp );
+      }
+    }
+
+    bigint_free ( place );
+  }
+  else if ( p->state == PARSE_DIGITS )
+  {
+    out = p->value;
+    p->value = NULL;
+  }
+
+  if ( out )
+  {
+    _bigint_remove_high_zeroes ( out );
+    out->positive = p->positive || out->count == 0;
+  }
+
+  bigint_parser_free ( p );
+
+  return out;
+}
+
+///
+/// Renders a BigInt in radix 2^bits by slicing its bit list into groups of
+/// bits, least significant group first, and writing each group's digit from
+/// the right-hand end of the output. Runs in time linear in the bit count.
+///
+/// @param bi The BigInt to render
+/// @param bits The number of bits per digit
+/// @param alphabet The 2^bits digit characters
+///
+/// @return A new C-string. Must be released with bigint_free_string().
+///
+static char * tostring_pow2 ( BigInt const * const bi, int const bits, char const * const alphabet )
+{
+  MEMORY_GUARD ( NULL );
+
+  int significant = _bigint_significant_bits ( bi ), i;
+  size_t digits = significant ? ( significant + bits - 1 ) / bits : 1;
+  bool negative = !bi->positive && significant;
+  char * out = _bigint_alloc ( digits + negative + 1 );
+  char * end = out + digits + negative;
+  Bit const * bit = bi->lsb;
+
+  *end = '\0';
+  if ( negative ) out[0] = '-';
+
+  while ( end > out + negative )
+  {
+    int v = 0;
+
+    for ( i = 0; i < bits && bit; ++ i, bit = walk_toward_msb ( bit, 1 ) )
+    {
+      v |= bit->bit << i;
+    }
+
+    *--end = alphabet[v];
+  }
+
+  return out;
+}
+
+///
+/// Parses a number written in radix 2^bits, shifting each digit's bits in at
+/// the LSB. Runs in time linear in the string length.
+///
+/// @param str The digits, optionally preceded by a sign
+/// @param bits The number of bits per digit
+/// @param alphabet The 2^bits digit characters
+/// @param fold_case Whether letters match the alphabet case-insensitively
+/// @param sign Whether a sign is accepted; callers that strip one (and a
+/// prefix after it) pass false, so that no second sign gets through
+///
+/// @return A new BigInt, or NULL if there are no digits or a character is not
+/// in the alphabet. Must be freed with bigint_free().
+///
+static BigInt * init_pow2 ( char const * str, int const bits, char const * const alphabet, bool const fold_case, bool const sign )
+{
+  MEMORY_GUARD ( NULL );
+
+  signed char value[256];
+  bool positive = true;
+  char const * end;
+  size_t length;
+  BigInt * bi;
+  int i;
+
+  memset ( value, -1, sizeof value );
+  for ( i = 0; i < ( 1 << bits ); ++ i )
+  {
+    unsigned char c = alphabet[i];
+    value[c] = i;
+    if ( fold_case && c >= 'a' && c <= 'z' ) value[c - 'a' + 'A'] = i;
+    if ( fold_case && c >= 'A' && c <= 'Z' ) value[c - 'A' + 'a'] = i;
+  }
+
+  if ( sign && ( *str == '-' || *str == '+' ) ) positive = ( *str++ == '+' );
+
+  // every digit is checked before anything is allocated, so bad input costs
+  // a scan; a length past what a count can hold grows node by node instead
+  for ( end = str; *end; ++ end )
+  {
+    if ( value[(unsigned char)*end] < 0 ) return NULL;
+  }
+  if ( end == str ) return NULL;
+
+  length = end - str;
+  bi = bigint_init_reserve ( length <= INT_MAX / bits ? (int)length * bits : 0 );
+
+  for ( ; *str; ++ str )
+  {
+    int v = value[(unsigned char)*str];
+
+    for ( i = bits - 1; i >= 0; -- i )
+    {
+      prepend_bit ( bi, ( v >> i ) & 1 );
+    }
+  }
+
+  _bigint_remove_high_zeroes ( bi );
+  bi->positive = positive || bi->count == 0;
+
+  return bi;
+}
+
+///
+/// Returns a C-string containing the BigInt in radix 2^bits, using the digits
+/// 0-9 then a-v.
+///
+/// @param bi The BigInt to render
+/// @param bits The number of bits per digit, 1 to 5
+///
+/// @return A new C-string, or NULL if bits is out of range. Must be released
+/// with bigint_free_string().
+///
+char * bigint_tostring_pow2 ( BigInt const * const bi, int const bits )
+{
+  if ( bits < 1 || bits > 5 ) return NULL;
+  return tostring_pow2 ( bi, bits, radix_digits );
+}
+
+///
+/// Creates a BigInt from a C-string in radix 2^bits, digits 0-9 then a-v in
+/// either case. See bigint_tostring_pow2().
+///
+/// @param str The digits, optionally preceded by a sign
+/// @param bits The number of bits per digit, 1 to 5
+///
+/// @return A new BigInt, or NULL if the string is malformed or bits is out of
+/// range. Must be freed with bigint_free().
+///
+BigInt * bigint_init_from_pow2 ( char const * const str, int const bits )
+{
+  if ( bits < 1 || bits > 5 ) return NULL;
+  return init_pow2 ( str, bits, radix_digits, true, true );
+}
+
+///
+/// Returns a C-string containing the BigInt in lowercase hexadecimal.
+///
+/// @param bi The BigInt to render
+///
+/// @return A new C-string. Must be released with bigint_free_string().
+///
+char * bigint_tostring_base16 ( BigInt const * const bi )
+{
+  return tostring_pow2 ( bi, 4, radix_digits );
+}
+
+///
+/// Creates a BigInt from a hexadecimal C-string in either case, with an
+/// optional sign and "0x" prefix.
+///
+/// @param str The hexadecimal string
+///
+/// @return A new BigInt, or NULL if the string is malformed. Must be freed
+/// with bigint_free().
+///
+BigInt * bigint_init_from_hex ( char const * const str )
+{
+  char const * digits = str;
+  BigInt * bi;
+
+  if ( *digits == '-' || *digits == '+' ) digits ++;
+  if ( digits[0] == '0' && ( digits[1] == 'x' || digits[1] == 'X' ) ) digits += 2;
+
+  bi = init_pow2 ( digits, 4, radix_digits, true, false );
+  if ( bi && *str == '-' ) bi->positive = ( bi->count == 0 );
+
+  return bi;
+}
+
+///
+/// Returns a C-string containing the BigInt as a base 32 numeral using the RFC
+/// 4648 alphabet (A-Z, 2-7; A is zero). This is a positional numeral, not the
+/// byte-oriented RFC 4648 encoding, so there is no padding.
+///
+/// @param bi The BigInt to render
+///
+/// @return A new C-string. Must be released with bigint_free_string().
+///
+char * bigint_tostring_base32 ( BigInt const * const bi )
+{
+  return tostring_pow2 ( bi, 5, base32_digits );
+}
+
+///
+/// Creates a BigInt from a base 32 numeral. See bigint_tostring_base32().
+///
+/// @param str The numeral, optionally preceded by a sign
+///
+/// @return A new BigInt, or NULL if the string is malformed. Must be freed
+/// with bigint_free().
+///
+BigInt * bigint_init_from_base32 ( char const * const str )
+{
+  return init_pow2 ( str, 5, base32_digits, true, true );
+}
+
+///
+/// Returns a C-string containing the BigInt as a base 64 numeral using the RFC
+/// 4648 alphabet (A-Z, a-z, 0-9, +, /; A is zero). This is a positional
+/// numeral, not the byte-oriented RFC 4648 encoding, so there is no padding.
+///
+/// @param bi The BigInt to render
+///
+/// @return A new C-string. Must be released with bigint_free_string().
+///
+char * bigint_tostring_base64 ( BigInt const * const bi )
+{
+  return tostring_pow2 ( bi, 6, base64_digits );
+}
+
+///
+/// Creates a BigInt from a base 64 numeral. See bigint_tostring_base64().
+///
+/// @param str The numeral, optionally preceded by a sign
+///
+/// @return A new BigInt, or NULL if the string is malformed. Must be freed
+/// with bigint_free().
+///
+BigInt * bigint_init_from_base64 ( char const * const str )
+{
+  return init_pow2 ( str, 6, base64_digits, false, true );
+}
@@ -0,0 +1,472 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bignum.h"
+#include "cpu.h"
+
+#if ( defined(__x86_64__) || defined(__i386__) ) && defined(__GNUC__)
+#define BIGINT_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+  * Kernels with more than one implementation are called through a table
+  * (see cpu.h), filled in once on first use for the level the host supports
+  * (or the lower one named by the BIGNUM_CPU environment variable). Each
+  * entry takes the best implementation at or below the selected level, so a
+  * single build of the library runs on every host. The generic level runs
+  * the portable reference loops.
+  **/
+
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+static int cpu_level = BIGINT_CPU_GENERIC;
+static Kernels kernels;
+
+static char const * const level_names[] = { "generic", "sse4" };
+
+// r += a*b or r -= a*b over n limbs, returning the limb carried or borrowed
+// out of the top
+typedef uint32_t (*RowKernel) ( uint32_t *, uint32_t const *, size_t, uint32_t );
+
+///
+/// Advances a CRC-32 (IEEE 802.3) register one bit at a time.
+///
+/// @param crc The register, not yet inverted for output
+///
+static uint32_t crc32_generic ( uint32_t crc, unsigned char const * buf, size_t len )
+{
+  int k;
+
+  while ( len -- )
+  {
+    crc ^= *buf ++;
+    for ( k = 0; k < 8; ++ k )
+    {
+      crc = ( crc >> 1 ) ^ ( 0xedb88320u & ( 0u - ( crc & 1 ) ) );
+    }
+  }
+
+  return crc;
+}
+
+///
+/// Adds a*b to r over n 32-bit limbs, one limb product at a time.
+///
+/// @return The limb carried out of the top
+///
+static uint32_t addmul_1_generic ( uint32_t * const r, uint32_t const * const a, size_t const n, uint32_t const b )
+{
+  uint64_t carry = 0;
+  size_t j;
+
+  for ( j = 0; j < n; ++ j )
+  {
+    carry += (uint64_t)r[j] + (uint64_t)a[j]*b;
+    r[j] = (uint32_t)carry;
+    carry >>= 32;
+  }
+
+  return (uint32_t)carry;
+}
+
+///
+/// Subtracts a*b from r over n 32-bit limbs, one limb product at a time.
+///
+/// @return The limb borrowed out of the top
+///
+static uint32_t submul_1_generic ( uint32_t * const r, uint32_t const * const a, size_t const n, uint32_t const b )
+{
+  // the product's high limb plus the borrow from below, never over a limb
+  uint64_t borrow = 0;
+  size_t j;
+
+  for ( j = 0; j < n; ++ j )
+  {
+    uint64_t const t = (uint64_t)a[j]*b + borrow;
+    uint32_t const low = (uint32_t)t;
+
+    borrow = ( t >> 32 ) + ( r[j] < low );
+    r[j] -= low;
+  }
+
+  return (uint32_t)borrow;
+}
+
+///
+/// Multiplies a row at a time. This and the other product loops are written
+/// once over a row kernel r += a*b; each caller below passes a constant, so
+/// the compiler makes a copy per kernel that calls its rows directly.
+///
+static inline void mul_rows ( RowKernel const addmul_1, uint32_t * const r, uint32_t const * const a, size_t const na, uint32_t const * const b, size_t const nb )
+{
+  size_t i;
+
+  memset ( r, 0, (na+nb)*sizeof*r );
+  for ( i = 0; i < nb; ++ i )
+  {
+    r[i+na] = addmul_1 ( r + i, a, na, b[i] );
+  }
+}
+
+///
+/// Squares by forming each cross product once, doubling them, then adding
+/// the squares on the diagonal.
+///
+static inline void sqr_rows ( RowKernel const addmul_1, uint32_t * const r, uint32_t const * const a, size_t const n )
+{
+  uint64_t carry;
+  size_t i;
+
+  memset ( r, 0, 2*n*sizeof*r );
+  for ( i = 0; i < n; ++ i )
+  {
+    r[i+n] = addmul_1 ( r + 2*i + 1, a + i + 1, n - i - 1, a[i] );
+  }
+
+  carry = 0;
+  for ( i = 0; i < 2*n; ++ i )
+  {
+    carry |= (uint64_t)r[i] << 1;
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+
+  carry = 0;
+  for ( i = 0; i < n; ++ i )
+  {
+    uint64_t s = (uint64_t)a[i]*a[i];
+
+    carry += (uint64_t)r[2*i] + (uint32_t)s;
+    r[2*i] = (uint32_t)carry;
+    carry >>= 32;
+    carry += (uint64_t)r[2*i+1] + ( s >> 32 );
+    r[2*i+1] = (uint32_t)carry;
+    carry >>= 32;
+  }
+}
+
+///
+/// Clears t a limb at a time from the bottom by adding the multiple of m
+/// that zeroes it.
+///
+static inline void redc_rows ( RowKernel const addmul_1, uint32_t * const t, uint32_t const * const m, size_t const n, uint32_t const minv )
+{
+  size_t i, j;
+
+  t[2*n] = 0;
+  for ( i = 0; i < n; ++ i )
+  {
+    uint32_t carry = addmul_1 ( t + i, m, n, t[i]*minv );
+
+    for ( j = i + n; carry && j <= 2*n; ++ j )
+    {
+      t[j] += carry;
+      carry = t[j] < carry;
+    }
+  }
+}
+
+static void mul_generic ( uint32_t * const r, uint32_t const * const a, size_t const na, uint32_t const * const b, size_t const nb )
+{
+  mul_rows ( addmul_1_generic, r, a, na, b, nb );
+}
+
+static void sqr_generic ( uint32_t * const r, uint32_t const * const a, size_t const n )
+{
+  sqr_rows ( addmul_1_generic, r, a, n );
+}
+
+static void redc_generic ( uint32_t * const t, uint32_t const * const m, size_t const n, uint32_t const minv )
+{
+  redc_rows ( addmul_1_generic, t, m, n, minv );
+}
+
+#ifdef BIGINT_HAVE_X86
+
+///
+/// Advances a CRC-32 register by folding 64-byte blocks with carry-less
+/// multiplication ("Fast CRC Computation for Generic Polynomials Using
+/// PCLMULQDQ", Intel, 2009), then finishes the tail bit by bit.
+///
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul ( uint32_t crc, unsigned char const * buf, size_t len )
+{
+  // bit-reflected fold constants and Barrett reduction constants for the
+  // IEEE polynomial
+  static uint64_t const k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+  static uint64_t const k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+  static uint64_t const k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+  static uint64_t const poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  if ( len < 64 ) return crc32_generic ( crc, buf, len );
+
+  x1 = _mm_xor_si128 ( _mm_loadu_si128 ( (__m128i const *)buf ), _mm_cvtsi32_si128 ( (int)crc ) );
+  x2 = _mm_loadu_si128 ( (__m128i const *)( buf + 16 ) );
+  x3 = _mm_loadu_si128 ( (__m128i const *)( buf + 32 ) );
+  x4 = _mm_loadu_si128 ( (__m128i const *)( buf + 48 ) );
+  x0 = _mm_load_si128 ( (__m128i const *)k1k2 );
+  buf += 64;
+  len -= 64;
+
+  // four independent folds per 64 bytes
+  while ( len >= 64 )
+  {
+    x5 = _mm_clmulepi64_si128 ( x1, x0, 0x00 );
+    x6 = _mm_clmulepi64_si128 ( x2, x0, 0x00 );
+    x7 = _mm_clmulepi64_si128 ( x3, x0, 0x00 );
+    x8 = _mm_clmulepi64_si128 ( x4, x0, 0x00 );
+    x1 = _mm_clmulepi64_si128 ( x1, x0, 0x11 );
+    x2 = _mm_clmulepi64_si128 ( x2, x0, 0x11 );
+    x3 = _mm_clmulepi64_si128 ( x3, x0, 0x11 );
+    x4 = _mm_clmulepi64_si128 ( x4, x0, 0x11 );
+    x1 = _mm_xor_si128 ( _mm_xor_si128 ( x1, x5 ), _mm_loadu_si128 ( (__m128i const *)buf ) );
+    x2 = _mm_xor_si128 ( _mm_xor_si128 ( x2, x6 ), _mm_loadu_si128 ( (__m128i const *)( buf + 16 ) ) );
+    x3 = _mm_xor_si128 ( _mm_xor_si128 ( x3, x7 ), _mm_loadu_si128 ( (__m128i const *)( buf + 32 ) ) );
+    x4 = _mm_xor_si128 ( _mm_xor_si128 ( x4, x8 ), _mm_loadu_si128 ( (__m128i const *)( buf + 48 ) ) );
+    buf += 64;
+    len -= 64;
+  }
+
+  // fold the four lanes into one, then any remaining 16-byte blocks
+  x0 = _mm_load_si128 ( (__m128i const *)k3k4 );
+
+  x5 = _mm_clmulepi64_si128 ( x1, x0, 0x00 );
+  x1 = _mm_clmulepi64_si128 ( x1, x0, 0x11 );
+  x1 = _mm_xor_si128 ( _mm_xor_si128 ( x1, x2 ), x5 );
+  x5 = _mm_clmulepi64_si128 ( x1, x0, 0x00 );
+  x1 = _mm_clmulepi64_si128 ( x1, x0, 0x11 );
+  x1 = _mm_xor_si128 ( _mm_xor_si128 ( x1, x3 ), x5 );
+  x5 = _mm_clmulepi64_si128 ( x1, x0, 0x00 );
+  x1 = _mm_clmulepi64_si128 ( x1, x0, 0x11 );
+  x1 = _mm_xor_si128 ( _mm_xor_si128 ( x1, x4 ), x5 );
+
+  while ( len >= 16 )
+  {
+    x5 = _mm_clmulepi64_si128 ( x1, x0, 0x00 );
+    x1 = _mm_clmulepi64_si128 ( x1, x0, 0x11 );
+    x1 = _mm_xor_si128 ( _mm_xor_si128 ( x1, _mm_loadu_si128 ( (__m128i const *)buf ) ), x5 );
+    buf += 16;
+    len -= 16;
+  }
+
+  // 128 bits down to 64, then Barrett reduction to 32
+  x2 = _mm_clmulepi64_si128 ( x1, x0, 0x10 );
+  x3 = _mm_setr_epi32 ( ~0, 0, ~0, 0 );
+  x1 = _mm_xor_si128 ( _mm_srli_si128 ( x1, 8 ), x2 );
+
+  x0 = _mm_loadl_epi64 ( (__m128i const *)k5k0 );
+  x2 = _mm_srli_si128 ( x1, 4 );
+  x1 = _mm_and_si128 ( x1, x3 );
+  x1 = _mm_xor_si128 ( _mm_clmulepi64_si128 ( x1, x0, 0x00 ), x2 );
+
+  x0 = _mm_load_si128 ( (__m128i const *)poly );
+  x2 = _mm_and_si128 ( x1, x3 );
+  x2 = _mm_clmulepi64_si128 ( x2, x0, 0x10 );
+  x2 = _mm_and_si128 ( x2, x3 );
+  x2 = _mm_clmulepi64_si128 ( x2, x0, 0x00 );
+  x1 = _mm_xor_si128 ( x1, x2 );
+
+  return crc32_generic ( (uint32_t)_mm_extract_epi32 ( x1, 1 ), buf, len );
+}
+
+#ifdef __x86_64__
+
+///
+/// Adds a*b to r two limbs at a time: each pair is one little-endian 64-bit
+/// word, so a 64 by 32 bit product in 128 bits does the work of two limb
+/// products and the carry chain is half as long. The pairs are taken on
+/// word boundaries of r, with a lone limb at either end as needed: the rows
+/// of a product start a limb apart, and a row reloading exactly the words
+/// the one before it stored gets them straight from the store buffer.
+///
+/// @return The limb carried out of the top
+///
+static uint32_t addmul_1_wide ( uint32_t * r, uint32_t const * a, size_t n, uint32_t const b )
+{
+  unsigned __int128 carry = 0;
+  uint64_t x, y, c;
+
+  if ( n && ( (uintptr_t)r & 4 ) )
+  {
+    c = (uint64_t)*r + (uint64_t)*a ++ * b;
+    *r ++ = (uint32_t)c;
+    carry = c >> 32;
+    n --;
+  }
+
+  for ( ; n >= 2; n -= 2, a += 2, r += 2 )
+  {
+    memcpy ( &x, a, sizeof x );
+    memcpy ( &y, r, sizeof y );
+    carry += (unsigned __int128)x*b + y;
+    y = (uint64_t)carry;
+    memcpy ( r, &y, sizeof y );
+    carry >>= 64;
+  }
+
+  c = (uint64_t)carry;
+  if ( n )
+  {
+    c += (uint64_t)*r + (uint64_t)*a*b;
+    *r = (uint32_t)c;
+    c >>= 32;
+  }
+
+  return (uint32_t)c;
+}
+
+///
+/// Subtracts a*b from r two limbs at a time, as addmul_1_wide() adds.
+///
+/// @return The limb borrowed out of the top
+///
+static uint32_t submul_1_wide ( uint32_t * r, uint32_t const * a, size_t n, uint32_t const b )
+{
+  uint64_t borrow = 0, x, y, low;
+  unsigned __int128 t;
+
+  if ( n && ( (uintptr_t)r & 4 ) )
+  {
+    y = (uint64_t)*a ++ * b;
+    borrow = ( y >> 32 ) + ( *r < (uint32_t)y );
+    *r ++ -= (uint32_t)y;
+    n --;
+  }
+
+  for ( ; n >= 2; n -= 2, a += 2, r += 2 )
+  {
+    memcpy ( &x, a, sizeof x );
+    memcpy ( &y, r, sizeof y );
+    t = (unsigned __int128)x*b + borrow;
+    low = (uint64_t)t;
+    borrow = (uint64_t)( t >> 64 ) + ( y < low );
+    y -= low;
+    memcpy ( r, &y, sizeof y );
+  }
+
+  if ( n )
+  {
+    uint64_t const u = (uint64_t)*a*b + borrow;
+
+    borrow = ( u >> 32 ) + ( *r < (uint32_t)u );
+    *r -= (uint32_t)u;
+  }
+
+  return (uint32_t)borrow;
+}
+
+static void mul_wide ( uint32_t * const r, uint32_t const * const a, size_t const na, uint32_t const * const b, size_t const nb )
+{
+  mul_rows ( addmul_1_wide, r, a, na, b, nb );
+}
+
+static void sqr_wide ( uint32_t * const r, uint32_t const * const a, size_t const n )
+{
+  sqr_rows ( addmul_1_wide, r, a, n );
+}
+
+static void redc_wide ( uint32_t * const t, uint32_t const * const m, size_t const n, uint32_t const minv )
+{
+  redc_rows ( addmul_1_wide, t, m, n, minv );
+}
+
+#endif
+
+#endif
+
+///
+/// @return The highest level the host supports
+///
+static int detect_level ( void )
+{
+#ifdef BIGINT_HAVE_X86
+  __builtin_cpu_init ( );
+
+  if ( !__builtin_cpu_supports ( "sse4.2" ) || !__builtin_cpu_supports ( "pclmul" ) ) return BIGINT_CPU_GENERIC;
+  return BIGINT_CPU_SSE4;
+#else
+  return BIGINT_CPU_GENERIC;
+#endif
+}
+
+///
+/// Picks the level and fills in the kernel table. BIGNUM_CPU may name a
+/// lower level than the host supports; higher ones are ignored.
+///
+static void cpu_start ( void )
+{
+  char const * env = getenv ( "BIGNUM_CPU" );
+  int level = detect_level ( ), i;
+
+  for ( i = 0; env && i < (int)( sizeof level_names / sizeof *level_names ); ++ i )
+  {
+    if ( strcmp ( env, level_names[i] ) == 0 && i < level ) level = i;
+  }
+
+  cpu_level = level;
+  kernels.crc32 = crc32_generic;
+  kernels.mul = mul_generic;
+  kernels.sqr = sqr_generic;
+  kernels.redc = redc_generic;
+  kernels.submul_1 = submul_1_generic;
+
+#ifdef BIGINT_HAVE_X86
+  if ( level >= BIGINT_CPU_SSE4 ) kernels.crc32 = crc32_pclmul;
+#endif
+#ifdef __x86_64__
+  if ( level >= BIGINT_CPU_SSE4 )
+  {
+    kernels.mul = mul_wide;
+    kernels.sqr = sqr_wide;
+    kernels.redc = redc_wide;
+    kernels.submul_1 = submul_1_wide;
+  }
+#endif
+}
+
+///
+/// Reports which instruction set level the arithmetic kernels were
+/// selected for.
+///
+/// @return One of the BIGINT_CPU_ levels
+///
+int bigint_cpu_level ( void )
+{
+  pthread_once ( &cpu_once, cpu_start );
+  return cpu_level;
+}
+
+///
+/// @param level One of the BIGINT_CPU_ levels
+///
+/// @return The level's name, as accepted by BIGNUM_CPU, or NULL
+///
+char const * bigint_cpu_level_name ( int const level )
+{
+  if ( level < 0 || level >= (int)( sizeof level_names / sizeof *level_names ) ) return NULL;
+  return level_names[level];
+}
+
+///
+/// Computes the CRC-32 (IEEE 802.3) of a buffer with the selected kernel.
+///
+/// @param buf The bytes to checksum
+/// @param len The number of bytes
+///
+/// @return The CRC-32 of the buffer
+///
+uint32_t _bigint_crc32 ( unsigned char const * const buf, size_t const len )
+{
+  return ~_bigint_kernels ( )->crc32 ( 0xffffffffu, buf, len );
+}
+
+///
+/// @return The kernel table for the selected level
+///
+Kernels const * _bigint_kernels ( void )
+{
+  pthread_once ( &cpu_once, cpu_start );
+  return &kernels;
+}
@@ -0,0 +1,31 @@
+#ifndef _BIGNUM_CPU_H
+#define _BIGNUM_CPU_H
+
+/**
+  * The table of kernels with more than one implementation (see cpu.c).
+  * Callers fetch it once per operation with _bigint_kernels() and call
+  * through it in their inner loops. This is private to the library.
+  **/
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _tag_kernels
+{
+  uint32_t (*crc32) ( uint32_t, unsigned char const *, size_t );
+  // the na+nb limb product of a and b, and the 2n limb square of a, into r,
+  // which overlaps neither
+  void (*mul) ( uint32_t *, uint32_t const *, size_t, uint32_t const *, size_t );
+  void (*sqr) ( uint32_t *, uint32_t const *, size_t );
+  // Montgomery's reduction of the 2n limb t (plus a spare top limb) by the
+  // odd n limb m, given -m^-1 mod 2^32: leaves t/2^(32n), below 2m, in the
+  // top n+1 limbs
+  void (*redc) ( uint32_t *, uint32_t const *, size_t, uint32_t );
+  // r -= a*b over n limbs, r not overlapping a, returning the limb borrowed
+  // out of the top
+  uint32_t (*submul_1) ( uint32_t *, uint32_t const *, size_t, uint32_t );
+} Kernels;
+
+Kernels const * _bigint_kernels ( void );
+
+#endif // _BIGNUM_CPU_H
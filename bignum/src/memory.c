@@ -0,0 +1,727 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bignum.h"
+#include "memory.h"
+#include "pool.h"
+#include "probes.h"
+
+/**
+  * Every allocation the library makes goes through one set of functions,
+  * malloc() and friends unless bigint_set_memory_functions() says otherwise,
+  * and is counted against an optional limit. Counting is per thread, added
+  * to the process-wide total every MEMORY_SLACK bytes, so a thread may run
+  * past the limit by at most that much. Until a limit or memory functions
+  * are first set nothing is counted and blocks come straight from malloc(),
+  * since every bit of every number is an allocation of its own.
+  *
+  * When an allocation fails the process exits, as it always has, unless
+  * bigint_set_oom_mode() has chosen BIGINT_OOM_STATUS. Then the failing
+  * call unwinds to the guard at its public entry point (see memory.h):
+  * tasks it spawned are waited for, every BigInt and block recorded in the
+  * guard's journal is freed, and the function returns its failure value.
+  **/
+
+// bytes a thread counts on its own before adding them to the total
+#define MEMORY_SLACK 32768
+
+// smallest journal table, in entries
+#define JOURNAL_MIN 64
+
+static void * default_alloc ( size_t const size, void * const ctx )
+{
+  (void)ctx;
+  return malloc ( size );
+}
+
+static void * default_realloc ( void * const p, size_t const old, size_t const size, void * const ctx )
+{
+  (void)old;
+  (void)ctx;
+  return realloc ( p, size );
+}
+
+static void default_free ( void * const p, size_t const size, void * const ctx )
+{
+  (void)size;
+  (void)ctx;
+  free ( p );
+}
+
+static BigIntAllocFn alloc_fn = default_alloc;
+static BigIntReallocFn realloc_fn = default_realloc;
+static BigIntFreeFn free_fn = default_free;
+static void * memory_ctx = NULL;
+
+///
+/// Stands in for a reallocation function when only allocation and free
+/// functions were given.
+///
+static void * emulated_realloc ( void * const p, size_t const old, size_t const size, void * const ctx )
+{
+  void * q = alloc_fn ( size, ctx );
+
+  if ( q )
+  {
+    memcpy ( q, p, old < size ? old : size );
+    free_fn ( p, old, ctx );
+  }
+
+  return q;
+}
+
+int _bigint_oom_mode = BIGINT_OOM_EXIT;
+
+static size_t limit = 0;
+static int64_t in_use = 0;
+
+// set for good by the first limit or memory functions, so that every block
+// freed while counting was counted when it was allocated (or before it, which
+// can only undercount)
+static bool counting = false;
+
+static pthread_once_t memory_once = PTHREAD_ONCE_INIT;
+static pthread_key_t memory_key;
+
+static __thread int64_t unflushed = 0;
+static __thread bool registered = false;
+static __thread bool out_of_memory = false;
+
+// the innermost frame, and the journal recording allocations on this thread
+static __thread MemoryFrame * top = NULL;
+static __thread MemoryJournal * journal = NULL;
+
+static void memory_flush ( void )
+{
+  __atomic_add_fetch ( &in_use, unflushed, __ATOMIC_RELAXED );
+  unflushed = 0;
+}
+
+static void thread_exit ( void * const arg )
+{
+  (void)arg;
+  memory_flush ( );
+}
+
+static void memory_start ( void )
+{
+  pthread_key_create ( &memory_key, thread_exit );
+}
+
+///
+/// Arranges for the calling thread's count to be flushed when it exits.
+///
+static void register_thread ( void )
+{
+  pthread_once ( &memory_once, memory_start );
+  pthread_setspecific ( memory_key, &unflushed );
+  registered = true;
+}
+
+///
+/// Counts bytes about to be allocated.
+///
+/// @return false if they would exceed the limit
+///
+static bool charge ( size_t const size )
+{
+  size_t const cap = __atomic_load_n ( &limit, __ATOMIC_RELAXED );
+
+  if ( cap && ( size > cap || __atomic_load_n ( &in_use, __ATOMIC_RELAXED ) + unflushed > (int64_t)( cap - size ) ) )
+  {
+    return false;
+  }
+
+  if ( !registered ) register_thread ( );
+
+  unflushed += size;
+  if ( unflushed > MEMORY_SLACK ) memory_flush ( );
+
+  return true;
+}
+
+static void discharge ( size_t const size )
+{
+  if ( !registered ) register_thread ( );
+
+  unflushed -= size;
+  if ( unflushed < -MEMORY_SLACK ) memory_flush ( );
+}
+
+static void * raw_alloc ( size_t const size )
+{
+  void * p;
+
+  if ( size >= BIGINT_PROBE_ALLOC_BYTES ) PROBE1 ( alloc, size );
+
+  if ( !__atomic_load_n ( &counting, __ATOMIC_RELAXED ) ) return malloc ( size );
+
+  if ( !charge ( size ) ) return NULL;
+
+  p = alloc_fn ( size, memory_ctx );
+  if ( !p ) discharge ( size );
+
+  return p;
+}
+
+static void * raw_realloc ( void * const p, size_t const old, size_t const size )
+{
+  void * q;
+
+  if ( size >= BIGINT_PROBE_ALLOC_BYTES ) PROBE1 ( alloc, size );
+
+  if ( !__atomic_load_n ( &counting, __ATOMIC_RELAXED ) ) return realloc ( p, size );
+
+  if ( size > old && !charge ( size - old ) ) return NULL;
+
+  q = realloc_fn ( p, old, size, memory_ctx );
+
+  if ( !q && size > old ) discharge ( size - old );
+  if ( q && size < old ) discharge ( old - size );
+
+  return q;
+}
+
+static void raw_free ( void * const p, size_t const size )
+{
+  if ( !p ) return;
+
+  if ( !__atomic_load_n ( &counting, __ATOMIC_RELAXED ) )
+  {
+    free ( p );
+    return;
+  }
+
+  free_fn ( p, size, memory_ctx );
+  discharge ( size );
+}
+
+static size_t journal_slot ( MemoryJournal const * const j, void const * const p )
+{
+  uint64_t h = (uint64_t)(uintptr_t)p * 0x9e3779b97f4a7c15u;
+
+  return (size_t)( h ^ ( h >> 29 ) ) & ( j->capacity - 1 );
+}
+
+///
+/// Adds an entry to a journal with room for it. Call with j->lock held.
+///
+static void journal_insert ( MemoryJournal * const j, void * const p, size_t const size )
+{
+  size_t i = journal_slot ( j, p );
+
+  while ( j->entries[i].p ) i = ( i + 1 ) & ( j->capacity - 1 );
+
+  j->entries[i].p = p;
+  j->entries[i].size = size;
+  j->count ++;
+}
+
+///
+/// Removes an entry from a journal, if present. Call with j->lock held.
+///
+/// @return Whether the entry was present
+///
+static bool journal_take ( MemoryJournal * const j, void const * const p )
+{
+  size_t mask = j->capacity - 1, i, k;
+
+  if ( j->count == 0 ) return false;
+
+  for ( i = journal_slot ( j, p ); j->entries[i].p != p; i = ( i + 1 ) & mask )
+  {
+    if ( !j->entries[i].p ) return false;
+  }
+
+  j->entries[i].p = NULL;
+  j->count --;
+
+  // close the gap: move back any later entry of the run whose home slot is
+  // not cyclically in (i,k]
+  for ( k = ( i + 1 ) & mask; j->entries[k].p; k = ( k + 1 ) & mask )
+  {
+    size_t h = journal_slot ( j, j->entries[k].p );
+
+    if ( i <= k ? ( i < h && h <= k ) : ( i < h || h <= k ) ) continue;
+
+    j->entries[i] = j->entries[k];
+    j->entries[k].p = NULL;
+    i = k;
+  }
+
+  return true;
+}
+
+///
+/// Records an allocation in a journal, doubling its table when half full.
+///
+/// @return false if the table could not grow
+///
+static bool journal_add ( MemoryJournal * const j, void * const p, size_t const size )
+{
+  bool ok = true;
+
+  pthread_mutex_lock ( &j->lock );
+
+  if ( 2 * ( j->count + 1 ) > j->capacity )
+  {
+    MemoryEntry * old = j->entries;
+    size_t capacity = j->capacity, i;
+    MemoryEntry * entries = raw_alloc ( ( capacity ? 2 * capacity : JOURNAL_MIN ) * sizeof*entries );
+
+    if ( entries )
+    {
+      j->entries = entries;
+      j->capacity = capacity ? 2 * capacity : JOURNAL_MIN;
+      j->count = 0;
+      memset ( entries, 0, j->capacity * sizeof*entries );
+
+      for ( i = 0; i < capacity; ++ i )
+      {
+        if ( old[i].p ) journal_insert ( j, old[i].p, old[i].size );
+      }
+
+      raw_free ( old, capacity * sizeof*old );
+    }
+    else
+    {
+      ok = false;
+    }
+  }
+
+  if ( ok ) journal_insert ( j, p, size );
+
+  pthread_mutex_unlock ( &j->lock );
+
+  return ok;
+}
+
+static void journal_remove ( MemoryJournal * const j, void const * const p )
+{
+  pthread_mutex_lock ( &j->lock );
+  journal_take ( j, p );
+  pthread_mutex_unlock ( &j->lock );
+}
+
+///
+/// Releases a journal's table, leaving whatever it recorded allocated.
+///
+static void journal_forget ( MemoryJournal * const j )
+{
+  raw_free ( j->entries, j->capacity * sizeof*j->entries );
+  pthread_mutex_destroy ( &j->lock );
+}
+
+///
+/// Frees everything a journal recorded, then the journal. Call with no
+/// journal in effect, so that the frees are not looked up in it.
+///
+static void journal_unwind ( MemoryJournal * const j )
+{
+  size_t i;
+
+  for ( i = 0; i < j->capacity; ++ i )
+  {
+    MemoryEntry const e = j->entries[i];
+
+    if ( !e.p ) continue;
+
+    if ( e.size == MEMORY_BIGINT ) bigint_free ( e.p );
+    else raw_free ( e.p, e.size );
+  }
+
+  journal_forget ( j );
+}
+
+///
+/// Unwinds to the innermost frame. Tasks spawned above it are waited for
+/// first, since they may be using what it protects; a guard then frees what
+/// its journal recorded.
+///
+static void memory_raise ( void ) __attribute__ (( noreturn ));
+static void memory_raise ( void )
+{
+  MemoryFrame * const f = top;
+
+  _bigint_pool_unwind ( f->spawned );
+
+  top = f->up;
+  journal = f->outer;
+
+  if ( f->guard ) journal_unwind ( &f->own );
+
+  longjmp ( f->env, 1 );
+}
+
+///
+/// Handles a failed allocation: exits, or unwinds with the failure flagged.
+///
+static void memory_fail ( void ) __attribute__ (( noreturn ));
+static void memory_fail ( void )
+{
+  if ( _bigint_oom_mode == BIGINT_OOM_EXIT || !top ) exit(EXIT_FAILURE);
+
+  out_of_memory = true;
+  errno = ENOMEM;
+  memory_raise ( );
+}
+
+///
+/// Records a new allocation in the journal in effect, if any.
+///
+static void * record ( void * const p, size_t const size, size_t const bytes )
+{
+  if ( journal && !journal_add ( journal, p, size ) )
+  {
+    raw_free ( p, bytes );
+    memory_fail ( );
+  }
+
+  return p;
+}
+
+///
+/// Allocates a block, recording it until the public call making it returns.
+/// Out of memory, this does not return.
+///
+void * _bigint_alloc ( size_t const size )
+{
+  void * p = raw_alloc ( size );
+
+  if ( !p ) memory_fail ( );
+
+  return record ( p, size, size );
+}
+
+///
+/// Resizes a block from _bigint_alloc(). Out of memory, this does not
+/// return and the block is left as it was.
+///
+void * _bigint_realloc ( void * const p, size_t const old, size_t const size )
+{
+  void * q = raw_realloc ( p, old, size );
+
+  if ( !q ) memory_fail ( );
+
+  if ( journal )
+  {
+    pthread_mutex_lock ( &journal->lock );
+    if ( journal_take ( journal, p ) ) journal_insert ( journal, q, size );
+    pthread_mutex_unlock ( &journal->lock );
+  }
+
+  return q;
+}
+
+///
+/// Frees a block from _bigint_alloc() or _bigint_realloc().
+///
+void _bigint_free ( void * const p, size_t const size )
+{
+  if ( !p ) return;
+
+  if ( journal ) journal_remove ( journal, p );
+  raw_free ( p, size );
+}
+
+///
+/// Allocates a block that is not recorded, because it will belong to
+/// something that outlives a failed call or frees it: bits and share counts
+/// (freed with their BigInt) and cached tables. Out of memory, this does not
+/// return.
+///
+void * _bigint_alloc_owned ( size_t const size )
+{
+  void * p = raw_alloc ( size );
+
+  if ( !p ) memory_fail ( );
+
+  return p;
+}
+
+void _bigint_free_owned ( void * const p, size_t const size )
+{
+  raw_free ( p, size );
+}
+
+///
+/// Allocates an unrecorded block for callers that recover from failure.
+///
+/// @return The block, or NULL
+///
+void * _bigint_try_alloc ( size_t const size )
+{
+  return raw_alloc ( size );
+}
+
+void * _bigint_try_realloc ( void * const p, size_t const old, size_t const size )
+{
+  return raw_realloc ( p, old, size );
+}
+
+///
+/// Allocates the structure of a BigInt, recording it so that bigint_free()
+/// is called on it if the public call making it fails.
+///
+BigInt * _bigint_alloc_bigint ( void )
+{
+  BigInt * b = raw_alloc ( sizeof*b );
+
+  if ( !b ) memory_fail ( );
+
+  return record ( b, MEMORY_BIGINT, sizeof*b );
+}
+
+void _bigint_free_bigint ( BigInt * const b )
+{
+  if ( !b ) return;
+
+  if ( journal ) journal_remove ( journal, b );
+  raw_free ( b, sizeof*b );
+}
+
+///
+/// Stops recording an allocation that has been handed to something longer
+/// lived than the call making it, such as a cache or a parser.
+///
+void _bigint_memory_keep ( void const * const p )
+{
+  if ( journal ) journal_remove ( journal, p );
+}
+
+///
+/// Reports a failed allocation that the caller has recovered from: exits in
+/// BIGINT_OOM_EXIT mode, otherwise flags it for bigint_out_of_memory().
+///
+void _bigint_memory_exhausted ( void )
+{
+  if ( _bigint_oom_mode == BIGINT_OOM_EXIT ) exit(EXIT_FAILURE);
+
+  out_of_memory = true;
+  errno = ENOMEM;
+}
+
+///
+/// Pushes a guard with a journal of its own unless the thread is already
+/// inside a guarded call. See MEMORY_GUARD().
+///
+/// @return Whether the guard was pushed
+///
+bool _bigint_memory_enter ( MemoryFrame * const f )
+{
+  if ( top || journal ) return false;
+
+  f->up = NULL;
+  f->outer = NULL;
+  f->spawned = _bigint_pool_unjoined ( );
+  f->own.entries = NULL;
+  f->own.capacity = f->own.count = 0;
+  pthread_mutex_init ( &f->own.lock, NULL );
+
+  top = f;
+  journal = &f->own;
+  out_of_memory = false;
+
+  return true;
+}
+
+///
+/// Pops a guard on return, keeping what its journal recorded.
+///
+void _bigint_memory_leave ( MemoryFrame * const f )
+{
+  // a guard that has been unwound to is gone already
+  if ( top != f ) return;
+
+  top = f->up;
+  journal = f->outer;
+  journal_forget ( &f->own );
+}
+
+void _bigint_memory_push_frame ( MemoryFrame * const f )
+{
+  f->guard = false;
+  f->up = top;
+  f->outer = journal;
+  f->spawned = _bigint_pool_unjoined ( );
+  top = f;
+}
+
+void _bigint_memory_pop_frame ( MemoryFrame * const f )
+{
+  top = f->up;
+}
+
+///
+/// Passes a failure on from a MEMORY_CATCH block to the next frame out.
+///
+void _bigint_memory_rethrow ( void )
+{
+  memory_raise ( );
+}
+
+///
+/// @return The journal in effect on this thread, for tasks spawned to the
+/// pool to record into
+///
+MemoryJournal * _bigint_memory_journal ( void )
+{
+  return journal;
+}
+
+///
+/// Runs a pool task under the journal of the call that spawned it.
+///
+/// @return false if the task ran out of memory; its allocations are left
+/// for the spawner's guard to free
+///
+bool _bigint_memory_run ( MemoryJournal * const j, void (*run) ( void * ), void * const arg )
+{
+  MemoryFrame f;
+
+  if ( !j )
+  {
+    run ( arg );
+    return true;
+  }
+
+  f.guard = false;
+  f.pushed = true;
+  f.up = top;
+  f.outer = journal;
+  f.spawned = _bigint_pool_unjoined ( );
+  top = &f;
+  journal = j;
+
+  if ( setjmp ( f.env ) ) return false;
+
+  run ( arg );
+
+  top = f.up;
+  journal = f.outer;
+
+  return true;
+}
+
+///
+/// Sets the functions all of the library's memory comes from, in the manner
+/// of GMP's mp_set_memory_functions(). Call this before anything else, since
+/// memory is always freed through the functions current at the time.
+///
+/// @param alloc Allocates size bytes, or returns NULL
+/// @param realloc Resizes a block from old to size bytes, or returns NULL
+/// leaving it as it was; if NULL, alloc, copy and free are used instead
+/// @param free Frees a block of size bytes
+/// @param ctx Passed through to each function
+///
+/// Any function given as NULL (all three, to restore the defaults) is the
+/// standard library's.
+///
+void bigint_set_memory_functions ( BigIntAllocFn const alloc, BigIntReallocFn const realloc, BigIntFreeFn const free, void * const ctx )
+{
+  alloc_fn = alloc ? alloc : default_alloc;
+  free_fn = free ? free : default_free;
+  realloc_fn = realloc ? realloc : alloc ? emulated_realloc : default_realloc;
+  memory_ctx = ctx;
+  if ( alloc || realloc || free ) __atomic_store_n ( &counting, true, __ATOMIC_RELAXED );
+}
+
+///
+/// Reports the functions set by bigint_set_memory_functions(). Any of the
+/// addresses may be NULL.
+///
+void bigint_get_memory_functions ( BigIntAllocFn * const alloc, BigIntReallocFn * const realloc, BigIntFreeFn * const free, void ** const ctx )
+{
+  if ( alloc ) *alloc = alloc_fn;
+  if ( realloc ) *realloc = realloc_fn;
+  if ( free ) *free = free_fn;
+  if ( ctx ) *ctx = memory_ctx;
+}
+
+///
+/// Caps the memory the library may hold through the current functions.
+/// Allocations that would pass the cap fail as if the functions had
+/// returned NULL. Each thread counts up to 32 KiB before adding to the total,
+/// so the cap may be overrun by that much per thread. Counting starts with
+/// the first cap (or bigint_set_memory_functions()), so memory held before
+/// then is not charged against it.
+///
+/// @param bytes The cap; 0 for none
+///
+/// @return The previous cap
+///
+size_t bigint_set_memory_limit ( size_t const bytes )
+{
+  if ( bytes ) __atomic_store_n ( &counting, true, __ATOMIC_RELAXED );
+  return __atomic_exchange_n ( &limit, bytes, __ATOMIC_RELAXED );
+}
+
+///
+/// @return The bytes the library holds, as counted against the limit: exact
+/// for the calling thread, and to within 32 KiB for each of the others. Only
+/// memory allocated since a limit or memory functions were first set is
+/// counted.
+///
+size_t bigint_memory_in_use ( void )
+{
+  int64_t n = __atomic_load_n ( &in_use, __ATOMIC_RELAXED ) + unflushed;
+
+  return n > 0 ? (size_t)n : 0;
+}
+
+///
+/// Chooses what happens when memory runs out. BIGINT_OOM_EXIT, the default,
+/// ends the process. Under BIGINT_OOM_STATUS the failing call frees what it
+/// had allocated and returns NULL (functions returning a BigInt or string),
+/// -1 (functions returning a status) or false; bigint_out_of_memory() then
+/// tells these apart from other failures. A BigInt modified in place holds
+/// an unspecified but valid value afterwards. Set the mode before any other
+/// call, and do not call the library from a BigIntWriteFn in this mode.
+///
+/// @param mode BIGINT_OOM_EXIT or BIGINT_OOM_STATUS
+///
+/// @return The previous mode, or -1 (and nothing changes) for an unknown one
+///
+int bigint_set_oom_mode ( int const mode )
+{
+  int previous = _bigint_oom_mode;
+
+  if ( mode != BIGINT_OOM_EXIT && mode != BIGINT_OOM_STATUS ) return -1;
+
+  _bigint_oom_mode = mode;
+  return previous;
+}
+
+///
+/// @return true if the last call into the library on this thread ran out of
+/// memory (in BIGINT_OOM_STATUS mode)
+///
+bool bigint_out_of_memory ( void )
+{
+  return out_of_memory;
+}
+
+///
+/// Frees a string returned by the library. free() will do as well while the
+/// default memory functions are in use and no limit is set.
+///
+void bigint_free_string ( char * const s )
+{
+  if ( s ) _bigint_free ( s, strlen ( s ) + 1 );
+}
+
+///
+/// Frees a buffer returned by the library, such as bigint_export()'s.
+///
+/// @param p The buffer
+/// @param size Its size, as returned alongside it
+///
+void bigint_free_buffer ( void * const p, size_t const size )
+{
+  _bigint_free ( p, size );
+}
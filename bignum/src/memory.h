@@ -0,0 +1,118 @@
+#ifndef _BIGNUM_MEMORY_H
+#define _BIGNUM_MEMORY_H
+
+/**
+  * Allocation through the functions set by bigint_set_memory_functions(),
+  * and the unwinding behind BIGINT_OOM_STATUS (see memory.c). This is
+  * private to the library.
+  *
+  * Each public function that allocates starts with MEMORY_GUARD(failed). In
+  * BIGINT_OOM_STATUS mode the outermost guard on a thread records every
+  * BigInt and block allocated under it, including on pool threads working
+  * for it; if an allocation fails, whatever is still recorded is freed and
+  * the guarded function returns failed. Code that holds a lock or a
+  * reference across a call that may allocate pushes a MEMORY_CATCH frame
+  * to let go of it, then passes the failure on with _bigint_memory_rethrow().
+  **/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <pthread.h>
+
+#include "bignum.h"
+
+struct _tag_bigint_task;
+
+typedef struct _tag_memory_entry
+{
+  void * p;
+  // MEMORY_BIGINT for a BigInt, freed with bigint_free()
+  size_t size;
+} MemoryEntry;
+
+#define MEMORY_BIGINT ((size_t)-1)
+
+///
+/// The BigInts and blocks allocated under a guard and not yet freed, as an
+/// open-addressed hash set.
+///
+typedef struct _tag_memory_journal
+{
+  pthread_mutex_t lock;
+  MemoryEntry * entries;
+  size_t capacity, count;
+} MemoryJournal;
+
+typedef struct _tag_memory_frame
+{
+  jmp_buf env;
+  struct _tag_memory_frame * up;
+  // whether the frame was pushed, and whether it is a guard
+  bool pushed, guard;
+  // the journal in effect below this frame, and the tasks spawned below it
+  MemoryJournal * outer;
+  struct _tag_bigint_task * spawned;
+  // a guard's own journal
+  MemoryJournal own;
+} MemoryFrame;
+
+extern int _bigint_oom_mode;
+
+void * _bigint_alloc ( size_t );
+void * _bigint_realloc ( void *, size_t, size_t );
+void _bigint_free ( void *, size_t );
+void * _bigint_alloc_owned ( size_t );
+void _bigint_free_owned ( void *, size_t );
+void * _bigint_try_alloc ( size_t );
+void * _bigint_try_realloc ( void *, size_t, size_t );
+BigInt * _bigint_alloc_bigint ( void );
+void _bigint_free_bigint ( BigInt * );
+void _bigint_memory_keep ( void const * );
+void _bigint_memory_exhausted ( void );
+
+bool _bigint_memory_enter ( MemoryFrame * );
+void _bigint_memory_leave ( MemoryFrame * );
+void _bigint_memory_push_frame ( MemoryFrame * );
+void _bigint_memory_pop_frame ( MemoryFrame * );
+void _bigint_memory_rethrow ( void ) __attribute__ (( noreturn ));
+MemoryJournal * _bigint_memory_journal ( void );
+bool _bigint_memory_run ( MemoryJournal *, void (*) ( void * ), void * );
+
+static inline bool _bigint_memory_guard ( MemoryFrame * const f )
+{
+  f->guard = _bigint_oom_mode != BIGINT_OOM_EXIT && _bigint_memory_enter ( f );
+  return f->guard;
+}
+
+static inline void _bigint_memory_unguard ( MemoryFrame * const f )
+{
+  if ( f->guard ) _bigint_memory_leave ( f );
+}
+
+static inline bool _bigint_memory_push ( MemoryFrame * const f )
+{
+  f->pushed = _bigint_oom_mode != BIGINT_OOM_EXIT;
+  if ( f->pushed ) _bigint_memory_push_frame ( f );
+  return f->pushed;
+}
+
+static inline void _bigint_memory_pop ( MemoryFrame * const f )
+{
+  if ( f->pushed ) _bigint_memory_pop_frame ( f );
+}
+
+// MEMORY_GUARD_CATCH() { ... } runs the block, after the recorded
+// allocations have been freed, if memory runs out inside the function;
+// the block must return. MEMORY_GUARD(failed) just returns failed.
+#define MEMORY_GUARD_CATCH() \
+  MemoryFrame memory_guard __attribute__ (( cleanup ( _bigint_memory_unguard ) )); \
+  if ( !_bigint_memory_guard ( &memory_guard ) ) { } else if ( setjmp ( memory_guard.env ) )
+#define MEMORY_GUARD(failed) MEMORY_GUARD_CATCH ( ) return failed
+
+// MEMORY_CATCH(frame) { ...; _bigint_memory_rethrow ( ); } runs the block if
+// memory runs out before _bigint_memory_pop(&frame)
+#define MEMORY_CATCH(frame) \
+  if ( !_bigint_memory_push ( &(frame) ) ) { } else if ( setjmp ( (frame).env ) )
+
+#endif // _BIGNUM_MEMORY_H
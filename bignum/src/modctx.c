@@ -0,0 +1,883 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+#include "stats.h"
+#include "memory.h"
+#include "pool.h"
+#include "cpu.h"
+
+/**
+  * Arithmetic modulo one fixed modulus on residues held in caller-owned
+  * arrays of 32-bit limbs, least significant first. Everything that depends
+  * only on the modulus is worked out once by bigint_modctx_new(); after that
+  * the operations touch no memory but their arguments and the caller's
+  * scratch, and a context may be shared between threads.
+  *
+  * Odd moduli use Montgomery multiplication (residues are kept as a*R mod m,
+  * R = 2^(32n)); even ones use Barrett reduction with a precomputed
+  * reciprocal (residues are kept as they are). Either way every residue is
+  * fully reduced, so two residues are equal exactly when their limbs are.
+  **/
+
+// the table of a^0..a^(2^k-1) bigint_modctx_powmod() multiplies in
+#define POW_WINDOW 4
+
+// the fewest values bigint_invmod_batch() hands to a pool thread
+#define BATCH_RANGE 256
+
+struct _tag_bigint_modctx
+{
+  size_t n;
+  bool montgomery;
+  // -m^-1 mod 2^32 (Montgomery)
+  uint32_t minv;
+  // the modulus and 1 as a residue, n limbs each; R^2 mod m (Montgomery,
+  // n limbs) or floor(2^(64n)/m) (Barrett, n+2 limbs)
+  uint32_t * m, * one, * r2, * mu;
+};
+
+///
+/// Copies the magnitude of a BigInt known to be below 2^(32n) into n limbs.
+///
+static void limbs_from_bigint ( uint32_t * const r, size_t const n, BigInt const * const bi )
+{
+  Bit const * bit;
+  size_t i;
+
+  memset ( r, 0, n*sizeof*r );
+  for ( i = 0, bit = bi->lsb; bit && i < 32*n; bit = walk_toward_msb ( bit, 1 ), ++ i )
+  {
+    r[i/32] |= (uint32_t)bit->bit << (i%32);
+  }
+}
+
+///
+/// @return a - b over n limbs into r, and the borrow out
+///
+static uint32_t limbs_sub ( uint32_t * const r, uint32_t const * const a, uint32_t const * const b, size_t const n )
+{
+  uint64_t borrow = 0;
+  size_t i;
+
+  for ( i = 0; i < n; ++ i )
+  {
+    uint64_t d = (uint64_t)a[i] - b[i] - borrow;
+    r[i] = (uint32_t)d;
+    borrow = ( d >> 32 ) & 1;
+  }
+
+  return (uint32_t)borrow;
+}
+
+///
+/// @return a + b over n limbs into r, and the carry out
+///
+static uint32_t limbs_add ( uint32_t * const r, uint32_t const * const a, uint32_t const * const b, size_t const n )
+{
+  uint64_t carry = 0;
+  size_t i;
+
+  for ( i = 0; i < n; ++ i )
+  {
+    carry += (uint64_t)a[i] + b[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+
+  return (uint32_t)carry;
+}
+
+///
+/// @return Whether a >= b over n limbs
+///
+static bool limbs_geq ( uint32_t const * const a, uint32_t const * const b, size_t n )
+{
+  while ( n -- > 0 )
+  {
+    if ( a[n] != b[n] ) return a[n] > b[n];
+  }
+  return true;
+}
+
+///
+/// Sets x to 2x + bit reduced modulo m, for x already below m.
+///
+/// @return Whether m was subtracted, i.e. the quotient bit
+///
+static bool limbs_shift_in ( uint32_t * const x, uint32_t const * const m, size_t const n, uint32_t carry )
+{
+  size_t i;
+
+  for ( i = 0; i < n; ++ i )
+  {
+    uint32_t top = x[i] >> 31;
+    x[i] = ( x[i] << 1 ) | carry;
+    carry = top;
+  }
+  if ( !carry && !limbs_geq ( x, m, n ) ) return false;
+  limbs_sub ( x, x, m, n );
+  return true;
+}
+
+///
+/// Writes the na+nb limb product of a and b to r, which must not overlap
+/// either.
+///
+static void limbs_mul ( uint32_t * const r, uint32_t const * const a, size_t const na, uint32_t const * const b, size_t const nb )
+{
+  _bigint_kernels ( )->mul ( r, a, na, b, nb );
+}
+
+///
+/// Writes the 2n limb square of a to r, which must not overlap it: each
+/// cross product is formed once and doubled.
+///
+static void limbs_sqr ( uint32_t * const r, uint32_t const * const a, size_t const n )
+{
+  _bigint_kernels ( )->sqr ( r, a, n );
+}
+
+///
+/// Reduces a 2n limb product t < m^2 into r. Montgomery's method divides by R
+/// on the way (t gets a spare top limb); Barrett's subtracts an estimate of
+/// the quotient made with the reciprocal, which is never more than two short.
+///
+static void reduce ( BigModCtx const * const ctx, uint32_t * const r, uint32_t * const t, uint32_t * const scratch )
+{
+  size_t const n = ctx->n;
+
+  if ( ctx->montgomery )
+  {
+    _bigint_kernels ( )->redc ( t, ctx->m, n, ctx->minv );
+
+    // t/R < 2m
+    if ( t[2*n] || limbs_geq ( t + n, ctx->m, n ) )
+    {
+      limbs_sub ( t + n, t + n, ctx->m, n );
+    }
+    memcpy ( r, t + n, n*sizeof*r );
+  }
+  else
+  {
+    // q = floor(floor(t/b^(n-1)) * mu / b^(n+1)), r = t - q*m mod b^(n+1);
+    // mu may take n+2 limbs (when m = b^(n-1)), but q is below m as t < m^2
+    uint32_t * const q = scratch, * const qm = scratch + 2*n + 3;
+
+    limbs_mul ( q, t + n - 1, n + 1, ctx->mu, n + 2 );
+    limbs_mul ( qm, q + n + 1, n + 1, ctx->m, n );
+    limbs_sub ( t, t, qm, n + 1 );
+
+    while ( t[n] || limbs_geq ( t, ctx->m, n ) )
+    {
+      t[n] -= limbs_sub ( t, t, ctx->m, n );
+    }
+    memcpy ( r, t, n*sizeof*r );
+  }
+}
+
+///
+/// Creates the context for arithmetic modulo |m|.
+///
+/// @param m The modulus, nonzero
+///
+/// @return A new context, or NULL if m is zero or memory ran out (see
+/// bigint_set_oom_mode()). Must be freed with bigint_modctx_free().
+///
+BigModCtx * bigint_modctx_new ( BigInt const * const m )
+{
+  MEMORY_GUARD ( NULL );
+
+  size_t const n = ( (size_t)_bigint_significant_bits ( m ) + 31 ) / 32;
+  BigModCtx * ctx;
+  size_t i;
+
+  if ( n == 0 ) return NULL;
+
+  ctx = _bigint_alloc ( sizeof*ctx + (3*n + 2)*sizeof*ctx->m );
+  ctx->n = n;
+  ctx->m = (uint32_t *)( ctx + 1 );
+  ctx->one = ctx->m + n;
+  ctx->r2 = ctx->mu = ctx->one + n;
+  ctx->montgomery = m->lsb->bit;
+  limbs_from_bigint ( ctx->m, n, m );
+
+  // The constants come from shifting 1 in a bit at a time, each step a
+  // doubling and at most one subtraction, which is far cheaper than long
+  // division on the list
+  memset ( ctx->one, 0, (2*n + 2)*sizeof*ctx->one );
+
+  if ( ctx->montgomery )
+  {
+    // Newton's iteration doubles the correct low bits of an inverse; an
+    // odd number is its own inverse modulo 8
+    uint32_t inv = ctx->m[0];
+    int k;
+
+    for ( k = 0; k < 4; ++ k ) inv *= 2 - ctx->m[0]*inv;
+    ctx->minv = 0u - inv;
+
+    // 1 is R mod m; R^2 mod m moves plain numbers in
+    limbs_shift_in ( ctx->one, ctx->m, n, 1 );
+    for ( i = 0; i < 32*n; ++ i ) limbs_shift_in ( ctx->one, ctx->m, n, 0 );
+    memcpy ( ctx->r2, ctx->one, n*sizeof*ctx->r2 );
+    for ( i = 0; i < 32*n; ++ i ) limbs_shift_in ( ctx->r2, ctx->m, n, 0 );
+  }
+  else
+  {
+    // mu is floor(2^(64n) / m), at most 2^(32n+32) (when m = 2^(32n-32))
+    // and so within its n+2 limbs; the remainder runs in one and is
+    // cleared afterwards. An even m is at least 2, so the leading 1 never
+    // yields a quotient bit
+    ctx->minv = 0;
+    limbs_shift_in ( ctx->one, ctx->m, n, 1 );
+    for ( i = 64*n; i-- > 0; )
+    {
+      if ( limbs_shift_in ( ctx->one, ctx->m, n, 0 ) ) ctx->mu[i/32] |= 1u << i%32;
+    }
+
+    memset ( ctx->one, 0, n*sizeof*ctx->one );
+    ctx->one[0] = n > 1 || ctx->m[0] > 1;
+  }
+
+  _bigint_memory_keep ( ctx );
+  return ctx;
+}
+
+///
+/// Releases a context made by bigint_modctx_new().
+///
+/// @param ctx The context, or NULL
+///
+void bigint_modctx_free ( BigModCtx * const ctx )
+{
+  if ( ctx ) _bigint_free ( ctx, sizeof*ctx + (3*ctx->n + 2)*sizeof*ctx->m );
+}
+
+///
+/// @param ctx The context
+///
+/// @return The number of limbs in a residue
+///
+size_t bigint_modctx_limbs ( BigModCtx const * const ctx )
+{
+  return ctx->n;
+}
+
+///
+/// @param ctx The context
+///
+/// @return The number of limbs of scratch the operations taking scratch need;
+/// enough for any of them, including bigint_modctx_powmod()
+///
+size_t bigint_modctx_scratch_limbs ( BigModCtx const * const ctx )
+{
+  size_t const n = ctx->n;
+
+  // the window table and accumulator, a double-width product with a spare
+  // limb, and Barrett's quotient estimate and its multiple of m
+  return ( ( 1 << POW_WINDOW ) + 1 )*n + ( 2*n + 1 ) + ( ctx->montgomery ? 0 : 4*n + 4 );
+}
+
+///
+/// Multiplies two residues.
+///
+/// @param ctx The context
+/// @param r The residue receiving a*b mod m; may be a or b
+/// @param a A residue
+/// @param b A residue
+/// @param scratch bigint_modctx_scratch_limbs() limbs
+///
+void bigint_modctx_mulmod ( BigModCtx const * const ctx, uint32_t * const r, uint32_t const * const a, uint32_t const * const b, uint32_t * const scratch )
+{
+  limbs_mul ( scratch, a, ctx->n, b, ctx->n );
+  reduce ( ctx, r, scratch, scratch + 2*ctx->n + 1 );
+}
+
+///
+/// Squares a residue, forming each cross product once.
+///
+/// @param ctx The context
+/// @param r The residue receiving a*a mod m; may be a
+/// @param a A residue
+/// @param scratch bigint_modctx_scratch_limbs() limbs
+///
+void bigint_modctx_sqrmod ( BigModCtx const * const ctx, uint32_t * const r, uint32_t const * const a, uint32_t * const scratch )
+{
+  limbs_sqr ( scratch, a, ctx->n );
+  reduce ( ctx, r, scratch, scratch + 2*ctx->n + 1 );
+}
+
+///
+/// Adds two residues.
+///
+/// @param ctx The context
+/// @param r The residue receiving a+b mod m; may be a or b
+/// @param a A residue
+/// @param b A residue
+///
+void bigint_modctx_addmod ( BigModCtx const * const ctx, uint32_t * const r, uint32_t const * const a, uint32_t const * const b )
+{
+  if ( limbs_add ( r, a, b, ctx->n ) || limbs_geq ( r, ctx->m, ctx->n ) )
+  {
+    limbs_sub ( r, r, ctx->m, ctx->n );
+  }
+}
+
+///
+/// Subtracts one residue from another.
+///
+/// @param ctx The context
+/// @param r The residue receiving a-b mod m; may be a or b
+/// @param a A residue
+/// @param b A residue
+///
+void bigint_modctx_submod ( BigModCtx const * const ctx, uint32_t * const r, uint32_t const * const a, uint32_t const * const b )
+{
+  if ( limbs_sub ( r, a, b, ctx->n ) )
+  {
+    limbs_add ( r, r, ctx->m, ctx->n );
+  }
+}
+
+///
+/// Raises a residue to a power by fixed windows of POW_WINDOW exponent bits.
+///
+/// @param ctx The context
+/// @param r The residue receiving a^|e| mod m; may be a
+/// @param a A residue
+/// @param e The exponent, whose sign is ignored
+/// @param scratch bigint_modctx_scratch_limbs() limbs
+///
+void bigint_modctx_powmod ( BigModCtx const * const ctx, uint32_t * const r, uint32_t const * const a, BigInt const * const e, uint32_t * const scratch )
+{
+  STATS_BEGIN ( (uint64_t)e->count + 32*ctx->n );
+  size_t const n = ctx->n;
+  uint32_t * const table = scratch, * const acc = scratch + ( (size_t)1 << POW_WINDOW )*n;
+  uint32_t * const work = acc + n;
+  int bits = _bigint_significant_bits ( e ), width, i;
+  Bit const * bit = bits > 0 ? walk_toward_msb ( e->lsb, bits - 1 ) : NULL;
+
+  memcpy ( table, ctx->one, n*sizeof*table );
+  memcpy ( table + n, a, n*sizeof*table );
+  for ( i = 2; i < ( 1 << POW_WINDOW ); ++ i )
+  {
+    bigint_modctx_mulmod ( ctx, table + i*n, table + (i-1)*n, a, work );
+  }
+
+  memcpy ( acc, ctx->one, n*sizeof*acc );
+
+  // the top window takes whatever is left over above the whole windows
+  width = bits % POW_WINDOW ? bits % POW_WINDOW : POW_WINDOW;
+  while ( bits > 0 )
+  {
+    int w = 0;
+
+    for ( i = 0; i < width; ++ i, bit = walk_toward_lsb ( bit, 1 ) )
+    {
+      bigint_modctx_sqrmod ( ctx, acc, acc, work );
+      w = ( w << 1 ) | bit->bit;
+    }
+    if ( w ) bigint_modctx_mulmod ( ctx, acc, acc, table + w*n, work );
+
+    bits -= width;
+    width = POW_WINDOW;
+  }
+
+  memcpy ( r, acc, n*sizeof*r );
+  STATS_END ( BIGINT_OP_POWMOD );
+}
+
+///
+/// Converts a BigInt to a residue, reducing it bit by bit from the top so
+/// that no division is needed.
+///
+/// @param ctx The context
+/// @param r The residue receiving a mod m
+/// @param a Any BigInt; negative values are brought into [0,m)
+/// @param scratch bigint_modctx_scratch_limbs() limbs
+///
+void bigint_modctx_in ( BigModCtx const * const ctx, uint32_t * const r, BigInt const * const a, uint32_t * const scratch )
+{
+  size_t const n = ctx->n;
+  uint32_t * const x = scratch + 2*n + 1;
+  Bit const * bit;
+  size_t i;
+
+  memset ( x, 0, n*sizeof*x );
+  for ( bit = a->msb; bit; bit = walk_toward_lsb ( bit, 1 ) )
+  {
+    limbs_shift_in ( x, ctx->m, n, bit->bit );
+  }
+
+  if ( !a->positive )
+  {
+    for ( i = 0; i < n && !x[i]; ++ i );
+    if ( i < n ) limbs_sub ( x, ctx->m, x, n );
+  }
+
+  if ( ctx->montgomery )
+  {
+    bigint_modctx_mulmod ( ctx, r, x, ctx->r2, scratch );
+  }
+  else
+  {
+    memcpy ( r, x, n*sizeof*r );
+  }
+}
+
+///
+/// Converts a residue back to a BigInt.
+///
+/// @param ctx The context
+/// @param a A residue
+/// @param scratch bigint_modctx_scratch_limbs() limbs
+///
+/// @return A new BigInt in [0,m). Must be freed with bigint_free().
+///
+BigInt * bigint_modctx_out ( BigModCtx const * const ctx, uint32_t const * const a, uint32_t * const scratch )
+{
+  MEMORY_GUARD ( NULL );
+
+  size_t const n = ctx->n;
+  uint32_t * const x = scratch + 2*n + 1;
+  BigInt * out;
+  size_t i;
+
+  if ( ctx->montgomery )
+  {
+    // a*R / R
+    memcpy ( scratch, a, n*sizeof*scratch );
+    memset ( scratch + n, 0, n*sizeof*scratch );
+    reduce ( ctx, x, scratch, NULL );
+  }
+  else
+  {
+    memcpy ( x, a, n*sizeof*x );
+  }
+
+  out = bigint_init_reserve ( 32*n );
+  for ( i = 0; i < 32*n; ++ i )
+  {
+    append_bit ( out, ( x[i/32] >> (i%32) ) & 1 );
+  }
+  _bigint_remove_high_zeroes ( out );
+
+  return out;
+}
+
+///
+/// One contiguous range of bigint_invmod_batch()'s values, with the limbs it
+/// works in.
+///
+typedef struct _tag_batch_job
+{
+  BigModCtx const * ctx;
+  BigInt const * const * values;
+  BigInt const * m;
+  BigInt ** out;
+  size_t start, end;
+  // the values as residues, and their running products from start
+  uint32_t * x, * prefix;
+  // the inverse of the range's product, or NULL if it has none
+  uint32_t * inverse;
+  uint32_t * scratch;
+  int failures;
+} BatchJob;
+
+///
+/// Converts a range of values to residues and forms their running products.
+///
+static void batch_prefix_run ( void * arg )
+{
+  BatchJob * const job = arg;
+  size_t const n = job->ctx->n;
+  size_t i;
+
+  for ( i = job->start; i < job->end; ++ i )
+  {
+    bigint_modctx_in ( job->ctx, job->x + i*n, job->values[i], job->scratch );
+    if ( i == job->start )
+    {
+      memcpy ( job->prefix + i*n, job->x + i*n, n*sizeof*job->x );
+    }
+    else
+    {
+      bigint_modctx_mulmod ( job->ctx, job->prefix + i*n, job->prefix + (i-1)*n, job->x + i*n, job->scratch );
+    }
+  }
+}
+
+///
+/// Peels the inverses of a range off the inverse of its product, from the
+/// top: 1/x_i = 1/(x_start..x_i) * (x_start..x_(i-1)), then multiplying by
+/// x_i leaves 1/(x_start..x_(i-1)). A range with no inverse is inverted value
+/// by value to find the culprits.
+///
+static void batch_invert_run ( void * arg )
+{
+  BatchJob * const job = arg;
+  size_t const n = job->ctx->n;
+  uint32_t * const y = job->scratch + bigint_modctx_scratch_limbs ( job->ctx );
+  size_t i;
+
+  if ( !job->inverse )
+  {
+    for ( i = job->start; i < job->end; ++ i )
+    {
+      job->out[i] = bigint_invmod ( job->values[i], job->m );
+      if ( !job->out[i] ) job->failures ++;
+    }
+    return;
+  }
+
+  for ( i = job->end - 1; i > job->start; -- i )
+  {
+    bigint_modctx_mulmod ( job->ctx, y, job->inverse, job->prefix + (i-1)*n, job->scratch );
+    job->out[i] = bigint_modctx_out ( job->ctx, y, job->scratch );
+    bigint_modctx_mulmod ( job->ctx, job->inverse, job->inverse, job->x + i*n, job->scratch );
+  }
+  job->out[job->start] = bigint_modctx_out ( job->ctx, job->inverse, job->scratch );
+}
+
+///
+/// Runs a phase of bigint_invmod_batch() over every range, on the thread pool
+/// when there is more than one.
+///
+static void batch_run ( void (*run) ( void * ), BatchJob * const jobs, BigIntTask * const tasks, size_t const k )
+{
+  size_t c;
+
+  for ( c = 1; c < k; ++ c )
+  {
+    tasks[c] = (BigIntTask){ run, jobs + c, 0 };
+    _bigint_task_spawn ( tasks + c );
+  }
+  run ( jobs );
+  for ( c = k; c-- > 1; ) _bigint_task_join ( tasks + c );
+}
+
+///
+/// Inverts a residue through bigint_invmod().
+///
+/// @return false if it has no inverse
+///
+static bool invert_residue ( BigModCtx const * const ctx, uint32_t * const r, uint32_t const * const a, BigInt const * const m, uint32_t * const scratch )
+{
+  BigInt * plain = bigint_modctx_out ( ctx, a, scratch );
+  BigInt * inverse = bigint_invmod ( plain, m );
+
+  bigint_free ( plain );
+  if ( !inverse ) return false;
+
+  bigint_modctx_in ( ctx, r, inverse, scratch );
+  bigint_free ( inverse );
+  return true;
+}
+
+///
+/// Inverts many values modulo one modulus by Montgomery's trick: the running
+/// products of the values are formed, their total is inverted once, and the
+/// inverses of the values are peeled off it with three multiplications
+/// each, all in a BigModCtx. Large batches are split into one range per pool
+/// thread; the ranges' products are themselves inverted together, so there
+/// is still a single inversion. If some value has no inverse, each range is
+/// inverted on its own and the ranges that fail are inverted value by value.
+///
+/// @param values The values to invert
+/// @param n The number of values
+/// @param m The modulus, which must be positive
+/// @param out An array of n pointers receiving the inverses in [0,m), each of
+/// which must be freed with bigint_free(), or NULL for a value that has no
+/// inverse
+///
+/// @return The number of values with no inverse, or -1 if memory ran out
+/// (see bigint_set_oom_mode()), in which case every out[] is NULL
+///
+int bigint_invmod_batch ( BigInt const * const * const values, size_t const n, BigInt const * const m, BigInt ** const out )
+{
+  MEMORY_GUARD_CATCH ( )
+  {
+    // the inverses already made have been freed
+    for ( size_t j = 0; j < n; ++ j ) out[j] = NULL;
+    return -1;
+  }
+
+  STATS_BEGIN ( (uint64_t)n * m->count );
+  BigModCtx * ctx;
+  size_t k, c, l, s, size;
+  uint32_t * limbs, * totals, * inverses;
+  BatchJob * jobs;
+  BigIntTask * tasks;
+  MemoryFrame frame;
+  int failures = 0;
+
+  if ( n == 0 ) return 0;
+
+  ctx = bigint_modctx_new ( m );
+  MEMORY_CATCH ( frame )
+  {
+    bigint_modctx_free ( ctx );
+    _bigint_memory_rethrow ( );
+  }
+
+  l = ctx->n;
+  // the scratch of each range is followed by one spare residue
+  s = bigint_modctx_scratch_limbs ( ctx ) + l;
+
+  k = _bigint_pool_size ( ) > 1 ? n / BATCH_RANGE : 1;
+  if ( k > (size_t)_bigint_pool_size ( ) ) k = _bigint_pool_size ( );
+  if ( k == 0 ) k = 1;
+
+  size = ( 2*n + 3*k )*l + k*s;
+  limbs = _bigint_alloc ( size*sizeof*limbs );
+  totals = limbs + 2*n*l;
+  inverses = totals + k*l;
+  jobs = _bigint_alloc ( k*sizeof*jobs );
+  tasks = _bigint_alloc ( k*sizeof*tasks );
+
+  for ( c = 0; c < k; ++ c )
+  {
+    jobs[c].ctx = ctx;
+    jobs[c].values = values;
+    jobs[c].m = m;
+    jobs[c].out = out;
+    jobs[c].start = n*c/k;
+    jobs[c].end = n*(c+1)/k;
+    jobs[c].x = limbs;
+    jobs[c].prefix = limbs + n*l;
+    jobs[c].inverse = inverses + c*l;
+    jobs[c].scratch = inverses + k*l + c*s;
+    jobs[c].failures = 0;
+  }
+
+  batch_run ( batch_prefix_run, jobs, tasks, k );
+
+  // the same trick once more over the ranges' products
+  for ( c = 0; c < k; ++ c )
+  {
+    uint32_t const * total = jobs[c].prefix + ( jobs[c].end - 1 )*l;
+
+    if ( c == 0 )
+    {
+      memcpy ( totals, total, l*sizeof*totals );
+    }
+    else
+    {
+      bigint_modctx_mulmod ( ctx, totals + c*l, totals + (c-1)*l, total, jobs[0].scratch );
+    }
+  }
+
+  if ( invert_residue ( ctx, inverses + (k-1)*l, totals + (k-1)*l, m, jobs[0].scratch ) )
+  {
+    for ( c = k - 1; c > 0; -- c )
+    {
+      uint32_t * const y = jobs[0].scratch + s - l;
+
+      bigint_modctx_mulmod ( ctx, y, inverses + c*l, totals + (c-1)*l, jobs[0].scratch );
+      bigint_modctx_mulmod ( ctx, inverses + (c-1)*l, inverses + c*l, jobs[c].prefix + ( jobs[c].end - 1 )*l, jobs[0].scratch );
+      memcpy ( inverses + c*l, y, l*sizeof*y );
+    }
+  }
+  else
+  {
+    for ( c = 0; c < k; ++ c )
+    {
+      uint32_t const * total = jobs[c].prefix + ( jobs[c].end - 1 )*l;
+
+      if ( !invert_residue ( ctx, jobs[c].inverse, total, m, jobs[0].scratch ) ) jobs[c].inverse = NULL;
+    }
+  }
+
+  batch_run ( batch_invert_run, jobs, tasks, k );
+
+  for ( c = 0; c < k; ++ c ) failures += jobs[c].failures;
+
+  _bigint_free ( tasks, k*sizeof*tasks );
+  _bigint_free ( jobs, k*sizeof*jobs );
+  _bigint_free ( limbs, size*sizeof*limbs );
+  _bigint_memory_pop ( &frame );
+  bigint_modctx_free ( ctx );
+
+  STATS_END ( BIGINT_OP_INVMOD_BATCH );
+  return failures;
+}
+
+///
+/// Reads bits [pos,pos+width) of an exponent held as el limbs; width is at
+/// most 16.
+///
+static uint32_t exponent_digit ( uint32_t const * const e, size_t const el, size_t const pos, int const width )
+{
+  size_t const i = pos / 32;
+  uint64_t v;
+
+  if ( i >= el ) return 0;
+  v = e[i] | ( i + 1 < el ? (uint64_t)e[i+1] << 32 : 0 );
+
+  return (uint32_t)( v >> ( pos % 32 ) ) & ( ( 1u << width ) - 1 );
+}
+
+///
+/// Multiplies a residue into an accumulator that may still be empty (one).
+///
+static void accumulate ( BigModCtx const * const ctx, uint32_t * const acc, bool * const set, uint32_t const * const a, uint32_t * const scratch )
+{
+  if ( *set )
+  {
+    bigint_modctx_mulmod ( ctx, acc, acc, a, scratch );
+  }
+  else
+  {
+    memcpy ( acc, a, ctx->n*sizeof*acc );
+    *set = true;
+  }
+}
+
+///
+/// Computes the product of powers of many bases modulo one modulus, sharing
+/// the squarings between all of them in a BigModCtx.
+///
+/// Each window of exponent bits, from the top, squares the accumulator
+/// width times and then multiplies in what the bases contribute to the
+/// window. Straus's method tabulates g^1..g^(2^width-1) for each base and
+/// multiplies in one entry per base. Pippenger's drops each base into the
+/// bucket for its digit, then weighs the buckets by running products, at a
+/// cost of 2^(width+1) multiplications per window however many bases there
+/// are. Whichever needs fewer multiplications for the given count and
+/// exponent length is used, with Pippenger's width chosen the same way.
+///
+/// @param bases The bases
+/// @param exps The exponents, one per base; their signs are ignored
+/// @param n The number of bases
+/// @param m The modulus, which must be positive
+///
+/// @return A new BigInt in [0,m) equal to the product of bases[i]^|exps[i]|
+/// mod m. Must be freed with bigint_free().
+///
+BigInt * bigint_multi_powmod ( BigInt const * const * const bases, BigInt const * const * const exps, size_t const n, BigInt const * const m )
+{
+  MEMORY_GUARD ( NULL );
+
+  STATS_BEGIN ( (uint64_t)n * m->count );
+  BigModCtx * ctx = bigint_modctx_new ( m );
+  MemoryFrame frame;
+  size_t bits = 0, el, l, windows, size, i, c;
+  uint64_t straus, pippenger = UINT64_MAX;
+  uint32_t * limbs, * acc, * scratch, * e, * table;
+  bool * filled = NULL, set = false;
+  int width = 1, w, k;
+  BigInt * out;
+
+  if ( !ctx ) return NULL;
+
+  MEMORY_CATCH ( frame )
+  {
+    bigint_modctx_free ( ctx );
+    _bigint_memory_rethrow ( );
+  }
+
+  for ( i = 0; i < n; ++ i )
+  {
+    size_t b = _bigint_significant_bits ( exps[i] );
+    if ( b > bits ) bits = b;
+  }
+  el = bits / 32 + 1;
+  l = ctx->n;
+
+  // multiplications each method needs, besides the shared squarings
+  straus = (uint64_t)n * ( ( 1 << POW_WINDOW ) - 2 ) + (uint64_t)n * ( ( bits + POW_WINDOW - 1 ) / POW_WINDOW );
+  for ( w = 1; w <= 16; ++ w )
+  {
+    uint64_t cost = ( ( bits + w - 1 ) / w ) * ( (uint64_t)n + ( 2u << w ) );
+    if ( cost < pippenger )
+    {
+      pippenger = cost;
+      width = w;
+    }
+  }
+  if ( straus <= pippenger ) width = POW_WINDOW;
+
+  // the accumulator, scratch, the exponents, and a table per base or a
+  // residue per base and a bucket per digit
+  size = l + bigint_modctx_scratch_limbs ( ctx ) + n*el
+       + ( straus <= pippenger ? ( n << POW_WINDOW )*l : n*l + ( ( (size_t)1 << width ) + 2 )*l );
+  limbs = _bigint_alloc ( size*sizeof*limbs );
+  acc = limbs;
+  scratch = acc + l;
+  e = scratch + bigint_modctx_scratch_limbs ( ctx );
+  table = e + n*el;
+
+  for ( i = 0; i < n; ++ i ) limbs_from_bigint ( e + i*el, el, exps[i] );
+
+  if ( straus <= pippenger )
+  {
+    for ( i = 0; i < n; ++ i )
+    {
+      uint32_t * const t = table + ( i << POW_WINDOW )*l;
+
+      bigint_modctx_in ( ctx, t + l, bases[i], scratch );
+      for ( k = 2; k < ( 1 << POW_WINDOW ); ++ k )
+      {
+        bigint_modctx_mulmod ( ctx, t + k*l, t + (k-1)*l, t + l, scratch );
+      }
+    }
+  }
+  else
+  {
+    for ( i = 0; i < n; ++ i ) bigint_modctx_in ( ctx, table + i*l, bases[i], scratch );
+    filled = _bigint_alloc ( ( (size_t)1 << width )*sizeof*filled );
+  }
+
+  for ( windows = ( bits + width - 1 ) / width; windows-- > 0; )
+  {
+    size_t const pos = windows*width;
+
+    if ( set )
+    {
+      for ( k = 0; k < width; ++ k ) bigint_modctx_sqrmod ( ctx, acc, acc, scratch );
+    }
+
+    if ( straus <= pippenger )
+    {
+      for ( i = 0; i < n; ++ i )
+      {
+        uint32_t d = exponent_digit ( e + i*el, el, pos, width );
+        if ( d ) accumulate ( ctx, acc, &set, table + ( ( i << POW_WINDOW ) + d )*l, scratch );
+      }
+    }
+    else
+    {
+      uint32_t * const buckets = table + n*l, * const running = buckets + ( (size_t)1 << width )*l;
+      uint32_t * const total = running + l;
+      bool running_set = false, total_set = false;
+
+      memset ( filled, 0, ( (size_t)1 << width )*sizeof*filled );
+      for ( i = 0; i < n; ++ i )
+      {
+        uint32_t d = exponent_digit ( e + i*el, el, pos, width );
+        if ( d ) accumulate ( ctx, buckets + d*l, filled + d, table + i*l, scratch );
+      }
+
+      // sum over d of d*bucket[d], as the product of the running products
+      // of the buckets from the top
+      for ( c = ( (size_t)1 << width ) - 1; c > 0; -- c )
+      {
+        if ( filled[c] ) accumulate ( ctx, running, &running_set, buckets + c*l, scratch );
+        if ( running_set ) accumulate ( ctx, total, &total_set, running, scratch );
+      }
+      if ( total_set ) accumulate ( ctx, acc, &set, total, scratch );
+    }
+  }
+
+  if ( !set ) memcpy ( acc, ctx->one, l*sizeof*acc );
+  out = bigint_modctx_out ( ctx, acc, scratch );
+
+  if ( filled ) _bigint_free ( filled, ( (size_t)1 << width )*sizeof*filled );
+  _bigint_free ( limbs, size*sizeof*limbs );
+  _bigint_memory_pop ( &frame );
+  bigint_modctx_free ( ctx );
+
+  STATS_END ( BIGINT_OP_MULTI_POWMOD );
+  return out;
+}
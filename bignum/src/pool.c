@@ -0,0 +1,378 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "pool.h"
+#include "memory.h"
+
+///
+/// One double-ended queue of tasks. The owning thread pushes and pops at the
+/// bottom; idle threads steal from the top.
+///
+typedef struct _tag_task_deque
+{
+  pthread_mutex_t lock;
+  BigIntTask ** items;
+  int top, bottom, capacity;
+} TaskDeque;
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+
+// requested total number of threads (including callers); 0 means "ask the OS"
+static int pool_requested = 0;
+// number of background workers actually started
+static int pool_workers = 0;
+// queued-but-unclaimed task count, used to let idle workers sleep
+static int pool_pending = 0;
+
+// deques[0..pool_workers-1] belong to workers; deques[pool_workers] is
+// shared by every thread that is not a pool worker
+static TaskDeque * deques = NULL;
+
+static __thread int self = -1;
+
+// tasks this thread has queued and not yet joined, newest first
+static __thread BigIntTask * unjoined = NULL;
+
+///
+/// Pushes a task at the bottom of a deque, growing it if needed.
+///
+/// @return false if the deque was full and could not grow
+///
+static bool deque_push ( TaskDeque * const d, BigIntTask * const t )
+{
+  pthread_mutex_lock ( &d->lock );
+
+  if ( d->bottom == d->capacity )
+  {
+    int live = d->bottom - d->top, i;
+
+    if ( live * 2 > d->capacity )
+    {
+      BigIntTask ** items = _bigint_try_realloc ( d->items, (sizeof*items)*d->capacity, (sizeof*items)*(d->capacity*2) );
+      if ( !items )
+      {
+        pthread_mutex_unlock ( &d->lock );
+        return false;
+      }
+      d->items = items;
+      d->capacity *= 2;
+    }
+
+    for ( i = 0; i < live; ++ i )
+    {
+      d->items[i] = d->items[d->top+i];
+    }
+    d->top = 0;
+    d->bottom = live;
+  }
+
+  d->items[d->bottom++] = t;
+
+  pthread_mutex_unlock ( &d->lock );
+
+  return true;
+}
+
+///
+/// Pops the most recently pushed task from a deque.
+///
+/// @return The task, or NULL if the deque was empty.
+///
+static BigIntTask * deque_pop ( TaskDeque * const d )
+{
+  BigIntTask * t = NULL;
+
+  pthread_mutex_lock ( &d->lock );
+  if ( d->bottom > d->top )
+  {
+    t = d->items[--d->bottom];
+  }
+  pthread_mutex_unlock ( &d->lock );
+
+  return t;
+}
+
+///
+/// Steals the oldest task from a deque.
+///
+/// @return The task, or NULL if the deque was empty.
+///
+static BigIntTask * deque_steal ( TaskDeque * const d )
+{
+  BigIntTask * t = NULL;
+
+  pthread_mutex_lock ( &d->lock );
+  if ( d->bottom > d->top )
+  {
+    t = d->items[d->top++];
+  }
+  pthread_mutex_unlock ( &d->lock );
+
+  return t;
+}
+
+///
+/// Finds something for the calling thread to do: first its own newest task,
+/// then the oldest task of any other thread.
+///
+/// @return A claimed task, or NULL if there is no queued work.
+///
+static BigIntTask * find_task ( void )
+{
+  int own = self >= 0 ? self : pool_workers;
+  int i;
+  BigIntTask * t = deque_pop ( &deques[own] );
+
+  for ( i = 1; !t && i <= pool_workers; ++ i )
+  {
+    t = deque_steal ( &deques[(own+i)%(pool_workers+1)] );
+  }
+
+  if ( t ) __atomic_sub_fetch ( &pool_pending, 1, __ATOMIC_ACQ_REL );
+
+  return t;
+}
+
+///
+/// Runs a claimed task, unless it has been cancelled, and publishes its
+/// completion.
+///
+static void run_task ( BigIntTask * const t )
+{
+  if ( __atomic_load_n ( &t->cancelled, __ATOMIC_ACQUIRE ) || !_bigint_memory_run ( t->journal, t->run, t->arg ) )
+  {
+    t->failed = 1;
+  }
+
+  __atomic_store_n ( &t->done, 1, __ATOMIC_RELEASE );
+}
+
+///
+/// Body of each background worker: run whatever can be found, sleep when there
+/// is nothing queued anywhere.
+///
+static void * worker_main ( void * arg )
+{
+  self = (int)(long)arg;
+
+  for ( ;; )
+  {
+    BigIntTask * t = find_task ( );
+
+    if ( t )
+    {
+      run_task ( t );
+    }
+    else
+    {
+      pthread_mutex_lock ( &pool_lock );
+      while ( 0 == __atomic_load_n ( &pool_pending, __ATOMIC_ACQUIRE ) )
+      {
+        pthread_cond_wait ( &pool_wake, &pool_lock );
+      }
+      pthread_mutex_unlock ( &pool_lock );
+    }
+  }
+
+  return NULL;
+}
+
+///
+/// Starts the background workers. The thread count comes from
+/// _bigint_pool_set_size(), else the BIGNUM_THREADS environment variable,
+/// else the number of online processors.
+///
+static void pool_start ( void )
+{
+  int threads = pool_requested, i;
+
+  if ( threads <= 0 )
+  {
+    char const * env = getenv ( "BIGNUM_THREADS" );
+    threads = env ? atoi ( env ) : 0;
+  }
+
+  if ( threads <= 0 )
+  {
+    long n = sysconf ( _SC_NPROCESSORS_ONLN );
+    threads = n > 0 ? (int)n : 1;
+  }
+
+  // the calling threads do work too while they wait on a join
+  pool_workers = threads - 1;
+
+  deques = _bigint_try_alloc ( (sizeof*deques)*(pool_workers+1) );
+
+  for ( i = 0; deques && i <= pool_workers; ++ i )
+  {
+    pthread_mutex_init ( &deques[i].lock, NULL );
+    deques[i].top = deques[i].bottom = 0;
+    deques[i].capacity = 16;
+    deques[i].items = _bigint_try_alloc ( (sizeof*deques[i].items)*deques[i].capacity );
+
+    if ( !deques[i].items )
+    {
+      // without memory for every deque, run single-threaded; the ones
+      // already made stay allocated, as the pool lives as long as the process
+      pool_workers = 0;
+      return;
+    }
+  }
+
+  if ( !deques )
+  {
+    pool_workers = 0;
+    return;
+  }
+
+  for ( i = 0; i < pool_workers; ++ i )
+  {
+    pthread_t thread;
+    if ( 0 != pthread_create ( &thread, NULL, worker_main, (void*)(long)i ) )
+    {
+      // run with however many workers we managed to start
+      pool_workers = i;
+      break;
+    }
+    pthread_detach ( thread );
+  }
+}
+
+///
+/// Reports the number of threads that participate in parallel operations,
+/// starting the pool if necessary.
+///
+/// @return The number of threads, counting the caller.
+///
+int _bigint_pool_size ( void )
+{
+  pthread_once ( &pool_once, pool_start );
+  return pool_workers + 1;
+}
+
+///
+/// Requests a thread count for the pool. This only has an effect before the
+/// first parallel operation starts the pool.
+///
+/// @param threads The total number of threads to use, counting the caller; 0
+/// to use the BIGNUM_THREADS environment variable or the processor count.
+///
+/// @return The number of threads the pool will use (or is already using).
+///
+int _bigint_pool_set_size ( int threads )
+{
+  pool_requested = threads;
+  return _bigint_pool_size ( );
+}
+
+///
+/// Queues a task for execution by the pool. With a single-threaded pool the
+/// task runs immediately on the calling thread.
+///
+/// @param t The task to run. It must stay valid until _bigint_task_join()
+/// returns for it.
+///
+void _bigint_task_spawn ( BigIntTask * const t )
+{
+  t->done = 0;
+  t->failed = 0;
+  t->cancelled = 0;
+  t->journal = _bigint_memory_journal ( );
+
+  if ( _bigint_pool_size ( ) == 1 || !deque_push ( &deques[self >= 0 ? self : pool_workers], t ) )
+  {
+    run_task ( t );
+    return;
+  }
+
+  t->spawned = unjoined;
+  unjoined = t;
+
+  __atomic_add_fetch ( &pool_pending, 1, __ATOMIC_ACQ_REL );
+
+  pthread_mutex_lock ( &pool_lock );
+  pthread_cond_signal ( &pool_wake );
+  pthread_mutex_unlock ( &pool_lock );
+}
+
+///
+/// Runs queued tasks until the given one is done.
+///
+static void task_wait ( BigIntTask * const t )
+{
+  while ( !__atomic_load_n ( &t->done, __ATOMIC_ACQUIRE ) )
+  {
+    BigIntTask * other = find_task ( );
+
+    if ( other )
+    {
+      run_task ( other );
+    }
+    else
+    {
+      sched_yield ( );
+    }
+  }
+}
+
+///
+/// Waits for a spawned task to finish. Rather than blocking, the caller keeps
+/// running queued tasks (usually the one it is waiting for) so nested
+/// fork/join recursion cannot starve the pool.
+///
+/// If the task ran out of memory, the failure passes on to the caller (see
+/// memory.h).
+///
+/// @param t The task to wait for.
+///
+void _bigint_task_join ( BigIntTask * const t )
+{
+  BigIntTask ** link;
+
+  task_wait ( t );
+
+  for ( link = &unjoined; *link; link = &(*link)->spawned )
+  {
+    if ( *link == t )
+    {
+      *link = t->spawned;
+      break;
+    }
+  }
+
+  if ( t->failed ) _bigint_memory_rethrow ( );
+}
+
+///
+/// @return The calling thread's newest unjoined task, to pass to
+/// _bigint_pool_unwind() later
+///
+BigIntTask * _bigint_pool_unjoined ( void )
+{
+  return unjoined;
+}
+
+///
+/// Cancels the calling thread's tasks queued since _bigint_pool_unjoined()
+/// returned mark, and waits until none of them is running.
+///
+void _bigint_pool_unwind ( BigIntTask * const mark )
+{
+  BigIntTask * t;
+
+  for ( t = unjoined; t != mark; t = t->spawned )
+  {
+    __atomic_store_n ( &t->cancelled, 1, __ATOMIC_RELEASE );
+  }
+
+  for ( ; unjoined != mark; unjoined = unjoined->spawned )
+  {
+    task_wait ( unjoined );
+  }
+}
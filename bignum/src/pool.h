@@ -0,0 +1,32 @@
+#ifndef _BIGNUM_POOL_H
+#define _BIGNUM_POOL_H
+
+/**
+  * A small work-stealing thread pool used to run independent sub-operations
+  * (such as the sub-products of a Karatsuba multiplication) concurrently.
+  * This is private to the library.
+  **/
+
+struct _tag_memory_journal;
+
+typedef struct _tag_bigint_task
+{
+  void (*run) ( void * );
+  void * arg;
+  int done;
+  // set if the task ran out of memory, or was cancelled before it ran
+  int failed, cancelled;
+  // the journal of the call that spawned it (see memory.h)
+  struct _tag_memory_journal * journal;
+  // the spawning thread's next older unjoined task
+  struct _tag_bigint_task * spawned;
+} BigIntTask;
+
+void _bigint_task_spawn ( BigIntTask * const );
+void _bigint_task_join ( BigIntTask * const );
+int _bigint_pool_size ( void );
+int _bigint_pool_set_size ( int );
+BigIntTask * _bigint_pool_unjoined ( void );
+void _bigint_pool_unwind ( BigIntTask * );
+
+#endif // _BIGNUM_POOL_H
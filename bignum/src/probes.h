@@ -0,0 +1,52 @@
+#ifndef _BIGNUM_PROBES_H
+#define _BIGNUM_PROBES_H
+
+/**
+  * USDT probes for tracers such as bpftrace and perf. They are compiled in
+  * when configure finds sys/sdt.h, which defines BIGNUM_PROBES. Every probe
+  * has a semaphore that the tracer raises while it is attached, so a probe
+  * nobody is listening to costs one load and a branch, and the elapsed time
+  * is only measured for tracers. This is private to the library.
+  *
+  *   bignum:multiply    (a bits, b bits, algorithm, ns)
+  *   bignum:divide      (dividend bits, divisor bits, algorithm, ns)
+  *   bignum:tostring    (bits, base, algorithm, ns)
+  *   bignum:fromstring  (bits, base, algorithm, ns)
+  *   bignum:alloc       (bytes), for allocations of BIGINT_PROBE_ALLOC_BYTES
+  *                      or more
+  *
+  * Algorithms are C-strings, e.g. str(arg2) in bpftrace.
+  **/
+
+#include "stats.h"
+
+#define BIGINT_PROBE_ALLOC_BYTES 4096
+
+#ifdef BIGNUM_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern unsigned short bignum_multiply_semaphore;
+extern unsigned short bignum_divide_semaphore;
+extern unsigned short bignum_tostring_semaphore;
+extern unsigned short bignum_fromstring_semaphore;
+extern unsigned short bignum_alloc_semaphore;
+
+#define PROBE_ENABLED(name) __builtin_expect ( bignum_##name##_semaphore != 0, 0 )
+
+// PROBE_BEGIN() notes the start time if a tracer is attached; PROBE_END()
+// fires with three arguments and the time elapsed since PROBE_BEGIN()
+#define PROBE_BEGIN(name) uint64_t const probe_start = PROBE_ENABLED ( name ) ? _bigint_stats_now ( ) : 0
+#define PROBE_END(name, a, b, c) do { if ( PROBE_ENABLED ( name ) ) STAP_PROBE4 ( bignum, name, a, b, c, _bigint_stats_now ( ) - probe_start ); } while ( 0 )
+#define PROBE1(name, a) do { if ( PROBE_ENABLED ( name ) ) STAP_PROBE1 ( bignum, name, a ); } while ( 0 )
+
+#else
+
+#define PROBE_BEGIN(name) ((void)0)
+#define PROBE_END(name, a, b, c) ((void)0)
+#define PROBE1(name, a) ((void)0)
+
+#endif
+
+#endif // _BIGNUM_PROBES_H
@@ -0,0 +1,169 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "bignum.h"
+#include "memory.h"
+#include "byteorder.h"
+
+/**
+  * Binary format, all integers little-endian:
+  *
+  *   offset  size  field
+  *   0       4     magic "BNUM"
+  *   4       1     format version (BIGINT_FORMAT_VERSION)
+  *   5       1     flags: BIGINT_FORMAT_NEGATIVE, BIGINT_EXPORT_CHECKSUM
+  *   6       2     reserved, zero
+  *   8       8     number of 64-bit limbs, n
+  *   16      8n    limbs, least significant first
+  *   16+8n   4     CRC-32 of every preceding byte, if BIGINT_EXPORT_CHECKSUM
+  **/
+
+static unsigned char const magic[4] = { 'B', 'N', 'U', 'M' };
+
+///
+/// Computes the size of a BigInt's binary serialization.
+///
+/// @param bi The BigInt to serialize
+/// @param flags BIGINT_EXPORT_CHECKSUM to include a checksum, otherwise 0
+///
+/// @return The number of bytes bigint_export_into() will write
+///
+size_t bigint_export_size ( BigInt const * const bi, int const flags )
+{
+  size_t limbs = ( (size_t)_bigint_significant_bits ( bi ) + 63 ) / 64;
+
+  return BIGINT_FORMAT_HEADER + 8*limbs
+       + ( ( flags & BIGINT_EXPORT_CHECKSUM ) ? 4 : 0 );
+}
+
+///
+/// Writes a BigInt's binary serialization into a caller-provided buffer.
+///
+/// @param bi The BigInt to serialize
+/// @param flags BIGINT_EXPORT_CHECKSUM to append a checksum, otherwise 0
+/// @param buf The buffer to write to
+/// @param len The size of the buffer
+///
+/// @return The number of bytes written, or 0 if the buffer is smaller than
+/// bigint_export_size()
+///
+size_t bigint_export_into ( BigInt const * const bi, int const flags, unsigned char * const buf, size_t const len )
+{
+  size_t size = bigint_export_size ( bi, flags ), i;
+  int bits = _bigint_significant_bits ( bi );
+  size_t limbs = ( (size_t)bits + 63 ) / 64;
+  unsigned char * limb = buf + BIGINT_FORMAT_HEADER;
+  Bit const * bit;
+
+  if ( len < size ) return 0;
+
+  memcpy ( buf, magic, sizeof magic );
+  buf[4] = BIGINT_FORMAT_VERSION;
+  buf[5] = ( flags & BIGINT_EXPORT_CHECKSUM )
+         | ( ( bi->positive || bits == 0 ) ? 0 : BIGINT_FORMAT_NEGATIVE );
+  buf[6] = buf[7] = 0;
+  put_le ( buf + 8, limbs, 8 );
+
+  memset ( limb, 0, 8*limbs );
+  for ( i = 0, bit = bi->lsb; (int)i < bits; ++ i, bit = walk_toward_msb ( bit, 1 ) )
+  {
+    limb[i/8] |= (unsigned char)( bit->bit << (i%8) );
+  }
+
+  if ( flags & BIGINT_EXPORT_CHECKSUM )
+  {
+    put_le ( buf + size - 4, _bigint_crc32 ( buf, size - 4 ), 4 );
+  }
+
+  return size;
+}
+
+///
+/// Serializes a BigInt into a newly allocated buffer. See the format described
+/// at the top of serialize.c.
+///
+/// @param bi The BigInt to serialize
+/// @param flags BIGINT_EXPORT_CHECKSUM to append a checksum, otherwise 0
+/// @param len The address receiving the size of the serialization
+///
+/// @return A pointer to the serialization. Must be released with
+/// bigint_free_buffer().
+///
+unsigned char * bigint_export ( BigInt const * const bi, int const flags, size_t * const len )
+{
+  MEMORY_GUARD ( NULL );
+
+  size_t size = bigint_export_size ( bi, flags );
+  unsigned char * buf = _bigint_alloc ( size );
+
+  *len = bigint_export_into ( bi, flags, buf, size );
+
+  return buf;
+}
+
+///
+/// Checks a binary serialization's header and checksum.
+///
+/// @param buf The serialization
+/// @param len The number of bytes available
+///
+/// @return The length of the serialization, or 0 if it is malformed,
+/// truncated, of an unknown version, or fails its checksum
+///
+size_t bigint_import_check ( unsigned char const * const buf, size_t const len )
+{
+  uint64_t limbs;
+  size_t size;
+
+  if ( len < BIGINT_FORMAT_HEADER ) return 0;
+  if ( memcmp ( buf, magic, sizeof magic ) != 0 ) return 0;
+  if ( buf[4] != BIGINT_FORMAT_VERSION ) return 0;
+  if ( buf[5] & ~( BIGINT_EXPORT_CHECKSUM | BIGINT_FORMAT_NEGATIVE ) ) return 0;
+
+  limbs = get_le ( buf + 8, 8 );
+  if ( limbs > ( len - BIGINT_FORMAT_HEADER ) / 8 ) return 0;
+
+  size = BIGINT_FORMAT_HEADER + 8*(size_t)limbs;
+
+  if ( buf[5] & BIGINT_EXPORT_CHECKSUM )
+  {
+    if ( len - size < 4 ) return 0;
+    if ( get_le ( buf + size, 4 ) != _bigint_crc32 ( buf, size ) ) return 0;
+    size += 4;
+  }
+
+  return size;
+}
+
+///
+/// Creates a BigInt from its binary serialization. The limbs are read
+/// directly; no base conversion takes place.
+///
+/// @param buf The serialization, as written by bigint_export()
+/// @param len The number of bytes available
+///
+/// @return A new BigInt, or NULL if the serialization is malformed (see
+/// bigint_import_check()). Must be freed with bigint_free().
+///
+BigInt * bigint_import ( unsigned char const * const buf, size_t const len )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigInt * bi;
+  size_t bits, i;
+
+  if ( bigint_import_check ( buf, len ) == 0 ) return NULL;
+
+  bits = 64*(size_t)get_le ( buf + 8, 8 );
+
+  bi = bigint_init_reserve ( bits );
+  for ( i = 0; i < bits; ++ i )
+  {
+    append_bit ( bi, ( buf[BIGINT_FORMAT_HEADER + i/8] >> (i%8) ) & 1 );
+  }
+
+  _bigint_remove_high_zeroes ( bi );
+  bi->positive = !( buf[5] & BIGINT_FORMAT_NEGATIVE ) || bi->count == 0;
+
+  return bi;
+}
@@ -0,0 +1,318 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "bignum.h"
+#include "stats.h"
+#include "memory.h"
+
+/**
+  * Operation counters, compiled in with --enable-stats. Each thread counts
+  * into a block of its own, so recording never contends; a snapshot sums
+  * the blocks of every live thread with those left behind by threads that
+  * have exited. Live and peak bytes are process-wide, since bits allocated
+  * on one thread may be freed on another.
+  **/
+
+static char const * const op_names[BIGINT_OP_COUNT] =
+{
+  "copy", "add", "subtract", "shift", "multiply", "addmul", "divide",
+  "modulo", "factorial", "product_list", "mulmod", "invmod", "mod_many",
+  "crt", "tostring", "fromstring", "powmod", "pow", "divexact", "invmod_batch",
+  "multi_powmod"
+};
+
+///
+/// @return A monotonic clock reading in nanoseconds
+///
+uint64_t _bigint_stats_now ( void )
+{
+  struct timespec ts;
+
+  clock_gettime ( CLOCK_MONOTONIC, &ts );
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#ifdef BIGNUM_STATS
+
+typedef struct _tag_thread_stats
+{
+  // written only by the owning thread, with relaxed atomics so that
+  // snapshots may read them concurrently
+  BigIntStats counts;
+  struct _tag_thread_stats * next, ** pprev;
+} ThreadStats;
+
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t stats_key;
+
+static ThreadStats * threads = NULL;
+static BigIntStats retired;
+static uint64_t live_bytes = 0, peak_bytes = 0;
+
+static __thread ThreadStats * mine = NULL;
+
+#define BUMP(field, v) __atomic_fetch_add ( &(field), (v), __ATOMIC_RELAXED )
+
+///
+/// Adds one set of counters into another.
+///
+static void stats_add ( BigIntStats * const total, BigIntStats const * const s )
+{
+  int op, k;
+
+  for ( op = 0; op < BIGINT_OP_COUNT; ++ op )
+  {
+    total->ops[op].calls += __atomic_load_n ( &s->ops[op].calls, __ATOMIC_RELAXED );
+    total->ops[op].bits += __atomic_load_n ( &s->ops[op].bits, __ATOMIC_RELAXED );
+    total->ops[op].ns += __atomic_load_n ( &s->ops[op].ns, __ATOMIC_RELAXED );
+
+    for ( k = 0; k < BIGINT_STATS_BUCKETS; ++ k )
+    {
+      total->ops[op].histogram[k] += __atomic_load_n ( &s->ops[op].histogram[k], __ATOMIC_RELAXED );
+    }
+  }
+
+  total->bit_allocs += __atomic_load_n ( &s->bit_allocs, __ATOMIC_RELAXED );
+  total->bit_frees += __atomic_load_n ( &s->bit_frees, __ATOMIC_RELAXED );
+}
+
+///
+/// Folds an exiting thread's counters into the retired totals.
+///
+static void thread_exit ( void * const arg )
+{
+  ThreadStats * t = arg;
+
+  pthread_mutex_lock ( &stats_lock );
+  stats_add ( &retired, &t->counts );
+  *t->pprev = t->next;
+  if ( t->next ) t->next->pprev = t->pprev;
+  pthread_mutex_unlock ( &stats_lock );
+
+  free ( t );
+}
+
+static void stats_start ( void )
+{
+  pthread_key_create ( &stats_key, thread_exit );
+}
+
+///
+/// @return The calling thread's counters, registering them on first use; NULL
+/// if there is no memory for them, in which case nothing is counted
+///
+static BigIntStats * thread_stats ( void )
+{
+  if ( !mine )
+  {
+    // counters are diagnostics, kept outside the memory functions and the
+    // limit so that enabling them changes nothing else
+    ThreadStats * t = calloc ( 1, sizeof*t );
+    if ( !t ) return NULL;
+
+    pthread_once ( &stats_once, stats_start );
+
+    pthread_mutex_lock ( &stats_lock );
+    t->next = threads;
+    t->pprev = &threads;
+    if ( threads ) threads->pprev = &t->next;
+    threads = t;
+    pthread_mutex_unlock ( &stats_lock );
+
+    pthread_setspecific ( stats_key, t );
+    mine = t;
+  }
+
+  return &mine->counts;
+}
+
+///
+/// Records one call of an operation that started at the given time.
+///
+void _bigint_stats_record ( int const op, uint64_t const bits, uint64_t const start )
+{
+  BigIntStats * stats = thread_stats ( );
+  BigIntOpStats * s;
+  uint64_t ns = _bigint_stats_now ( ) - start;
+  int bucket = ns ? 63 - __builtin_clzll ( ns ) : 0;
+
+  if ( !stats ) return;
+  s = &stats->ops[op];
+
+  if ( bucket >= BIGINT_STATS_BUCKETS ) bucket = BIGINT_STATS_BUCKETS - 1;
+
+  BUMP ( s->calls, 1 );
+  BUMP ( s->bits, bits );
+  BUMP ( s->ns, ns );
+  BUMP ( s->histogram[bucket], 1 );
+}
+
+void _bigint_stats_alloc ( size_t const size )
+{
+  uint64_t live = __atomic_add_fetch ( &live_bytes, size, __ATOMIC_RELAXED );
+  uint64_t peak = __atomic_load_n ( &peak_bytes, __ATOMIC_RELAXED );
+  BigIntStats * stats = thread_stats ( );
+
+  if ( stats ) BUMP ( stats->bit_allocs, 1 );
+
+  while ( live > peak && !__atomic_compare_exchange_n ( &peak_bytes, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+}
+
+void _bigint_stats_free ( size_t const size )
+{
+  BigIntStats * stats = thread_stats ( );
+
+  __atomic_sub_fetch ( &live_bytes, size, __ATOMIC_RELAXED );
+  if ( stats ) BUMP ( stats->bit_frees, 1 );
+}
+
+#endif
+
+///
+/// @return true if the library was configured with --enable-stats; if not,
+/// snapshots are always zero
+///
+bool bigint_stats_enabled ( void )
+{
+#ifdef BIGNUM_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+///
+/// Sums the counters of every thread. Calls still running on other threads
+/// are not included until they return.
+///
+/// @param out Receives the totals
+///
+void bigint_stats_snapshot ( BigIntStats * const out )
+{
+  memset ( out, 0, sizeof*out );
+
+#ifdef BIGNUM_STATS
+  ThreadStats const * t;
+
+  pthread_mutex_lock ( &stats_lock );
+  stats_add ( out, &retired );
+  for ( t = threads; t; t = t->next ) stats_add ( out, &t->counts );
+  pthread_mutex_unlock ( &stats_lock );
+
+  out->live_bytes = __atomic_load_n ( &live_bytes, __ATOMIC_RELAXED );
+  out->peak_live_bytes = __atomic_load_n ( &peak_bytes, __ATOMIC_RELAXED );
+#endif
+}
+
+///
+/// Zeroes every counter. The peak restarts from the bytes live now.
+///
+void bigint_stats_reset ( void )
+{
+#ifdef BIGNUM_STATS
+  ThreadStats * t;
+  size_t i;
+
+  pthread_mutex_lock ( &stats_lock );
+  memset ( &retired, 0, sizeof retired );
+  for ( t = threads; t; t = t->next )
+  {
+    uint64_t * word = (uint64_t *)&t->counts;
+    for ( i = 0; i < sizeof t->counts / sizeof *word; ++ i ) __atomic_store_n ( &word[i], 0, __ATOMIC_RELAXED );
+  }
+  pthread_mutex_unlock ( &stats_lock );
+
+  __atomic_store_n ( &peak_bytes, __atomic_load_n ( &live_bytes, __ATOMIC_RELAXED ), __ATOMIC_RELAXED );
+#endif
+}
+
+///
+/// @param op One of the BIGINT_OP_ values
+///
+/// @return The operation's name as used in bigint_stats_json(), or NULL
+///
+char const * bigint_stats_op_name ( int const op )
+{
+  return op >= 0 && op < BIGINT_OP_COUNT ? op_names[op] : NULL;
+}
+
+typedef struct _tag_text
+{
+  char * out;
+  size_t len, capacity;
+} Text;
+
+static void text_printf ( Text * const t, char const * const format, ... )
+{
+  va_list args;
+  int n;
+
+  va_start ( args, format );
+  n = vsnprintf ( t->out + t->len, t->capacity - t->len, format, args );
+  va_end ( args );
+
+  if ( n >= 0 && (size_t)n >= t->capacity - t->len )
+  {
+    t->out = _bigint_realloc ( t->out, t->capacity, 2 * t->capacity + n );
+    t->capacity = 2 * t->capacity + n;
+
+    va_start ( args, format );
+    n = vsnprintf ( t->out + t->len, t->capacity - t->len, format, args );
+    va_end ( args );
+  }
+
+  if ( n > 0 ) t->len += n;
+}
+
+///
+/// Renders a snapshot as a JSON object. Operations never called are left
+/// out, and each histogram stops at its last nonzero bucket.
+///
+/// @param s A snapshot from bigint_stats_snapshot()
+///
+/// @return A new C-string. Must be released with bigint_free_string().
+///
+char * bigint_stats_json ( BigIntStats const * const s )
+{
+  MEMORY_GUARD ( NULL );
+
+  Text t = { _bigint_alloc ( 1024 ), 0, 1024 };
+  char const * comma = "";
+  int op, k, top;
+
+  text_printf ( &t, "{\"enabled\": %s, \"bit_allocs\": %llu, \"bit_frees\": %llu, \"live_bytes\": %llu, \"peak_live_bytes\": %llu, \"ops\": {",
+                bigint_stats_enabled ( ) ? "true" : "false",
+                (unsigned long long)s->bit_allocs, (unsigned long long)s->bit_frees,
+                (unsigned long long)s->live_bytes, (unsigned long long)s->peak_live_bytes );
+
+  for ( op = 0; op < BIGINT_OP_COUNT; ++ op )
+  {
+    BigIntOpStats const * o = &s->ops[op];
+
+    if ( !o->calls ) continue;
+
+    text_printf ( &t, "%s\"%s\": {\"calls\": %llu, \"bits\": %llu, \"ns\": %llu, \"histogram\": [",
+                  comma, op_names[op], (unsigned long long)o->calls, (unsigned long long)o->bits, (unsigned long long)o->ns );
+
+    for ( top = BIGINT_STATS_BUCKETS; top > 0 && !o->histogram[top - 1]; -- top );
+    for ( k = 0; k < top; ++ k )
+    {
+      text_printf ( &t, "%s%llu", k ? ", " : "", (unsigned long long)o->histogram[k] );
+    }
+
+    text_printf ( &t, "]}" );
+    comma = ", ";
+  }
+
+  text_printf ( &t, "}}" );
+
+  // strings are released by their length
+  return _bigint_realloc ( t.out, t.capacity, t.len + 1 );
+}
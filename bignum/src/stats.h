@@ -0,0 +1,40 @@
+#ifndef _BIGNUM_STATS_H
+#define _BIGNUM_STATS_H
+
+/**
+  * Hooks for the optional operation counters (see stats.c). They compile to
+  * nothing unless the library is configured with --enable-stats, which
+  * defines BIGNUM_STATS. This is private to the library.
+  **/
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t _bigint_stats_now ( void );
+
+#ifdef BIGNUM_STATS
+
+void _bigint_stats_record ( int, uint64_t, uint64_t );
+void _bigint_stats_alloc ( size_t );
+void _bigint_stats_free ( size_t );
+
+// STATS_BEGIN() starts timing the enclosing function over the given number
+// of operand bits, STATS_BITS() adds to them, and each STATS_END() records
+// one call of op
+#define STATS_BEGIN(bits) uint64_t const stats_start = _bigint_stats_now ( ); uint64_t stats_bits = (bits)
+#define STATS_BITS(bits) ( stats_bits += (bits) )
+#define STATS_END(op) _bigint_stats_record ( (op), stats_bits, stats_start )
+#define STATS_ALLOC(size) _bigint_stats_alloc ( size )
+#define STATS_FREE(size) _bigint_stats_free ( size )
+
+#else
+
+#define STATS_BEGIN(bits) ((void)0)
+#define STATS_BITS(bits) ((void)0)
+#define STATS_END(op) ((void)0)
+#define STATS_ALLOC(size) ((void)0)
+#define STATS_FREE(size) ((void)0)
+
+#endif
+
+#endif // _BIGNUM_STATS_H
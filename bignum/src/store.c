@@ -0,0 +1,315 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bignum.h"
+#include "memory.h"
+#include "byteorder.h"
+
+/**
+  * Store file layout, all integers little-endian:
+  *
+  *   offset     size      field
+  *   0          4         magic "BNST"
+  *   4          1         store version (BIGINT_STORE_VERSION)
+  *   5          3         reserved, zero
+  *   8          8         number of records, n
+  *   16         8(n+1)    record offsets relative to the data region; record
+  *                        i spans [offset[i], offset[i+1])
+  *   24+8n      ...       data region: records in the serialize.c format
+  **/
+
+static unsigned char const magic[4] = { 'B', 'N', 'S', 'T' };
+
+struct _tag_bigint_store
+{
+  unsigned char const * map;
+  size_t size;
+  size_t count;
+  unsigned char const * index;
+  unsigned char const * data;
+  size_t data_size;
+};
+
+///
+/// Creates a file to write a store into beside its final path, named from
+/// the path, the process and a counter, and readable as the store would be.
+///
+/// @param path The store's final path
+/// @param tmp Receives the temporary file's name, to be released with
+/// _bigint_free_owned() (size strlen(path)+32)
+///
+/// @return The open file, or NULL with *tmp NULL
+///
+static FILE * create_temp ( char const * const path, char ** const tmp )
+{
+  static unsigned long counter = 0;
+  size_t const size = strlen ( path ) + 32;
+  struct stat st;
+  FILE * f = NULL;
+  int fd = -1, tries;
+
+  *tmp = _bigint_try_alloc ( size );
+  if ( !*tmp )
+  {
+    _bigint_memory_exhausted ( );
+    return NULL;
+  }
+
+  for ( tries = 0; fd < 0 && tries < 16; ++ tries )
+  {
+    snprintf ( *tmp, size, "%s.%ld.%lu", path, (long)getpid ( ), __atomic_fetch_add ( &counter, 1, __ATOMIC_RELAXED ) );
+    fd = open ( *tmp, O_WRONLY | O_CREAT | O_EXCL, 0666 );
+  }
+
+  // a store being replaced keeps its permissions
+  if ( fd >= 0 && stat ( path, &st ) == 0 ) fchmod ( fd, st.st_mode & 07777 );
+
+  if ( fd >= 0 && !( f = fdopen ( fd, "wb" ) ) )
+  {
+    close ( fd );
+    unlink ( *tmp );
+  }
+
+  if ( !f )
+  {
+    _bigint_free_owned ( *tmp, size );
+    *tmp = NULL;
+  }
+
+  return f;
+}
+
+///
+/// Writes a list of BigInts to a store file, replacing any existing file.
+/// The store is written to a temporary file in the same directory, synced,
+/// then renamed over the path, so a store open elsewhere keeps its old
+/// contents and a failed write leaves the old file in place.
+///
+/// @param path The file to write
+/// @param values The BigInts to store
+/// @param n The number of BigInts
+/// @param flags Serialization flags for each record (BIGINT_EXPORT_CHECKSUM)
+///
+/// @return 0 on success, -1 if the file could not be written or memory ran
+/// out
+///
+int bigint_store_write ( char const * const path, BigInt const * const * const values, size_t const n, int const flags )
+{
+  // nothing below unwinds; the guard only marks the start of the call
+  MEMORY_GUARD ( -1 );
+
+  char * tmp;
+  FILE * f = create_temp ( path, &tmp );
+  unsigned char header[16], entry[8];
+  unsigned char * record = NULL;
+  size_t i, capacity = 0;
+  uint64_t offset = 0;
+  int ok;
+
+  if ( !f ) return -1;
+
+  memcpy ( header, magic, sizeof magic );
+  header[4] = BIGINT_STORE_VERSION;
+  header[5] = header[6] = header[7] = 0;
+  put_le ( header + 8, n, 8 );
+  ok = fwrite ( header, sizeof header, 1, f ) == 1;
+
+  for ( i = 0; ok && i <= n; ++ i )
+  {
+    put_le ( entry, offset, 8 );
+    ok = fwrite ( entry, sizeof entry, 1, f ) == 1;
+    if ( i < n ) offset += bigint_export_size ( values[i], flags );
+  }
+
+  for ( i = 0; ok && i < n; ++ i )
+  {
+    size_t size = bigint_export_size ( values[i], flags );
+
+    if ( size > capacity )
+    {
+      unsigned char * bigger = _bigint_try_realloc ( record, capacity, size );
+
+      if ( !bigger )
+      {
+        _bigint_memory_exhausted ( );
+        ok = 0;
+        break;
+      }
+
+      record = bigger;
+      capacity = size;
+    }
+
+    bigint_export_into ( values[i], flags, record, size );
+    ok = fwrite ( record, size, 1, f ) == 1;
+  }
+
+  _bigint_free_owned ( record, capacity );
+
+  if ( ok && ( fflush ( f ) != 0 || fsync ( fileno ( f ) ) != 0 ) ) ok = 0;
+  if ( fclose ( f ) != 0 ) ok = 0;
+  if ( ok && rename ( tmp, path ) != 0 ) ok = 0;
+  if ( !ok ) unlink ( tmp );
+
+  _bigint_free_owned ( tmp, strlen ( path ) + 32 );
+
+  return ok ? 0 : -1;
+}
+
+///
+/// Opens a store file by mapping it read-only. Only the header is examined;
+/// records are paged in and validated when they are first read.
+///
+/// @param path The store file
+///
+/// @return The open store, or NULL if the file cannot be mapped or is not a
+/// store, or memory ran out. Must be closed with bigint_store_close().
+///
+BigIntStore * bigint_store_open ( char const * const path )
+{
+  MEMORY_GUARD ( NULL );
+
+  BigIntStore * store;
+  struct stat st;
+  void * map;
+  uint64_t count;
+  int fd = open ( path, O_RDONLY );
+
+  if ( fd < 0 ) return NULL;
+
+  if ( fstat ( fd, &st ) != 0 || st.st_size < 24 )
+  {
+    close ( fd );
+    return NULL;
+  }
+
+  map = mmap ( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  close ( fd );
+
+  if ( map == MAP_FAILED ) return NULL;
+
+  count = get_le ( (unsigned char const *)map + 8, 8 );
+
+  if ( memcmp ( map, magic, sizeof magic ) != 0
+      || ((unsigned char const *)map)[4] != BIGINT_STORE_VERSION
+      || count > ( (uint64_t)st.st_size - 24 ) / 8 )
+  {
+    munmap ( map, st.st_size );
+    return NULL;
+  }
+
+  store = _bigint_try_alloc ( sizeof*store );
+
+  if ( !store )
+  {
+    munmap ( map, st.st_size );
+    _bigint_memory_exhausted ( );
+    return NULL;
+  }
+
+  store->map = map;
+  store->size = st.st_size;
+  store->count = count;
+  store->index = store->map + 16;
+  store->data = store->index + 8*(count+1);
+  store->data_size = store->size - ( store->data - store->map );
+
+  return store;
+}
+
+///
+/// Unmaps a store and releases it.
+///
+/// @param store The store to close
+///
+void bigint_store_close ( BigIntStore * const store )
+{
+  if ( store ) munmap ( (void *)store->map, store->size );
+  _bigint_free_owned ( store, sizeof*store );
+}
+
+///
+/// Reports the number of records in a store.
+///
+/// @param store The store
+///
+/// @return The number of records
+///
+size_t bigint_store_count ( BigIntStore const * const store )
+{
+  return store->count;
+}
+
+///
+/// Locates a record in the mapped file without copying it.
+///
+/// @param store The store
+/// @param i The index of the record
+/// @param len The address receiving the record's length
+///
+/// @return A pointer to the record's serialization inside the mapping, or
+/// NULL if i is out of range or the index entry is corrupt
+///
+unsigned char const * bigint_store_record ( BigIntStore const * const store, size_t const i, size_t * const len )
+{
+  uint64_t start, end;
+
+  if ( i >= store->count ) return NULL;
+
+  start = get_le ( store->index + 8*i, 8 );
+  end = get_le ( store->index + 8*(i+1), 8 );
+
+  if ( start > end || end > store->data_size ) return NULL;
+
+  *len = end - start;
+
+  return store->data + start;
+}
+
+///
+/// Materializes one record of a store as a BigInt.
+///
+/// @param store The store
+/// @param i The index of the record
+///
+/// @return A new BigInt, or NULL if i is out of range or the record is
+/// corrupt. Must be freed with bigint_free().
+///
+BigInt * bigint_store_get ( BigIntStore const * const store, size_t const i )
+{
+  size_t len;
+  unsigned char const * record = bigint_store_record ( store, i, &len );
+
+  return record ? bigint_import ( record, len ) : NULL;
+}
+
+///
+/// Tells the kernel how the store is about to be read.
+///
+/// @param store The store
+/// @param pattern BIGINT_STORE_SEQUENTIAL for a front-to-back scan,
+/// BIGINT_STORE_RANDOM for point lookups, BIGINT_STORE_WILLNEED to prefetch
+/// the whole file
+///
+/// @return 0 on success, otherwise an error number from posix_madvise()
+///
+int bigint_store_advise ( BigIntStore const * const store, int const pattern )
+{
+  int advice = POSIX_MADV_NORMAL;
+
+  switch ( pattern )
+  {
+    case BIGINT_STORE_SEQUENTIAL: advice = POSIX_MADV_SEQUENTIAL; break;
+    case BIGINT_STORE_RANDOM: advice = POSIX_MADV_RANDOM; break;
+    case BIGINT_STORE_WILLNEED: advice = POSIX_MADV_WILLNEED; break;
+  }
+
+  return posix_madvise ( (void *)store->map, store->size, advice );
+}
@@ -0,0 +1,405 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bignum.h"
+
+/**
+  * Times the library's main operations across operand sizes.
+  *
+  *   bench_bignum [--max-bits N] [--min-time SECONDS] [--filter OP]
+  *                [--json FILE] [--baseline FILE] [--threshold PERCENT]
+  *
+  * Each operation on each size repeats until --min-time has passed and
+  * reports ns/op, throughput in operand Mbit/s and allocations per op.
+  * --json saves the results; --baseline compares against a saved file and
+  * exits with status 1 when any operation is more than --threshold percent
+  * slower than before.
+  **/
+
+#define BENCH_MAX_RESULTS 256
+
+// operands for one size, built before timing starts
+typedef struct _tag_operands
+{
+  BigInt * a, * b, * divisor, * n;
+  char * text;
+} Operands;
+
+typedef struct _tag_benchmark
+{
+  char const * name;
+  void (*run) ( Operands const * const );
+} Benchmark;
+
+typedef struct _tag_result
+{
+  char op[32];
+  long bits;
+  long iterations;
+  double ns_per_op, mbit_per_s, allocs_per_op;
+} Result;
+
+#ifdef __GLIBC__
+
+// count every allocation, including those made by pool workers, by
+// interposing on the allocator
+#define BENCH_COUNTS_ALLOCATIONS 1
+
+extern void * __libc_malloc ( size_t );
+extern void * __libc_calloc ( size_t, size_t );
+extern void * __libc_realloc ( void *, size_t );
+
+static unsigned long allocations = 0;
+
+void * malloc ( size_t size )
+{
+  __atomic_fetch_add ( &allocations, 1, __ATOMIC_RELAXED );
+  return __libc_malloc ( size );
+}
+
+void * calloc ( size_t count, size_t size )
+{
+  __atomic_fetch_add ( &allocations, 1, __ATOMIC_RELAXED );
+  return __libc_calloc ( count, size );
+}
+
+void * realloc ( void * p, size_t size )
+{
+  __atomic_fetch_add ( &allocations, 1, __ATOMIC_RELAXED );
+  return __libc_realloc ( p, size );
+}
+
+static unsigned long allocation_count ( void )
+{
+  return __atomic_load_n ( &allocations, __ATOMIC_RELAXED );
+}
+
+#else
+
+static unsigned long allocation_count ( void )
+{
+  return 0;
+}
+
+#endif
+
+static void run_add ( Operands const * const o ) { bigint_free ( bigint_add ( o->a, o->b ) ); }
+static void run_multiply ( Operands const * const o ) { bigint_free ( bigint_multiply ( o->a, o->b ) ); }
+static void run_square ( Operands const * const o ) { bigint_free ( bigint_multiply ( o->a, o->a ) ); }
+static void run_modulo ( Operands const * const o ) { bigint_free ( bigint_modulo ( o->a, o->divisor ) ); }
+static void run_factorial ( Operands const * const o ) { bigint_free ( bigint_factorial ( o->n ) ); }
+static void run_tostring ( Operands const * const o ) { bigint_free_string ( bigint_tostring_base10 ( o->a ) ); }
+static void run_fromstring ( Operands const * const o ) { bigint_free ( bigint_init_from_string ( o->text ) ); }
+
+static void run_divide ( Operands const * const o )
+{
+  BigInt * r = NULL;
+
+  bigint_free ( bigint_divide ( o->a, o->divisor, &r ) );
+  bigint_free ( r );
+}
+
+static Benchmark const benchmarks[] =
+{
+  { "add", run_add },
+  { "multiply", run_multiply },
+  { "square", run_square },
+  { "divide", run_divide },
+  { "modulo", run_modulo },
+  { "factorial", run_factorial },
+  { "tostring", run_tostring },
+  { "fromstring", run_fromstring },
+};
+
+///
+/// Builds a pseudo-random value whose top bit is set.
+///
+static BigInt * random_value ( long bits, uint64_t * const state )
+{
+  BigInt * bi = bigint_init_empty ( );
+  long i;
+
+  for ( i = 0; i < bits - 1; ++ i )
+  {
+    *state = *state * 6364136223846793005u + 1442695040888963407u;
+    append_bit ( bi, *state >> 63 );
+  }
+  append_bit ( bi, true );
+
+  return bi;
+}
+
+///
+/// @return The n for which n! has about the given number of bits
+///
+static long factorial_argument ( long bits )
+{
+  long total = 0, n = 1, v;
+
+  // log2(n!) is the sum of log2(k), rounded down here
+  while ( total < bits )
+  {
+    ++ n;
+    for ( v = n; v > 1; v >>= 1 ) ++ total;
+  }
+
+  return n;
+}
+
+static void operands_init ( Operands * const o, long bits )
+{
+  uint64_t state = 0x9e3779b97f4a7c15u ^ (uint64_t)bits;
+
+  o->a = random_value ( bits, &state );
+  o->b = random_value ( bits, &state );
+  o->divisor = random_value ( bits / 2 > 0 ? bits / 2 : 1, &state );
+  o->n = _bigint_init_uint64 ( factorial_argument ( bits ) );
+  o->text = bigint_tostring_base10 ( o->a );
+}
+
+static void operands_free ( Operands * const o )
+{
+  bigint_free ( o->a );
+  bigint_free ( o->b );
+  bigint_free ( o->divisor );
+  bigint_free ( o->n );
+  bigint_free_string ( o->text );
+}
+
+static double now_ns ( void )
+{
+  struct timespec ts;
+
+  clock_gettime ( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+///
+/// Repeats one benchmark until min_ns has passed, after one untimed run.
+///
+static void measure ( Benchmark const * const bench, Operands const * const o, long bits, double min_ns, Result * const out )
+{
+  double start, elapsed;
+  unsigned long allocs;
+  long iterations = 0;
+
+  bench->run ( o );
+
+  allocs = allocation_count ( );
+  start = now_ns ( );
+  do
+  {
+    bench->run ( o );
+    ++ iterations;
+    elapsed = now_ns ( ) - start;
+  }
+  while ( elapsed < min_ns );
+  allocs = allocation_count ( ) - allocs;
+
+  snprintf ( out->op, sizeof out->op, "%s", bench->name );
+  out->bits = bits;
+  out->iterations = iterations;
+  out->ns_per_op = elapsed / iterations;
+  out->mbit_per_s = bits / out->ns_per_op * 1e3;
+  out->allocs_per_op = (double)allocs / iterations;
+}
+
+static int write_json ( char const * const path, Result const * const results, int count )
+{
+  FILE * f = fopen ( path, "w" );
+  int i;
+
+  if ( !f ) return -1;
+
+  fprintf ( f, "{\n  \"benchmarks\": [\n" );
+  for ( i = 0; i < count; ++ i )
+  {
+    fprintf ( f, "    {\"op\": \"%s\", \"bits\": %ld, \"iterations\": %ld, \"ns_per_op\": %.1f, \"mbit_per_s\": %.3f, \"allocs_per_op\": %.1f}%s\n",
+              results[i].op, results[i].bits, results[i].iterations, results[i].ns_per_op,
+              results[i].mbit_per_s, results[i].allocs_per_op, i + 1 < count ? "," : "" );
+  }
+  fprintf ( f, "  ]\n}\n" );
+
+  return fclose ( f );
+}
+
+///
+/// Reads a number following "key": on a line written by write_json().
+///
+static int json_number ( char const * const line, char const * const key, double * const out )
+{
+  char pattern[48];
+  char const * p;
+
+  snprintf ( pattern, sizeof pattern, "\"%s\":", key );
+  p = strstr ( line, pattern );
+
+  return p && sscanf ( p + strlen ( pattern ), "%lf", out ) == 1;
+}
+
+///
+/// Loads a file written by --json, one benchmark per line.
+///
+/// @return The number of entries read, or -1 if the file cannot be opened
+///
+static int read_json ( char const * const path, Result * const results, int capacity )
+{
+  FILE * f = fopen ( path, "r" );
+  char line[512];
+  int count = 0;
+
+  if ( !f ) return -1;
+
+  while ( count < capacity && fgets ( line, sizeof line, f ) )
+  {
+    char const * op = strstr ( line, "\"op\": \"" );
+    double bits;
+    Result * r = &results[count];
+
+    if ( !op || sscanf ( op + 7, "%31[^\"]", r->op ) != 1 ) continue;
+    if ( !json_number ( line, "bits", &bits ) || !json_number ( line, "ns_per_op", &r->ns_per_op ) ) continue;
+
+    r->bits = (long)bits;
+    ++ count;
+  }
+
+  fclose ( f );
+  return count;
+}
+
+///
+/// Prints each result's change against the baseline.
+///
+/// @return The number of results slower than the threshold allows
+///
+static int compare_baseline ( Result const * const results, int count, Result const * const baseline, int base_count, double threshold )
+{
+  int i, j, regressions = 0;
+
+  printf ( "\n%-12s %10s %12s %12s %9s\n", "op", "bits", "baseline", "now", "change" );
+
+  for ( i = 0; i < count; ++ i )
+  {
+    for ( j = 0; j < base_count; ++ j )
+    {
+      if ( baseline[j].bits == results[i].bits && strcmp ( baseline[j].op, results[i].op ) == 0 ) break;
+    }
+    if ( j == base_count ) continue;
+
+    double change = ( results[i].ns_per_op / baseline[j].ns_per_op - 1 ) * 100;
+    bool regressed = change > threshold;
+
+    printf ( "%-12s %10ld %12.1f %12.1f %+8.1f%%%s\n", results[i].op, results[i].bits,
+             baseline[j].ns_per_op, results[i].ns_per_op, change, regressed ? "  REGRESSION" : "" );
+
+    regressions += regressed;
+  }
+
+  return regressions;
+}
+
+static void usage ( char const * const self )
+{
+  fprintf ( stderr, "usage: %s [--max-bits N] [--min-time SECONDS] [--filter OP]\n"
+                    "          [--json FILE] [--baseline FILE] [--threshold PERCENT]\n", self );
+}
+
+int main ( int argc, char ** argv )
+{
+  static Result results[BENCH_MAX_RESULTS], baseline[BENCH_MAX_RESULTS];
+  char const * filter = NULL, * json = NULL, * base_path = NULL;
+  long max_bits = 65536, bits;
+  double min_time = 0.25, threshold = 10;
+  int count = 0, i;
+  size_t k;
+
+  for ( i = 1; i < argc; ++ i )
+  {
+    char const * value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if ( !value )
+    {
+      usage ( argv[0] );
+      return 2;
+    }
+
+    if ( strcmp ( argv[i], "--max-bits" ) == 0 ) max_bits = atol ( value );
+    else if ( strcmp ( argv[i], "--min-time" ) == 0 ) min_time = atof ( value );
+    else if ( strcmp ( argv[i], "--filter" ) == 0 ) filter = value;
+    else if ( strcmp ( argv[i], "--json" ) == 0 ) json = value;
+    else if ( strcmp ( argv[i], "--baseline" ) == 0 ) base_path = value;
+    else if ( strcmp ( argv[i], "--threshold" ) == 0 ) threshold = atof ( value );
+    else
+    {
+      usage ( argv[0] );
+      return 2;
+    }
+    ++ i;
+  }
+
+#ifndef BENCH_COUNTS_ALLOCATIONS
+  fprintf ( stderr, "allocation counts are unavailable on this platform\n" );
+#endif
+
+  printf ( "# kernels: %s\n", bigint_cpu_level_name ( bigint_cpu_level ( ) ) );
+  printf ( "%-12s %10s %10s %14s %12s %12s\n", "op", "bits", "iters", "ns/op", "Mbit/s", "allocs/op" );
+
+  if ( max_bits < 1 )
+  {
+    usage ( argv[0] );
+    return 2;
+  }
+
+  // sizes grow by a factor of four from 64 bits, ending at max_bits
+  for ( bits = max_bits < 64 ? max_bits : 64; ; bits = bits * 4 < max_bits ? bits * 4 : max_bits )
+  {
+    Operands o;
+
+    operands_init ( &o, bits );
+
+    for ( k = 0; k < sizeof benchmarks / sizeof *benchmarks && count < BENCH_MAX_RESULTS; ++ k )
+    {
+      Result * r = &results[count];
+
+      if ( filter && !strstr ( filter, benchmarks[k].name ) ) continue;
+
+      measure ( &benchmarks[k], &o, bits, min_time * 1e9, r );
+      printf ( "%-12s %10ld %10ld %14.1f %12.3f %12.1f\n", r->op, r->bits, r->iterations, r->ns_per_op, r->mbit_per_s, r->allocs_per_op );
+      fflush ( stdout );
+      ++ count;
+    }
+
+    operands_free ( &o );
+    if ( bits == max_bits ) break;
+  }
+
+  if ( json && write_json ( json, results, count ) != 0 )
+  {
+    fprintf ( stderr, "cannot write %s\n", json );
+    return 2;
+  }
+
+  if ( base_path )
+  {
+    int base_count = read_json ( base_path, baseline, BENCH_MAX_RESULTS ), regressions;
+
+    if ( base_count < 0 )
+    {
+      fprintf ( stderr, "cannot read %s\n", base_path );
+      return 2;
+    }
+
+    regressions = compare_baseline ( results, count, baseline, base_count, threshold );
+    if ( regressions )
+    {
+      printf ( "\n%d regression%s over %.1f%%\n", regressions, regressions == 1 ? "" : "s", threshold );
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -4,7 +4,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-int execute_test ( char *, void(*)(void) );
+int execute_test ( char const *, void(*)(void) );
 void do_tests ( void );
 void test_succeeded ( void );
 void test_failed ( char * );
@@ -1,4 +1,10 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "bignum.h"
 #include "tests.h"
 
@@ -241,6 +247,34 @@ void test_bigint_copy ( void )
   bigint_free ( a );
 }
 
+void test_bigint_copy_on_write ( void )
+{
+  BigInt * a = bigint_init ( 99999 ), * b, * c, * d;
+
+  b = bigint_copy ( a );
+  c = bigint_copy ( b );
+  ASSERT ( a->lsb == b->lsb && b->lsb == c->lsb, "copy did not share its bits" );
+
+  // the first writer gets its own list; the others keep the value
+  bigint_add_in_place ( b, b );
+  ASSERT ( b->lsb != a->lsb && bigint_low_dword ( b ) == 199998, "shared copy not separated on write" );
+  ASSERT ( bigint_low_dword ( a ) == 99999 && bigint_low_dword ( c ) == 99999, "write leaked to other sharers" );
+
+  // the original may go first
+  bigint_free ( a );
+  bigint_pop_lsb ( c );
+  ASSERT ( bigint_low_dword ( c ) == 49999, "last sharer not writable" );
+
+  d = bigint_init ( -5 );
+  bigint_move ( d, c );
+  ASSERT ( bigint_low_dword ( d ) == 49999 && bigint_positive ( d ), "move lost the value" );
+  ASSERT ( c->count == 0 && c->lsb == NULL, "move did not empty the source" );
+
+  bigint_free ( d );
+  bigint_free ( c );
+  bigint_free ( b );
+}
+
 void test_bigint_multiply ( void )
 {
   BigInt * a, * b, * c, * a_x_b;
@@ -276,6 +310,124 @@ void test_bigint_multiply ( void )
   bigint_free ( a );
 }
 
+void test_bigint_addmul ( void )
+{
+  BigInt * r = bigint_init ( 1000 ), * a = bigint_init ( -37 ), * b = bigint_init ( 41 );
+  BigInt * big_a, * big_b, * expected, * m, * x;
+
+  bigint_addmul ( r, a, b );
+  ASSERT ( bigint_low_dword ( r ) == 37*41 - 1000 && !bigint_positive ( r ), "addmul across signs failed" );
+  bigint_submul ( r, a, b );
+  ASSERT ( bigint_low_dword ( r ) == 1000 && bigint_positive ( r ), "submul failed" );
+  bigint_addmul ( r, r, b );
+  ASSERT ( bigint_low_dword ( r ) == 42000, "addmul into a multiplicand failed" );
+
+  // beyond the in-place range the product goes through Karatsuba
+  x = bigint_init ( 60 );
+  big_a = bigint_factorial ( x );
+  bigint_free ( x );
+  x = bigint_init ( 70 );
+  big_b = bigint_factorial ( x );
+  bigint_free ( x );
+  expected = bigint_multiply ( big_a, big_b );
+  _real_bigint_add_in_place ( expected, r );
+  bigint_addmul ( r, big_a, big_b );
+  ASSERT ( bigint_compare ( r, expected ) == 0, "large addmul failed" );
+  bigint_free ( expected );
+  bigint_free ( big_b );
+  bigint_free ( big_a );
+
+  // m = 2^89-1, so (2^88)^2 = 2^176 = 2^87 (mod m)
+  bigint_free ( r );
+  r = bigint_init ( 1 );
+  m = bigint_init ( 1 );
+  bigint_shift_left ( m, 89 );
+  bigint_subtract_in_place ( m, r );
+  x = bigint_init ( 1 );
+  bigint_shift_left ( x, 88 );
+  expected = bigint_mulmod ( x, x, m );
+  bigint_shift_right ( x, 1 );
+  ASSERT ( bigint_compare ( expected, x ) == 0, "mulmod failed" );
+  bigint_free ( expected );
+  bigint_free ( x );
+  bigint_free ( m );
+
+  // negative operands reduce into [0,m): -37 * 41 = -1517 = 2 (mod 7)
+  m = bigint_init ( 7 );
+  expected = bigint_mulmod ( a, b, m );
+  ASSERT ( bigint_low_dword ( expected ) == 2 && bigint_positive ( expected ), "signed mulmod failed" );
+
+  bigint_free ( expected );
+  bigint_free ( m );
+  bigint_free ( b );
+  bigint_free ( a );
+  bigint_free ( r );
+}
+
+void test_bigint_multiply_karatsuba ( void )
+{
+  BigInt * a = bigint_init_from_string ( "-123456789012345678901234567890123456789" );
+  BigInt * b = bigint_init_from_string ( "98765432109876543210987654321" );
+  BigInt * c = bigint_init_from_string ( "-12193263113702179522618503273374485596336229233322374638011112635269" );
+  BigInt * a_x_b = bigint_multiply ( a, b );
+  BigInt * ref = _bigint_multiply_schoolbook ( a, b );
+  BigInt * fast = _bigint_multiply_karatsuba ( a, b );
+
+  ASSERT ( bigint_compare ( a_x_b, c ) == 0, "wrong product above the Karatsuba threshold" );
+  ASSERT ( bigint_compare ( fast, ref ) == 0, "Karatsuba disagrees with shift-add" );
+
+  bigint_free ( fast );
+  bigint_free ( ref );
+  bigint_free ( a_x_b );
+  bigint_free ( c );
+  bigint_free ( b );
+
+  // unbalanced operands
+  b = bigint_init ( 1 );
+  bigint_shift_left ( b, 300 );
+  bigint_add_in_place ( b, a );
+  ref = _bigint_multiply_schoolbook ( b, a );
+  fast = _bigint_multiply_karatsuba ( a, b );
+  ASSERT ( bigint_compare ( fast, ref ) == 0, "unbalanced Karatsuba disagrees with shift-add" );
+
+  bigint_free ( fast );
+  bigint_free ( ref );
+  bigint_free ( b );
+  bigint_free ( a );
+}
+
+void test_bigint_multiply_parallel ( void )
+{
+  int const n = BIGINT_PARALLEL_THRESHOLD / 2 + 1;
+  BigInt * ones = bigint_init_empty ( );
+  BigInt * one = bigint_init ( 1 );
+  BigInt * expected = bigint_init ( 1 );
+  BigInt * tmp, * square;
+  int i;
+
+  ASSERT ( bigint_set_threads ( 4 ) == 4, "failed to start four threads" );
+
+  // (2^n - 1)^2 = 2^2n - 2^(n+1) + 1
+  for ( i = 0; i < n; ++ i ) append_bit ( ones, true );
+
+  square = bigint_multiply ( ones, ones );
+
+  bigint_shift_left ( expected, 2*n );
+  tmp = bigint_init ( 1 );
+  bigint_shift_left ( tmp, n+1 );
+  bigint_subtract_in_place ( expected, tmp );
+  bigint_add_in_place ( expected, one );
+
+  ASSERT ( bigint_compare ( square, expected ) == 0, "wrong parallel square" );
+  ASSERT ( square->count == 2*n, "parallel square not normalized" );
+
+  bigint_free ( tmp );
+  bigint_free ( square );
+  bigint_free ( expected );
+  bigint_free ( one );
+  bigint_free ( ones );
+}
+
 void test_bigint_shift ( void )
 {
   BigInt * a = bigint_init ( 100 );
@@ -676,6 +828,77 @@ void test_bigint_from_string ( void )
   bigint_free ( a );
 }
 
+void test_bigint_parser ( void )
+{
+  char * digits;
+  BigIntParser * p = bigint_parser_new ( 10 );
+  BigInt * a = bigint_init ( 2000 ), * b, * c;
+  size_t i, len;
+
+  b = bigint_factorial ( a );
+  b->positive = false;
+  digits = bigint_tostring_base10 ( b );
+  len = strlen ( digits );
+
+  // uneven pieces that split the sign and chunk boundaries
+  for ( i = 0; i < len; i += 7 )
+  {
+    ASSERT ( bigint_parser_feed ( p, digits + i, len - i < 7 ? len - i : 7 ) == 0, "valid digits rejected" );
+  }
+  c = bigint_parser_finish ( p );
+  ASSERT ( c && bigint_compare ( b, c ) == 0, "chunked decimal parse of -2000! failed" );
+  free ( digits );
+  bigint_free ( c );
+  bigint_free ( b );
+  bigint_free ( a );
+
+  p = bigint_parser_new ( 0 );
+  bigint_parser_feed ( p, "-0", 2 );
+  bigint_parser_feed ( p, "xDEAD", 5 );
+  bigint_parser_feed ( p, "beef", 4 );
+  c = bigint_parser_finish ( p );
+  ASSERT ( c && (unsigned int)bigint_low_dword ( c ) == 0xdeadbeefu && !bigint_positive ( c ), "hex parse failed" );
+  bigint_free ( c );
+
+  p = bigint_parser_new ( 0 );
+  bigint_parser_feed ( p, "0b0001", 6 );
+  bigint_parser_feed ( p, "01101", 5 );
+  c = bigint_parser_finish ( p );
+  ASSERT ( c && bigint_low_dword ( c ) == 45 && c->count == 6, "binary parse failed" );
+  bigint_free ( c );
+
+  p = bigint_parser_new ( 0 );
+  bigint_parser_feed ( p, "0", 1 );
+  c = bigint_parser_finish ( p );
+  ASSERT ( c && c->count == 0, "lone zero parse failed" );
+  bigint_free ( c );
+
+  p = bigint_parser_new ( 0 );
+  bigint_parser_feed ( p, "0017", 4 );
+  c = bigint_parser_finish ( p );
+  ASSERT ( c && bigint_low_dword ( c ) == 17, "leading-zero decimal parse failed" );
+  bigint_free ( c );
+
+  p = bigint_parser_new ( 10 );
+  ASSERT ( bigint_parser_feed ( p, "12a4", 4 ) == -1, "invalid digit accepted" );
+  ASSERT ( bigint_parser_finish ( p ) == NULL, "invalid input produced a value" );
+
+  p = bigint_parser_new ( 16 );
+  ASSERT ( bigint_parser_finish ( p ) == NULL, "empty input produced a value" );
+
+  // a base prefix is not a digit
+  p = bigint_parser_new ( 0 );
+  ASSERT ( bigint_parser_feed ( p, "0x", 2 ) == 0 && bigint_parser_finish ( p ) == NULL, "bare 0x produced a value" );
+  p = bigint_parser_new ( 0 );
+  ASSERT ( bigint_parser_feed ( p, "0b", 2 ) == 0 && bigint_parser_finish ( p ) == NULL, "bare 0b produced a value" );
+  p = bigint_parser_new ( 0 );
+  bigint_parser_feed ( p, "-0", 2 );
+  bigint_parser_feed ( p, "x", 1 );
+  ASSERT ( bigint_parser_finish ( p ) == NULL, "bare -0x produced a value" );
+
+  ASSERT ( bigint_parser_new ( 63 ) == NULL, "unsupported base accepted" );
+}
+
 void test_bitlist_compare_magnitude ( void )
 {
   BigInt * a = bigint_init ( 127 );
@@ -728,6 +951,143 @@ void test_bigint_binary_slice ( void )
   bigint_free ( a );
 }
 
+void test_bigint_pow2_radix ( void )
+{
+  BigInt * a = bigint_init ( -48879 ), * b, * c;
+  char * str;
+  int bits;
+
+  str = bigint_tostring_base16 ( a );
+  ASSERT ( strcmp ( str, "-beef" ) == 0, "hex rendering failed" );
+  bigint_free_string ( str );
+
+  str = bigint_tostring_pow2 ( a, 3 );
+  ASSERT ( strcmp ( str, "-137357" ) == 0, "octal rendering failed" );
+  bigint_free_string ( str );
+
+  // 48879 = 1*32^3 + 15*32^2 + 23*32 + 15 = 11*64^2 + 59*64 + 47
+  str = bigint_tostring_base32 ( a );
+  ASSERT ( strcmp ( str, "-BPXP" ) == 0, "base32 rendering failed" );
+  bigint_free_string ( str );
+
+  str = bigint_tostring_base64 ( a );
+  ASSERT ( strcmp ( str, "-L7v" ) == 0, "base64 rendering failed" );
+  bigint_free_string ( str );
+
+  b = bigint_init_from_hex ( "-0xBeEf" );
+  ASSERT ( b && bigint_compare ( a, b ) == 0, "hex parse failed" );
+  bigint_free ( b );
+
+  b = bigint_init_from_base64 ( "-L7v" );
+  ASSERT ( b && bigint_compare ( a, b ) == 0, "base64 parse failed" );
+  bigint_free ( b );
+  bigint_free ( a );
+
+  // round trip a large value through every power-of-two radix
+  a = bigint_init ( 500 );
+  b = bigint_factorial ( a );
+  bigint_free ( a );
+
+  for ( bits = 1; bits <= 5; ++ bits )
+  {
+    str = bigint_tostring_pow2 ( b, bits );
+    c = bigint_init_from_pow2 ( str, bits );
+    ASSERT ( c && bigint_compare ( b, c ) == 0, "power-of-two radix round trip failed" );
+    bigint_free_string ( str );
+    bigint_free ( c );
+  }
+
+  str = bigint_tostring_base64 ( b );
+  c = bigint_init_from_base64 ( str );
+  ASSERT ( c && bigint_compare ( b, c ) == 0, "base64 round trip failed" );
+  bigint_free_string ( str );
+  bigint_free ( c );
+  bigint_free ( b );
+
+  a = bigint_init ( 0 );
+  str = bigint_tostring_base32 ( a );
+  ASSERT ( strcmp ( str, "A" ) == 0, "base32 zero rendering failed" );
+  bigint_free_string ( str );
+  bigint_free ( a );
+
+  ASSERT ( bigint_init_from_hex ( "0x" ) == NULL, "empty hex accepted" );
+  ASSERT ( bigint_init_from_hex ( "12g4" ) == NULL, "invalid hex digit accepted" );
+  ASSERT ( bigint_init_from_hex ( "--5" ) == NULL, "double sign accepted" );
+  ASSERT ( bigint_init_from_hex ( "+-5" ) == NULL, "double sign accepted" );
+  ASSERT ( bigint_init_from_hex ( "0x-5" ) == NULL, "sign after prefix accepted" );
+  ASSERT ( bigint_init_from_hex ( "-0x-5" ) == NULL, "sign after prefix accepted" );
+  ASSERT ( bigint_init_from_base64 ( "ab=" ) == NULL, "base64 padding accepted" );
+  ASSERT ( bigint_tostring_pow2 ( NULL, 6 ) == NULL, "unsupported radix accepted" );
+}
+
+void test_bigint_radix ( void )
+{
+  // -(2^100 + 12345)
+  BigInt * a = bigint_init_from_string ( "-1267650600228229401496703217721" ), * b, * c;
+  char * str;
+  int base;
+
+  str = bigint_tostring_radix ( a, 3 );
+  ASSERT ( strcmp ( str, "-1002220101202122200001221110000110122001202012001102210110102011" ) == 0, "base 3 rendering failed" );
+  bigint_free_string ( str );
+
+  str = bigint_tostring_radix ( a, 36 );
+  ASSERT ( strcmp ( str, "-3ewfdnca0n6ld1ggvozd" ) == 0, "base 36 rendering failed" );
+  bigint_free_string ( str );
+
+  str = bigint_tostring_radix ( a, 58 );
+  ASSERT ( strcmp ( str, "-1JH6VJmrSZ7CiesQ2j" ) == 0, "base 58 rendering failed" );
+  bigint_free_string ( str );
+
+  str = bigint_tostring_radix ( a, 62 );
+  ASSERT ( strcmp ( str, "-QadIgRp0akra2sC7d" ) == 0, "base 62 rendering failed" );
+  bigint_free_string ( str );
+
+  b = bigint_init_from_radix ( "-3EWFDNCA0N6LD1GGVOZD", 36 );
+  ASSERT ( b && bigint_compare ( a, b ) == 0, "base 36 parse failed" );
+  bigint_free ( b );
+
+  b = bigint_init_from_radix ( "-QadIgRp0akra2sC7d", 62 );
+  ASSERT ( b && bigint_compare ( a, b ) == 0, "base 62 parse failed" );
+  bigint_free ( b );
+  bigint_free ( a );
+
+  // every base, first with the shared tables and then with caching disabled
+  a = bigint_init ( 700 );
+  b = bigint_factorial ( a );
+  bigint_free ( a );
+
+  for ( base = 2; base <= 62; ++ base )
+  {
+    str = bigint_tostring_radix ( b, base );
+    c = bigint_init_from_radix ( str, base );
+    ASSERT ( c && bigint_compare ( b, c ) == 0, "radix round trip failed" );
+    bigint_free_string ( str );
+    bigint_free ( c );
+  }
+
+  bigint_set_radix_cache_limit ( 0 );
+  str = bigint_tostring_radix ( b, 7 );
+  c = bigint_init_from_radix ( str, 7 );
+  ASSERT ( c && bigint_compare ( b, c ) == 0, "uncached radix round trip failed" );
+  bigint_free_string ( str );
+  bigint_free ( c );
+  bigint_free ( b );
+  ASSERT ( bigint_set_radix_cache_limit ( BIGINT_RADIX_CACHE_BITS ) == 0, "cache limit not reported" );
+
+  a = bigint_init ( 0 );
+  str = bigint_tostring_radix ( a, 58 );
+  ASSERT ( strcmp ( str, "0" ) == 0, "zero rendering failed" );
+  bigint_free_string ( str );
+  bigint_free ( a );
+
+  ASSERT ( bigint_init_from_radix ( "z", 36 ) != NULL, "valid digit rejected" );
+  ASSERT ( bigint_init_from_radix ( "z", 35 ) == NULL, "out-of-range digit accepted" );
+  ASSERT ( bigint_init_from_radix ( "", 10 ) == NULL, "empty input accepted" );
+  ASSERT ( bigint_tostring_radix ( NULL, 63 ) == NULL, "unsupported base accepted" );
+  ASSERT ( bigint_init_from_radix ( "1", 1 ) == NULL, "unary accepted" );
+}
+
 void test_walk_toward_msb ( void )
 {
   BigInt * a = bigint_init ( 1245 ); // 0b10011011101
@@ -820,6 +1180,65 @@ void test_bigint_tostring_base10 ( void )
   bigint_free ( e );
 }
 
+typedef struct _tag_test_pieces
+{
+  char text[8192];
+  size_t len;
+  int pieces;
+} TestPieces;
+
+static int collect_piece ( void * ctx, char const * buf, size_t len )
+{
+  TestPieces * p = ctx;
+  if ( p->len + len > sizeof p->text ) return 1;
+  memcpy ( p->text + p->len, buf, len );
+  p->len += len;
+  p->pieces ++;
+  return 0;
+}
+
+static int refuse_piece ( void * ctx, char const * buf, size_t len )
+{
+  (*(int *)ctx) ++;
+  return 42;
+}
+
+void test_bigint_write_base10 ( void )
+{
+  BigInt * n = bigint_init ( 1500 );
+  BigInt * a = bigint_factorial ( n );
+  BigInt * zero = bigint_init ( 0 );
+  char * expected = bigint_tostring_base10 ( a );
+  TestPieces * p = calloc ( 1, sizeof*p );
+  char line[64];
+  int calls = 0;
+  FILE * f;
+
+  ASSERT ( bigint_write_base10 ( a, collect_piece, p ) == 0, "streaming write failed" );
+  ASSERT ( p->pieces > 1, "large number was not streamed in pieces" );
+  ASSERT ( p->len == strlen ( expected ) && memcmp ( p->text, expected, p->len ) == 0, "streamed digits differ from bigint_tostring_base10" );
+  ASSERT ( strncmp ( expected, "481199779677977486016699009358137978183480804067261380813085", 60 ) == 0, "wrong leading digits for 1500!" );
+
+  ASSERT ( bigint_write_base10 ( a, refuse_piece, &calls ) == 42 && calls == 1, "writer error was not propagated" );
+
+  f = tmpfile ( );
+  a->positive = false;
+  ASSERT ( bigint_write_base10_file ( zero, f ) == 0, "failed to write zero" );
+  fputc ( ' ', f );
+  ASSERT ( bigint_write_base10_file ( n, f ) == 0, "failed to write 1500" );
+  fputc ( ' ', f );
+  ASSERT ( bigint_write_base10_file ( a, f ) == 0, "failed to write -1500!" );
+  rewind ( f );
+  ASSERT ( fgets ( line, sizeof line, f ) && strncmp ( line, "0 1500 -4811997796", 18 ) == 0, "wrong text written to file" );
+  fclose ( f );
+
+  free ( p );
+  free ( expected );
+  bigint_free ( zero );
+  bigint_free ( a );
+  bigint_free ( n );
+}
+
 void test_bigint_modulo ( void )
 {
   BigInt * a = bigint_init ( 9876543 );
@@ -834,6 +1253,1125 @@ void test_bigint_modulo ( void )
   bigint_free ( a );
 }
 
+void test_bigint_product_list ( void )
+{
+  BigInt * f[5];
+  BigInt * product, * expected, * tmp;
+  int64_t g[6] = { 3, -5, 0x7fffffffffffffffLL, 1000003, -2, 77 };
+  int i;
+
+  f[0] = bigint_init ( -3 );
+  f[1] = bigint_init_from_string ( "123456789012345678901234567890" );
+  f[2] = bigint_init ( 65537 );
+  f[3] = bigint_init_from_string ( "-18446744073709551615" );
+  f[4] = bigint_init ( 2147483647 );
+
+  expected = bigint_init ( 1 );
+  for ( i = 0; i < 5; ++ i )
+  {
+    tmp = bigint_multiply ( expected, f[i] );
+    bigint_swap ( tmp, expected );
+    bigint_free ( tmp );
+  }
+
+  product = bigint_product_list ( (BigInt const * const *)f, 5 );
+  ASSERT ( bigint_compare ( product, expected ) == 0, "wrong product of list" );
+  bigint_free ( product );
+  bigint_free ( expected );
+
+  product = bigint_product_list ( (BigInt const * const *)f, 0 );
+  expected = bigint_init ( 1 );
+  ASSERT ( bigint_compare ( product, expected ) == 0, "empty product is not one" );
+  bigint_free ( product );
+  bigint_free ( expected );
+
+  for ( i = 0; i < 5; ++ i ) bigint_free ( f[i] );
+
+  product = bigint_product_list_int64 ( g, 6 );
+  expected = bigint_init_from_string ( "21306053323102747517766342510" );
+  ASSERT ( bigint_compare ( product, expected ) == 0, "wrong product of int64 list" );
+  bigint_free ( product );
+  bigint_free ( expected );
+
+  g[3] = 0;
+  product = bigint_product_list_int64 ( g, 6 );
+  expected = bigint_init ( 0 );
+  ASSERT ( bigint_compare ( product, expected ) == 0, "product with a zero factor is not zero" );
+  bigint_free ( product );
+  bigint_free ( expected );
+}
+
+void test_bigint_invmod ( void )
+{
+  BigInt * a = bigint_init ( 3 );
+  BigInt * m = bigint_init ( 7 );
+  BigInt * five = bigint_init ( 5 );
+  BigInt * x = bigint_invmod ( a, m );
+
+  ASSERT ( x && bigint_compare ( x, five ) == 0, "wrong inverse of 3 mod 7" );
+  bigint_free ( x );
+  bigint_free ( a );
+
+  a = bigint_init ( -3 );
+  x = bigint_invmod ( a, m );
+  ASSERT ( x && bigint_low_dword ( x ) == 2 && bigint_positive ( x ), "wrong inverse of -3 mod 7" );
+  bigint_free ( x );
+  bigint_free ( a );
+  bigint_free ( m );
+
+  a = bigint_init ( 6 );
+  m = bigint_init ( 9 );
+  ASSERT ( bigint_invmod ( a, m ) == NULL, "6 should not be invertible mod 9" );
+  bigint_free ( m );
+  bigint_free ( a );
+  bigint_free ( five );
+}
+
+void test_bigint_invmod_batch ( void )
+{
+  size_t const n = 1200;
+  BigInt ** values = malloc ( n*sizeof*values ), ** out = malloc ( n*sizeof*out );
+  BigInt * one = bigint_init ( 1 ), * p = bigint_init ( 1 ), * m[3], * x;
+  BigIntStats s;
+  size_t i, bad;
+  int k;
+
+  // the prime 2^127-1 (only 0 fails), three times it (odd, multiples of 3
+  // fail) and twice it (even, so reduced by Barrett; even values fail)
+  bigint_shift_left ( p, 127 );
+  bigint_subtract_in_place ( p, one );
+  m[0] = bigint_copy ( p );
+  m[1] = bigint_add ( p, p );
+  bigint_add_in_place ( m[1], p );
+  m[2] = bigint_add ( p, p );
+
+  for ( i = 0; i < n; ++ i )
+  {
+    values[i] = bigint_init ( (int)( i*7919 + 1 ) );
+    bigint_shift_left ( values[i], (int)( i % 150 ) );
+    values[i]->positive = i % 4 != 0;
+  }
+  bigint_free ( values[5] );
+  values[5] = bigint_init ( 0 );
+
+  // enough values for the pool to take ranges of them
+  bigint_set_threads ( 4 );
+  for ( k = 0; k < 3; ++ k )
+  {
+    int failures = bigint_invmod_batch ( (BigInt const * const *)values, n, m[k], out );
+
+    for ( i = 0, bad = 0; i < n; ++ i )
+    {
+      x = bigint_invmod ( values[i], m[k] );
+      ASSERT ( ( x == NULL ) == ( out[i] == NULL ), "wrong invertibility" );
+      ASSERT ( !x || bigint_compare ( x, out[i] ) == 0, "wrong batch inverse" );
+      bad += x == NULL;
+      bigint_free ( x );
+      bigint_free ( out[i] );
+    }
+    ASSERT ( failures == (int)bad && ( k == 0 ? bad == 1 : bad > 1 ), "wrong count of non-invertible values" );
+  }
+
+  ASSERT ( bigint_invmod_batch ( NULL, 0, p, NULL ) == 0, "empty batch failed" );
+
+  // a batch is one call of its own op, not one huge inversion
+  bigint_stats_reset ( );
+  bigint_invmod_batch ( (BigInt const * const *)values, n, m[0], out );
+  bigint_stats_snapshot ( &s );
+  if ( bigint_stats_enabled ( ) )
+  {
+    ASSERT ( s.ops[BIGINT_OP_INVMOD_BATCH].calls == 1 && s.ops[BIGINT_OP_INVMOD_BATCH].bits == n*m[0]->count, "batch not counted as its own op" );
+    ASSERT ( s.ops[BIGINT_OP_INVMOD].bits < n*m[0]->count, "batch counted as an inversion" );
+  }
+  for ( i = 0; i < n; ++ i ) bigint_free ( out[i] );
+
+  for ( i = 0; i < n; ++ i ) bigint_free ( values[i] );
+  for ( k = 0; k < 3; ++ k ) bigint_free ( m[k] );
+  free ( out );
+  free ( values );
+  bigint_free ( p );
+  bigint_free ( one );
+}
+
+void test_bigint_mod_many ( void )
+{
+  char const * const moduli_str[7] = {
+    "3", "65537", "4294967291", "2305843009213693951",
+    "1000000000000000000000000000057", "618970019642690137449562111", "10"
+  };
+  uint64_t const words[12] = {
+    4294967295u, 4294967294u, 4294967291u, 2147483649u, 2147483648u,
+    2147483647u, 65536, 1024, 2, 1, 7, 4294967296u
+  };
+  BigInt * moduli[7], * out[7], * wm[12], * wout[12];
+  BigInt * n = bigint_init ( 150 );
+  BigInt * x = bigint_factorial ( n );
+  BigInt * y, * zero = bigint_init ( 0 );
+  int i;
+
+  bigint_add_in_place ( x, n );
+  for ( i = 0; i < 7; ++ i ) moduli[i] = bigint_init_from_string ( moduli_str[i] );
+
+  bigint_mod_many ( x, (BigInt const * const *)moduli, 7, out );
+
+  for ( i = 0; i < 7; ++ i )
+  {
+    BigInt * r = bigint_modulo ( x, moduli[i] );
+    ASSERT ( bigint_compare ( out[i], r ) == 0, "bigint_mod_many disagrees with bigint_modulo" );
+    bigint_free ( r );
+  }
+
+  // reconstruct from the pairwise coprime moduli 3, 65537, 2^32-5, 2^61-1
+  y = bigint_crt_reconstruct ( (BigInt const * const *)out, (BigInt const * const *)moduli, 4 );
+  ASSERT ( y != NULL, "failed to reconstruct from coprime moduli" );
+  for ( i = 0; i < 4; ++ i )
+  {
+    BigInt * r = bigint_modulo ( y, moduli[i] );
+    ASSERT ( bigint_compare ( out[i], r ) == 0, "reconstruction has the wrong residue" );
+    bigint_free ( r );
+  }
+  bigint_free ( y );
+
+  // 3 and 6 share a factor
+  bigint_free ( moduli[1] );
+  moduli[1] = bigint_init ( 6 );
+  ASSERT ( bigint_crt_reconstruct ( (BigInt const * const *)out, (BigInt const * const *)moduli, 2 ) == NULL, "reconstructed from moduli sharing a factor" );
+
+  for ( i = 0; i < 7; ++ i )
+  {
+    bigint_free ( out[i] );
+    bigint_free ( moduli[i] );
+  }
+
+  // word moduli at the edges of the reciprocal's normalization: near 2^32,
+  // powers of two (already normalized, or shifted all the way) and tiny;
+  // 2^32 itself goes to the tree
+  for ( i = 0; i < 12; ++ i ) wm[i] = _bigint_init_uint64 ( words[i] );
+
+  bigint_mod_many ( x, (BigInt const * const *)wm, 12, wout );
+  for ( i = 0; i < 12; ++ i )
+  {
+    BigInt * r = bigint_modulo ( x, wm[i] );
+    ASSERT ( bigint_compare ( wout[i], r ) == 0, "word modulus disagrees with bigint_modulo" );
+    bigint_free ( r );
+    bigint_free ( wout[i] );
+  }
+
+  bigint_mod_many ( zero, (BigInt const * const *)wm, 12, wout );
+  for ( i = 0; i < 12; ++ i )
+  {
+    ASSERT ( bigint_compare ( wout[i], zero ) == 0, "zero has a nonzero remainder" );
+    bigint_free ( wout[i] );
+    bigint_free ( wm[i] );
+  }
+
+  bigint_free ( zero );
+  bigint_free ( x );
+  bigint_free ( n );
+}
+
+void test_bigint_export_import ( void )
+{
+  BigInt * n = bigint_init ( 100 );
+  BigInt * a = bigint_factorial ( n );
+  BigInt * b, * zero = bigint_init ( 0 );
+  unsigned char * buf;
+  size_t len;
+
+  a->positive = false;
+
+  buf = bigint_export ( a, 0, &len );
+  ASSERT ( len == bigint_export_size ( a, 0 ) && len == 16 + 8*9, "wrong serialized size for -100!" );
+  ASSERT ( memcmp ( buf, "BNUM\1\2", 6 ) == 0, "wrong header" );
+  b = bigint_import ( buf, len );
+  ASSERT ( b && bigint_compare ( a, b ) == 0, "round trip through binary failed" );
+  bigint_free ( b );
+  ASSERT ( bigint_import ( buf, len - 1 ) == NULL, "imported a truncated buffer" );
+  free ( buf );
+
+  buf = bigint_export ( a, BIGINT_EXPORT_CHECKSUM, &len );
+  b = bigint_import ( buf, len );
+  ASSERT ( b && bigint_compare ( a, b ) == 0, "checksummed round trip failed" );
+  bigint_free ( b );
+  buf[20] ^= 0x10;
+  ASSERT ( bigint_import ( buf, len ) == NULL, "imported a corrupted buffer" );
+  free ( buf );
+
+  buf = bigint_export ( zero, 0, &len );
+  ASSERT ( len == 16, "zero should have no limbs" );
+  b = bigint_import ( buf, len );
+  ASSERT ( b && bigint_compare ( zero, b ) == 0 && b->count == 0, "zero round trip failed" );
+  bigint_free ( b );
+  free ( buf );
+
+  bigint_free ( zero );
+  bigint_free ( a );
+  bigint_free ( n );
+}
+
+///
+/// Reference CRC-32, one bit at a time.
+///
+static uint32_t reference_crc32 ( unsigned char const * buf, size_t len )
+{
+  uint32_t crc = 0xffffffffu;
+  int k;
+
+  while ( len -- )
+  {
+    crc ^= *buf ++;
+    for ( k = 0; k < 8; ++ k ) crc = ( crc >> 1 ) ^ ( 0xedb88320u & ( 0u - ( crc & 1 ) ) );
+  }
+
+  return ~crc;
+}
+
+void test_bigint_cpu_dispatch ( void )
+{
+  unsigned char buf[1000];
+  uint32_t seed = 12345;
+  size_t i;
+
+  for ( i = 0; i < sizeof buf; ++ i )
+  {
+    seed = seed * 1103515245u + 12345u;
+    buf[i] = seed >> 24;
+  }
+
+  ASSERT ( bigint_cpu_level_name ( bigint_cpu_level ( ) ) != NULL, "unknown dispatch level" );
+  ASSERT ( _bigint_crc32 ( (unsigned char const *)"123456789", 9 ) == 0xcbf43926u, "wrong check value" );
+
+  // every length crosses the 64- and 16-byte block boundaries of the
+  // folding kernel, and odd offsets exercise unaligned loads
+  for ( i = 0; i <= 300; ++ i )
+  {
+    ASSERT ( _bigint_crc32 ( buf + i % 7, i ) == reference_crc32 ( buf + i % 7, i ), "CRC kernel disagrees with reference" );
+  }
+  ASSERT ( _bigint_crc32 ( buf, sizeof buf ) == reference_crc32 ( buf, sizeof buf ), "long CRC disagrees with reference" );
+}
+
+void test_bigint_cpu_override ( void )
+{
+  BigInt * n = bigint_init ( 201 ), * f = bigint_factorial ( n ), * m, * p, * q, * r;
+  BigModCtx * ctx;
+  uint32_t * scratch, * x;
+
+  // each test runs in a fresh process, so the level is not yet chosen
+  setenv ( "BIGNUM_CPU", "generic", 1 );
+
+  ASSERT ( bigint_cpu_level ( ) == BIGINT_CPU_GENERIC, "BIGNUM_CPU did not force the generic kernels" );
+  ASSERT ( strcmp ( bigint_cpu_level_name ( BIGINT_CPU_SSE4 ), "sse4" ) == 0 && bigint_cpu_level_name ( 2 ) == NULL, "wrong level names" );
+  ASSERT ( _bigint_crc32 ( (unsigned char const *)"123456789", 9 ) == 0xcbf43926u, "generic kernel gave the wrong check value" );
+
+  // the reference limb loops behind Montgomery multiplication and Hensel
+  // division; the other tests run the host's
+  m = bigint_copy ( f );
+  bigint_add_in_place ( m, n );
+  bigint_shift_right ( f, 1 );
+  ctx = bigint_modctx_new ( m );
+  scratch = malloc ( bigint_modctx_scratch_limbs ( ctx )*sizeof*scratch );
+  x = malloc ( bigint_modctx_limbs ( ctx )*sizeof*x );
+  bigint_modctx_in ( ctx, x, f, scratch );
+  bigint_modctx_mulmod ( ctx, x, x, x, scratch );
+  bigint_modctx_sqrmod ( ctx, x, x, scratch );
+  p = bigint_modctx_out ( ctx, x, scratch );
+  q = bigint_mulmod ( f, f, m );
+  r = bigint_mulmod ( q, q, m );
+  ASSERT ( bigint_compare ( p, r ) == 0, "generic Montgomery kernels disagree with bigint_mulmod" );
+
+  bigint_free ( r );
+  bigint_free ( q );
+  q = bigint_multiply ( f, m );
+  r = bigint_divexact ( q, m );
+  ASSERT ( bigint_compare ( r, f ) == 0, "generic Hensel kernel gave the wrong quotient" );
+
+  bigint_free ( r );
+  bigint_free ( q );
+  bigint_free ( p );
+  free ( x );
+  free ( scratch );
+  bigint_modctx_free ( ctx );
+  bigint_free ( m );
+  bigint_free ( f );
+  bigint_free ( n );
+}
+
+static void * multiply_on_thread ( void * arg )
+{
+  BigInt * a = arg;
+  bigint_free ( bigint_multiply ( a, a ) );
+  return NULL;
+}
+
+void test_bigint_stats ( void )
+{
+  BigInt * a = bigint_init ( 1000003 ), * b = bigint_init ( -77 ), * c;
+  BigIntStats s;
+  pthread_t thread;
+  char * json;
+  uint64_t total = 0;
+  int k;
+
+  ASSERT ( strcmp ( bigint_stats_op_name ( BIGINT_OP_MULTIPLY ), "multiply" ) == 0 && bigint_stats_op_name ( BIGINT_OP_COUNT ) == NULL, "wrong op names" );
+
+  bigint_stats_reset ( );
+  c = bigint_multiply ( a, b );
+  bigint_stats_snapshot ( &s );
+  json = bigint_stats_json ( &s );
+
+  if ( !bigint_stats_enabled ( ) )
+  {
+    ASSERT ( s.ops[BIGINT_OP_MULTIPLY].calls == 0 && s.bit_allocs == 0, "disabled stats counted" );
+    ASSERT ( strcmp ( json, "{\"enabled\": false, \"bit_allocs\": 0, \"bit_frees\": 0, \"live_bytes\": 0, \"peak_live_bytes\": 0, \"ops\": {}}" ) == 0, "wrong JSON for disabled stats" );
+  }
+  else
+  {
+    for ( k = 0; k < BIGINT_STATS_BUCKETS; ++ k ) total += s.ops[BIGINT_OP_MULTIPLY].histogram[k];
+
+    ASSERT ( s.ops[BIGINT_OP_MULTIPLY].calls == 1 && s.ops[BIGINT_OP_MULTIPLY].bits == 20 + 7, "multiply not counted" );
+    ASSERT ( total == 1 && s.ops[BIGINT_OP_MULTIPLY].ns > 0, "latency not recorded" );
+    ASSERT ( s.bit_allocs >= (uint64_t)c->count && s.peak_live_bytes >= s.live_bytes, "allocations not counted" );
+    ASSERT ( strstr ( json, "\"multiply\": {\"calls\": 1, \"bits\": 27," ) != NULL, "multiply missing from JSON" );
+
+    // counters of threads that have exited are kept
+    pthread_create ( &thread, NULL, multiply_on_thread, a );
+    pthread_join ( thread, NULL );
+    bigint_stats_snapshot ( &s );
+    ASSERT ( s.ops[BIGINT_OP_MULTIPLY].calls == 2 && s.bit_frees > 0, "exited thread's counters lost" );
+
+    bigint_stats_reset ( );
+    bigint_stats_snapshot ( &s );
+    ASSERT ( s.ops[BIGINT_OP_MULTIPLY].calls == 0 && s.peak_live_bytes == s.live_bytes, "reset failed" );
+  }
+
+  free ( json );
+  bigint_free ( c );
+  bigint_free ( b );
+  bigint_free ( a );
+}
+
+typedef struct _tag_counting
+{
+  uint64_t allocs, frees;
+  int64_t live;
+} Counting;
+
+static void * counting_alloc ( size_t size, void * ctx )
+{
+  Counting * c = ctx;
+  void * p = malloc ( size );
+
+  if ( p )
+  {
+    __atomic_add_fetch ( &c->allocs, 1, __ATOMIC_RELAXED );
+    __atomic_add_fetch ( &c->live, (int64_t)size, __ATOMIC_RELAXED );
+  }
+  return p;
+}
+
+static void * counting_realloc ( void * p, size_t old, size_t size, void * ctx )
+{
+  Counting * c = ctx;
+  void * q = realloc ( p, size );
+
+  if ( q ) __atomic_add_fetch ( &c->live, (int64_t)size - (int64_t)old, __ATOMIC_RELAXED );
+  return q;
+}
+
+static void counting_free ( void * p, size_t size, void * ctx )
+{
+  Counting * c = ctx;
+
+  __atomic_add_fetch ( &c->frees, 1, __ATOMIC_RELAXED );
+  __atomic_sub_fetch ( &c->live, (int64_t)size, __ATOMIC_RELAXED );
+  free ( p );
+}
+
+void test_bigint_memory_functions ( void )
+{
+  Counting counting = { 0, 0, 0 };
+  BigInt * n, * f, * q, * r, * back;
+  BigIntAllocFn alloc;
+  unsigned char * buf;
+  size_t len, base;
+  void * ctx;
+  char * s;
+
+  // the pool's queues outlive the test
+  bigint_set_threads ( 2 );
+  bigint_set_radix_cache_limit ( 0 );
+  base = bigint_memory_in_use ( );
+
+  bigint_set_memory_functions ( counting_alloc, counting_realloc, counting_free, &counting );
+  bigint_get_memory_functions ( &alloc, NULL, NULL, &ctx );
+  ASSERT ( alloc == counting_alloc && ctx == &counting, "memory functions not installed" );
+
+  n = bigint_init ( 300 );
+  f = bigint_factorial ( n );
+  q = bigint_divide ( f, n, &r );
+  s = bigint_tostring_base10 ( f );
+  back = bigint_init_from_string ( s );
+  buf = bigint_export ( f, BIGINT_EXPORT_CHECKSUM, &len );
+
+  ASSERT ( back && bigint_compare ( back, f ) == 0 && r->count == 0, "wrong values with custom memory functions" );
+  ASSERT ( counting.allocs > 0 && counting.live > 0, "memory functions not used" );
+  ASSERT ( bigint_memory_in_use ( ) - base == (size_t)counting.live, "memory in use miscounted" );
+
+  bigint_free_buffer ( buf, len );
+  bigint_free_string ( s );
+  bigint_free ( back );
+  bigint_free ( r );
+  bigint_free ( q );
+  bigint_free ( f );
+  bigint_free ( n );
+
+  ASSERT ( counting.live == 0 && counting.frees > 0, "blocks not released through the free function" );
+  ASSERT ( bigint_memory_in_use ( ) == base, "memory in use not released" );
+}
+
+void test_bigint_memory_limit ( void )
+{
+  Counting counting = { 0, 0, 0 };
+  BigInt * n, * f, * g, * product;
+  int64_t live;
+  char * s, * t;
+  pid_t pid;
+  int status;
+
+  ASSERT ( bigint_set_oom_mode ( BIGINT_OOM_STATUS ) == BIGINT_OOM_EXIT, "default mode does not exit" );
+  ASSERT ( bigint_set_oom_mode ( 7 ) == -1, "unknown mode accepted" );
+
+  bigint_set_memory_functions ( counting_alloc, counting_realloc, counting_free, &counting );
+  bigint_set_threads ( 4 );
+  bigint_set_radix_cache_limit ( 0 );
+
+  // 3000! has about 30000 bits, each a node of a few dozen bytes; the same
+  // work unlimited first lets the pool's queues reach their size
+  n = bigint_init ( 3000 );
+  f = bigint_factorial ( n );
+  product = bigint_multiply ( f, f );
+  s = bigint_tostring_base10 ( f );
+  bigint_free ( product );
+  live = counting.live;
+
+  bigint_set_memory_limit ( bigint_memory_in_use ( ) + 65536 );
+
+  ASSERT ( bigint_factorial ( n ) == NULL && bigint_out_of_memory ( ), "factorial did not fail" );
+  ASSERT ( bigint_multiply ( f, f ) == NULL && bigint_out_of_memory ( ), "parallel multiply did not fail" );
+  ASSERT ( bigint_tostring_base10 ( f ) == NULL && bigint_out_of_memory ( ), "tostring did not fail" );
+  ASSERT ( bigint_init_from_string ( s ) == NULL && bigint_out_of_memory ( ), "parsing did not fail" );
+  ASSERT ( counting.live == live, "failed calls leaked" );
+
+  // an in-place operation keeps a valid value; the copy shares f's bits, so
+  // doubling it must first copy them
+  g = bigint_copy ( f );
+  live = counting.live;
+  bigint_add_in_place ( g, f );
+  ASSERT ( bigint_out_of_memory ( ) && bigint_compare ( g, f ) == 0, "failed addition damaged its operand" );
+  ASSERT ( counting.live == live, "failed addition leaked" );
+  bigint_free ( g );
+
+  ASSERT ( bigint_set_memory_limit ( 0 ) > 0, "limit not reported" );
+
+  g = bigint_factorial ( n );
+  t = bigint_tostring_base10 ( g );
+  ASSERT ( !bigint_out_of_memory ( ) && g && bigint_compare ( g, f ) == 0, "factorial failed without a limit" );
+  ASSERT ( t && strcmp ( t, s ) == 0, "tostring failed without a limit" );
+
+  bigint_free_string ( t );
+  bigint_free_string ( s );
+  bigint_free ( g );
+  bigint_free ( f );
+  bigint_free ( n );
+
+  // by default running out of memory ends the process
+  pid = fork ( );
+  if ( pid == 0 )
+  {
+    bigint_set_oom_mode ( BIGINT_OOM_EXIT );
+    bigint_set_memory_limit ( 1 );
+    bigint_init ( 12345 );
+    _exit ( 0 );
+  }
+  waitpid ( pid, &status, 0 );
+  ASSERT ( WIFEXITED ( status ) && WEXITSTATUS ( status ) == EXIT_FAILURE, "exit mode did not exit" );
+}
+
+void test_bigint_reserve ( void )
+{
+  Counting counting = { 0, 0, 0 };
+  BigInt * a, * one, * b, * c, * p;
+  uint64_t allocs;
+  char * hex;
+  int i;
+
+  bigint_set_memory_functions ( counting_alloc, counting_realloc, counting_free, &counting );
+
+  a = bigint_init_reserve ( 200 );
+  one = bigint_init ( 1 );
+  ASSERT ( a->count == 0 && bigint_capacity ( a ) == 200, "wrong capacity" );
+
+  // counting up to 2^198 stays within the reserve
+  bigint_shift_left ( one, 197 );
+  allocs = counting.allocs;
+  for ( i = 0; i < 2; ++ i ) bigint_add_in_place ( a, one );
+  ASSERT ( counting.allocs == allocs && a->count == 199, "growth allocated" );
+  ASSERT ( bigint_capacity ( a ) == 200, "capacity changed" );
+
+  bigint_shrink_to_fit ( a );
+  ASSERT ( bigint_capacity ( a ) == a->count, "shrink kept spare nodes" );
+
+  // a reserve taken while sharing covers the copy too
+  b = bigint_copy ( a );
+  ASSERT ( bigint_reserve ( b, 300 ) && bigint_capacity ( b ) == 300, "reserve failed" );
+  allocs = counting.allocs;
+  bigint_shift_left ( b, 100 );
+  ASSERT ( counting.allocs == allocs && b->count == 299, "shift allocated" );
+
+  // results come back at their exact size
+  c = bigint_init ( 12345 );
+  p = bigint_multiply ( a, c );
+  ASSERT ( bigint_capacity ( p ) == p->count, "product kept spare nodes" );
+
+  // parsers reserve from the input length, but only once every digit has
+  // been checked: rejecting a long bad string allocates nothing
+  hex = malloc ( 1000001 );
+  memset ( hex, 'f', 1000000 );
+  hex[1000000] = '\0';
+  hex[0] = 'g';
+  allocs = counting.allocs;
+  ASSERT ( bigint_init_from_hex ( hex ) == NULL, "bad first digit accepted" );
+  hex[0] = 'f';
+  hex[999999] = 'g';
+  ASSERT ( bigint_init_from_hex ( hex ) == NULL, "bad last digit accepted" );
+  ASSERT ( bigint_init_from_pow2 ( hex, 4 ) == NULL, "bad pow2 digit accepted" );
+  ASSERT ( counting.allocs == allocs, "rejected input allocated" );
+  free ( hex );
+
+  bigint_free ( p );
+  bigint_free ( c );
+  bigint_free ( b );
+  bigint_free ( one );
+  bigint_free ( a );
+
+  ASSERT ( counting.live == 0, "reserved nodes leaked" );
+}
+
+void test_bigint_sizeinbase ( void )
+{
+  Counting counting = { 0, 0, 0 };
+  BigIntAllocFn alloc;
+  BigIntReallocFn realloc_fn;
+  BigIntFreeFn free_fn;
+  void * ctx;
+  BigInt * x = bigint_init ( 1 ), * ten = bigint_init ( 10 ), * one = bigint_init ( 1 ), * n, * f;
+  char buf[4096], * s;
+  size_t len, size;
+  int i, k;
+
+  ASSERT ( bigint_sizeinbase ( x, 1 ) == 0 && bigint_sizeinbase ( x, 63 ) == 0, "unsupported base accepted" );
+
+  // around each power of ten the estimate is exact or one over, and the
+  // string fits in exactly its own length plus the terminator
+  for ( k = 1; k <= 60; ++ k )
+  {
+    BigInt * t = bigint_multiply ( x, ten );
+    bigint_free ( x );
+    x = t;
+
+    bigint_subtract_in_place ( x, one );
+    for ( i = 0; i < 2; ++ i )
+    {
+      x->positive = i == 0;
+      s = bigint_tostring_base10 ( x );
+      len = strlen ( s );
+      size = bigint_sizeinbase ( x, 10 );
+      ASSERT ( size >= len - !x->positive && size <= len - !x->positive + 1, "decimal size out of range" );
+      ASSERT ( bigint_tostring_base10_into ( x, buf, len ) == 0, "overlong string written" );
+      ASSERT ( bigint_tostring_base10_into ( x, buf, len + 1 ) == len && strcmp ( buf, s ) == 0, "wrong digits written into buffer" );
+      bigint_free_string ( s );
+    }
+    x->positive = true;
+    bigint_add_in_place ( x, one );
+  }
+
+  // 2^100
+  bigint_shift_left ( one, 100 );
+  ASSERT ( bigint_bit_length ( one ) == 101 && bigint_sizeinbase ( one, 16 ) == 26 && bigint_sizeinbase ( one, 2 ) == 101, "power-of-two base not exact" );
+  bigint_free ( x );
+  x = bigint_init ( 0 );
+  ASSERT ( bigint_bit_length ( x ) == 0 && bigint_sizeinbase ( x, 10 ) == 1, "wrong size for zero" );
+  ASSERT ( bigint_tostring_base10_into ( x, buf, 2 ) == 1 && strcmp ( buf, "0" ) == 0, "wrong zero written" );
+
+  n = bigint_init ( 1000 );
+  f = bigint_factorial ( n );
+  s = bigint_tostring_base10 ( f );
+
+  bigint_get_memory_functions ( &alloc, &realloc_fn, &free_fn, &ctx );
+  bigint_set_memory_functions ( counting_alloc, counting_realloc, counting_free, &counting );
+  len = bigint_tostring_base10_into ( f, buf, bigint_sizeinbase ( f, 10 ) + 2 );
+  bigint_set_memory_functions ( alloc, realloc_fn, free_fn, ctx );
+
+  ASSERT ( len == strlen ( s ) && strcmp ( buf, s ) == 0, "wrong digits for 1000!" );
+  ASSERT ( counting.allocs == 0, "writing into a buffer allocated" );
+
+  bigint_free_string ( s );
+  bigint_free ( f );
+  bigint_free ( n );
+  bigint_free ( x );
+  bigint_free ( one );
+  bigint_free ( ten );
+}
+
+///
+/// Checks one modulus against bigint_mulmod(): a*b, a*a, a+b, a-b and a^e
+/// by repeated multiplication, and a round trip through the residue form.
+///
+static void check_modctx ( BigInt const * const m, BigInt const * const a, BigInt const * const b )
+{
+  BigModCtx * ctx = bigint_modctx_new ( m );
+  size_t n = bigint_modctx_limbs ( ctx );
+  uint32_t * scratch = malloc ( bigint_modctx_scratch_limbs ( ctx )*sizeof*scratch );
+  uint32_t * x = malloc ( n*sizeof*x ), * y = malloc ( n*sizeof*y ), * r = malloc ( n*sizeof*r );
+  BigInt * one = bigint_init ( 1 ), * e = bigint_init ( 37 ), * expected, * got, * t;
+  int i;
+
+  bigint_modctx_in ( ctx, x, a, scratch );
+  bigint_modctx_in ( ctx, y, b, scratch );
+
+  got = bigint_modctx_out ( ctx, x, scratch );
+  expected = bigint_mulmod ( a, one, m );
+  ASSERT ( bigint_compare ( got, expected ) == 0, "residue round trip failed" );
+  bigint_free ( got );
+  bigint_free ( expected );
+
+  bigint_modctx_mulmod ( ctx, r, x, y, scratch );
+  got = bigint_modctx_out ( ctx, r, scratch );
+  expected = bigint_mulmod ( a, b, m );
+  ASSERT ( bigint_compare ( got, expected ) == 0, "context mulmod failed" );
+  bigint_free ( got );
+  bigint_free ( expected );
+
+  bigint_modctx_mulmod ( ctx, r, x, x, scratch );
+  bigint_modctx_sqrmod ( ctx, y, x, scratch );
+  ASSERT ( memcmp ( r, y, n*sizeof*r ) == 0, "sqrmod differs from mulmod" );
+  bigint_modctx_in ( ctx, y, b, scratch );
+
+  t = bigint_add ( a, b );
+  bigint_modctx_addmod ( ctx, r, x, y );
+  got = bigint_modctx_out ( ctx, r, scratch );
+  expected = bigint_mulmod ( t, one, m );
+  ASSERT ( bigint_compare ( got, expected ) == 0, "addmod failed" );
+  bigint_free ( got );
+  bigint_free ( expected );
+  bigint_free ( t );
+
+  t = bigint_copy ( a );
+  bigint_subtract_in_place ( t, b );
+  bigint_modctx_submod ( ctx, r, x, y );
+  got = bigint_modctx_out ( ctx, r, scratch );
+  expected = bigint_mulmod ( t, one, m );
+  ASSERT ( bigint_compare ( got, expected ) == 0, "submod failed" );
+  bigint_free ( got );
+  bigint_free ( expected );
+  bigint_free ( t );
+
+  expected = bigint_mulmod ( one, one, m );
+  for ( i = 0; i < 37; ++ i )
+  {
+    t = bigint_mulmod ( expected, a, m );
+    bigint_free ( expected );
+    expected = t;
+  }
+  bigint_modctx_powmod ( ctx, x, x, e, scratch );
+  got = bigint_modctx_out ( ctx, x, scratch );
+  ASSERT ( bigint_compare ( got, expected ) == 0, "powmod failed" );
+  bigint_free ( got );
+  bigint_free ( expected );
+
+  bigint_free ( e );
+  bigint_free ( one );
+  free ( r );
+  free ( y );
+  free ( x );
+  free ( scratch );
+  bigint_modctx_free ( ctx );
+}
+
+void test_bigint_modctx ( void )
+{
+  Counting counting = { 0, 0, 0 };
+  BigIntAllocFn alloc;
+  BigIntReallocFn realloc_fn;
+  BigIntFreeFn free_fn;
+  void * ctx_fn;
+  BigInt * n = bigint_init ( 300 ), * f = bigint_factorial ( n ), * m, * a, * b, * one = bigint_init ( 1 ), * p, * e;
+  BigModCtx * ctx;
+  uint32_t * scratch, * x;
+  int i;
+
+  m = bigint_init ( 0 );
+  ASSERT ( bigint_modctx_new ( m ) == NULL, "zero modulus accepted" );
+  bigint_free ( m );
+
+  // 300!+1 is odd (Montgomery), 300!+2 even (Barrett); single limbs too
+  m = bigint_copy ( f );
+  a = bigint_init ( -123456789 );
+  bigint_shift_left ( a, 700 );
+  b = bigint_copy ( f );
+  bigint_shift_right ( b, 3 );
+  for ( i = 0; i < 2; ++ i )
+  {
+    bigint_add_in_place ( m, one );
+    check_modctx ( m, a, b );
+    check_modctx ( m, b, a );
+  }
+  bigint_free ( m );
+  m = bigint_init ( 1000003 );
+  check_modctx ( m, a, b );
+  bigint_free ( m );
+  m = bigint_init ( 1000000 );
+  check_modctx ( m, a, b );
+  bigint_free ( m );
+
+  // b^(n-1) for n limbs, whose Barrett constant is b^(n+1) and takes n+2
+  // limbs
+  for ( i = 32; i <= 64; i += 32 )
+  {
+    m = bigint_init ( 1 );
+    bigint_shift_left ( m, i );
+    check_modctx ( m, a, b );
+    check_modctx ( m, b, a );
+    bigint_free ( m );
+  }
+
+  // Fermat: a^(p-1) = 1 modulo the prime 2^127-1, with no allocation
+  p = bigint_init ( 1 );
+  bigint_shift_left ( p, 127 );
+  bigint_subtract_in_place ( p, one );
+  e = bigint_copy ( p );
+  bigint_subtract_in_place ( e, one );
+  ctx = bigint_modctx_new ( p );
+  scratch = malloc ( bigint_modctx_scratch_limbs ( ctx )*sizeof*scratch );
+  x = malloc ( bigint_modctx_limbs ( ctx )*sizeof*x );
+
+  bigint_get_memory_functions ( &alloc, &realloc_fn, &free_fn, &ctx_fn );
+  bigint_set_memory_functions ( counting_alloc, counting_realloc, counting_free, &counting );
+  bigint_modctx_in ( ctx, x, b, scratch );
+  bigint_modctx_powmod ( ctx, x, x, e, scratch );
+  bigint_set_memory_functions ( alloc, realloc_fn, free_fn, ctx_fn );
+  ASSERT ( counting.allocs == 0, "context arithmetic allocated" );
+
+  m = bigint_modctx_out ( ctx, x, scratch );
+  ASSERT ( bigint_compare ( m, one ) == 0, "Fermat test failed" );
+
+  free ( x );
+  free ( scratch );
+  bigint_modctx_free ( ctx );
+  bigint_free ( m );
+  bigint_free ( e );
+  bigint_free ( p );
+  bigint_free ( b );
+  bigint_free ( a );
+  bigint_free ( one );
+  bigint_free ( f );
+  bigint_free ( n );
+}
+
+void test_bigint_pow ( void )
+{
+  BigInt * a = bigint_init ( -3 ), * b, * c, * expected;
+  char * str;
+  unsigned long k;
+
+  b = bigint_pow ( a, 0 );
+  ASSERT ( bigint_low_dword ( b ) == 1 && bigint_positive ( b ), "x^0 is not 1" );
+  bigint_free ( b );
+
+  b = bigint_pow ( a, 3 );
+  str = bigint_tostring_base10 ( b );
+  ASSERT ( strcmp ( str, "-27" ) == 0, "negative base to an odd power failed" );
+  bigint_free_string ( str );
+  bigint_free ( b );
+  bigint_free ( a );
+
+  a = bigint_init ( 0 );
+  b = bigint_pow ( a, 5 );
+  ASSERT ( bigint_bit_length ( b ) == 0, "0^5 is not 0" );
+  bigint_free ( b );
+  b = bigint_pow ( a, 0 );
+  ASSERT ( bigint_low_dword ( b ) == 1, "0^0 is not 1" );
+  bigint_free ( b );
+  bigint_free ( a );
+
+  // powers of two are shifts
+  a = bigint_init ( -8 );
+  b = bigint_pow ( a, 41 );
+  c = bigint_init ( -1 );
+  bigint_shift_left ( c, 123 );
+  ASSERT ( bigint_compare ( b, c ) == 0, "power of two base failed" );
+  bigint_free ( c );
+  bigint_free ( b );
+  bigint_free ( a );
+
+  // long enough that the squarings go through Karatsuba
+  a = bigint_init ( 120 );
+  b = bigint_factorial ( a );
+  bigint_free ( a );
+  expected = bigint_init ( 1 );
+  for ( k = 0; k <= 7; ++ k )
+  {
+    c = bigint_pow ( b, k );
+    ASSERT ( bigint_compare ( c, expected ) == 0, "big base power failed" );
+    bigint_free ( c );
+
+    c = bigint_multiply ( expected, b );
+    bigint_swap ( c, expected );
+    bigint_free ( c );
+  }
+  bigint_free ( expected );
+  bigint_free ( b );
+
+  // small bases, through the radix tables and otherwise
+  b = bigint_pow_ui ( 10, 50 );
+  str = bigint_tostring_base10 ( b );
+  ASSERT ( strlen ( str ) == 51 && str[0] == '1' && strspn ( str + 1, "0" ) == 50, "10^50 failed" );
+  bigint_free_string ( str );
+  bigint_free ( b );
+
+  for ( a = bigint_init ( 7 ), expected = bigint_init ( 1 ), k = 0; k < 60; ++ k )
+  {
+    c = bigint_pow_ui ( 7, k );
+    ASSERT ( bigint_compare ( c, expected ) == 0, "cached base power failed" );
+    bigint_free ( c );
+
+    c = bigint_multiply ( expected, a );
+    bigint_swap ( c, expected );
+    bigint_free ( c );
+  }
+  bigint_free ( expected );
+  bigint_free ( a );
+
+  b = bigint_pow_ui ( 1000, 3 );
+  str = bigint_tostring_base10 ( b );
+  ASSERT ( strcmp ( str, "1000000000" ) == 0, "large small base failed" );
+  bigint_free_string ( str );
+  bigint_free ( b );
+
+  b = bigint_pow_ui ( 2, 100 );
+  ASSERT ( bigint_bit_length ( b ) == 101, "2^100 failed" );
+  bigint_free ( b );
+}
+
+void test_bigint_divexact ( void )
+{
+  BigInt * a, * b, * n, * q, * t, * zero = bigint_init ( 0 );
+  int const signs[4][2] = { { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+  int i;
+
+  // an odd part well over a limb and 37 low zero bits
+  t = bigint_init ( 150 );
+  a = bigint_factorial ( t );
+  bigint_free ( t );
+  t = bigint_init ( 12345 );
+  bigint_add_in_place ( a, t );
+  bigint_free ( t );
+  b = bigint_pow_ui ( 3, 100 );
+  bigint_shift_left ( b, 37 );
+  n = bigint_multiply ( a, b );
+
+  for ( i = 0; i < 4; ++ i )
+  {
+    n->positive = signs[i][0] > 0;
+    b->positive = signs[i][1] > 0;
+    q = bigint_divexact ( n, b );
+    a->positive = signs[i][0] == signs[i][1];
+    ASSERT ( q && bigint_compare ( q, a ) == 0, "exact quotient wrong" );
+    bigint_free ( q );
+  }
+  a->positive = b->positive = n->positive = true;
+
+  // a quotient shorter than a limb, and one of zero
+  t = bigint_init ( 5 );
+  bigint_free ( n );
+  n = bigint_multiply ( b, t );
+  q = bigint_divexact ( n, b );
+  ASSERT ( bigint_compare ( q, t ) == 0, "short exact quotient wrong" );
+  bigint_free ( q );
+  bigint_free ( t );
+
+  q = bigint_divexact ( zero, b );
+  ASSERT ( q && bigint_bit_length ( q ) == 0 && bigint_positive ( q ), "0/d is not 0" );
+  bigint_free ( q );
+
+  ASSERT ( bigint_divexact ( n, zero ) == NULL, "division by zero accepted" );
+
+  // C(200,73) against long division
+  bigint_free ( n );
+  bigint_free ( b );
+  bigint_free ( a );
+  t = bigint_init ( 200 );
+  n = bigint_factorial ( t );
+  bigint_free ( t );
+  t = bigint_init ( 73 );
+  a = bigint_factorial ( t );
+  bigint_free ( t );
+  t = bigint_init ( 127 );
+  b = bigint_factorial ( t );
+  bigint_free ( t );
+  t = bigint_multiply ( a, b );
+  q = bigint_divexact ( n, t );
+  bigint_free ( a );
+  a = bigint_divide ( n, t, NULL );
+  ASSERT ( bigint_compare ( q, a ) == 0, "binomial coefficient wrong" );
+
+  bigint_free ( q );
+  bigint_free ( t );
+  bigint_free ( b );
+  bigint_free ( a );
+  bigint_free ( n );
+  bigint_free ( zero );
+}
+
+void test_bigint_multi_powmod ( void )
+{
+  size_t const counts[3] = { 0, 3, 300 };
+  BigInt * bases[300], * exps[300], * m[3], * one = bigint_init ( 1 ), * got, * expected, * t;
+  BigModCtx * ctx;
+  BigIntStats s;
+  uint32_t * scratch, * x;
+  size_t i, j, k;
+
+  // 2^89-1 (odd), 6*(2^89-1) (even) and 2^64, whose Barrett constant
+  // needs an extra limb
+  m[0] = bigint_init ( 1 );
+  bigint_shift_left ( m[0], 89 );
+  bigint_subtract_in_place ( m[0], one );
+  t = bigint_init ( 6 );
+  m[1] = bigint_multiply ( m[0], t );
+  bigint_free ( t );
+  m[2] = bigint_init ( 1 );
+  bigint_shift_left ( m[2], 64 );
+
+  for ( i = 0; i < 300; ++ i )
+  {
+    bases[i] = bigint_init ( (int)( i*104729 + 2 ) );
+    bigint_shift_left ( bases[i], (int)( i % 70 ) );
+    bases[i]->positive = i % 5 != 0;
+    exps[i] = bigint_init ( (int)( i*2654435 + 3 ) );
+    bigint_shift_left ( exps[i], (int)( i % 97 ) );
+  }
+  bigint_free ( exps[7] );
+  exps[7] = bigint_init ( 0 );
+
+  // a short list takes Straus's tables, a long one Pippenger's buckets;
+  // both against separate powers
+  for ( j = 0; j < 3; ++ j )
+  {
+    ctx = bigint_modctx_new ( m[j] );
+    scratch = malloc ( bigint_modctx_scratch_limbs ( ctx )*sizeof*scratch );
+    x = malloc ( bigint_modctx_limbs ( ctx )*sizeof*x );
+
+    for ( k = 0; k < 3; ++ k )
+    {
+      expected = bigint_mulmod ( one, one, m[j] );
+      for ( i = 0; i < counts[k]; ++ i )
+      {
+        bigint_modctx_in ( ctx, x, bases[i], scratch );
+        bigint_modctx_powmod ( ctx, x, x, exps[i], scratch );
+        got = bigint_modctx_out ( ctx, x, scratch );
+        t = bigint_mulmod ( expected, got, m[j] );
+        bigint_free ( got );
+        bigint_free ( expected );
+        expected = t;
+      }
+
+      got = bigint_multi_powmod ( (BigInt const * const *)bases, (BigInt const * const *)exps, counts[k], m[j] );
+      ASSERT ( got && bigint_compare ( got, expected ) == 0, "wrong product of powers" );
+      bigint_free ( got );
+      bigint_free ( expected );
+    }
+
+    free ( x );
+    free ( scratch );
+    bigint_modctx_free ( ctx );
+  }
+
+  // a product of powers is one call of its own op, apart from powmod's
+  bigint_stats_reset ( );
+  got = bigint_multi_powmod ( (BigInt const * const *)bases, (BigInt const * const *)exps, 3, m[0] );
+  bigint_stats_snapshot ( &s );
+  ASSERT ( !bigint_stats_enabled ( ) || ( s.ops[BIGINT_OP_MULTI_POWMOD].calls == 1 && s.ops[BIGINT_OP_POWMOD].calls == 0 ), "product of powers counted as powmod" );
+  bigint_free ( got );
+
+  for ( i = 0; i < 300; ++ i )
+  {
+    bigint_free ( exps[i] );
+    bigint_free ( bases[i] );
+  }
+  bigint_free ( m[2] );
+  bigint_free ( m[1] );
+  bigint_free ( m[0] );
+  bigint_free ( one );
+}
+
+void test_bigint_store ( void )
+{
+  char const * const path = "tests_bignum_store.tmp";
+  BigInt * values[4], * swap;
+  BigIntStore * store;
+  BigInt * n = bigint_init ( 60 );
+  int i;
+
+  values[0] = bigint_init ( 0 );
+  values[1] = bigint_init ( -12345 );
+  values[2] = bigint_factorial ( n );
+  values[3] = bigint_init_from_string ( "18446744073709551616" );
+
+  ASSERT ( bigint_store_write ( path, (BigInt const * const *)values, 4, BIGINT_EXPORT_CHECKSUM ) == 0, "failed to write store" );
+
+  store = bigint_store_open ( path );
+  ASSERT ( store != NULL, "failed to open store" );
+  ASSERT ( bigint_store_count ( store ) == 4, "wrong record count" );
+  ASSERT ( bigint_store_advise ( store, BIGINT_STORE_SEQUENTIAL ) == 0, "madvise failed" );
+
+  for ( i = 0; i < 4; ++ i )
+  {
+    BigInt * b = bigint_store_get ( store, i );
+    ASSERT ( b && bigint_compare ( b, values[i] ) == 0, "wrong value read back from store" );
+    bigint_free ( b );
+  }
+
+  ASSERT ( bigint_store_get ( store, 4 ) == NULL, "read past the end of the store" );
+
+  // replacing the file leaves an open store reading what it mapped
+  bigint_free ( n );
+  n = bigint_init ( 3000 );
+  swap = values[2];
+  values[2] = bigint_factorial ( n );
+  ASSERT ( bigint_store_write ( path, (BigInt const * const *)values + 1, 2, 0 ) == 0, "failed to replace store" );
+  bigint_free ( values[2] );
+  values[2] = swap;
+
+  for ( i = 0; i < 4; ++ i )
+  {
+    BigInt * b = bigint_store_get ( store, i );
+    ASSERT ( b && bigint_compare ( b, values[i] ) == 0, "open store changed by a rewrite" );
+    bigint_free ( b );
+  }
+  bigint_store_close ( store );
+
+  store = bigint_store_open ( path );
+  ASSERT ( store && bigint_store_count ( store ) == 2, "replaced store not read back" );
+  bigint_store_close ( store );
+  remove ( path );
+
+  ASSERT ( bigint_store_open ( path ) == NULL, "opened a missing store" );
+
+  for ( i = 0; i < 4; ++ i ) bigint_free ( values[i] );
+  bigint_free ( n );
+}
+
 void test_factorial ( void )
 {
   BigInt * a = bigint_init ( 20 );
@@ -875,13 +2413,20 @@ void do_tests ( void )
   TEST ( test_bigint_add_in_place );
   TEST ( test_bigint_add );
   TEST ( test_bigint_copy );
+  TEST ( test_bigint_copy_on_write );
   TEST ( test_bigint_pop );
   TEST ( test_bigint_shift );
   TEST ( test_bigint_multiply );
+  TEST ( test_bigint_multiply_karatsuba );
+  TEST ( test_bigint_multiply_parallel );
+  TEST ( test_bigint_addmul );
   TEST ( test_single_bit_subtract_in_place );
   TEST ( test_single_bit_add_in_place );
   TEST ( test_bigint_subtract );
   TEST ( test_bigint_from_string );
+  TEST ( test_bigint_parser );
+  TEST ( test_bigint_pow2_radix );
+  TEST ( test_bigint_radix );
   TEST ( test_walk_toward_msb );
   TEST ( test_bigint_divide );
   TEST ( test_reverse_bits );
@@ -891,7 +2436,25 @@ void do_tests ( void )
   TEST ( test_append );
   TEST ( test_bigint_remove_high_zeroes );
   TEST ( test_bigint_tostring_base10 );
+  TEST ( test_bigint_write_base10 );
   TEST ( test_bigint_modulo );
   TEST ( test_factorial );
+  TEST ( test_bigint_product_list );
+  TEST ( test_bigint_invmod );
+  TEST ( test_bigint_invmod_batch );
+  TEST ( test_bigint_mod_many );
+  TEST ( test_bigint_export_import );
+  TEST ( test_bigint_store );
+  TEST ( test_bigint_cpu_dispatch );
+  TEST ( test_bigint_cpu_override );
+  TEST ( test_bigint_stats );
+  TEST ( test_bigint_memory_functions );
+  TEST ( test_bigint_memory_limit );
+  TEST ( test_bigint_reserve );
+  TEST ( test_bigint_sizeinbase );
+  TEST ( test_bigint_modctx );
+  TEST ( test_bigint_multi_powmod );
+  TEST ( test_bigint_pow );
+  TEST ( test_bigint_divexact );
 }
 
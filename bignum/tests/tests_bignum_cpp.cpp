@@ -0,0 +1,218 @@
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+#include "bignum.hpp"
+#include "bignum_fixed.hpp"
+
+extern "C"
+{
+#include "tests.h"
+}
+
+using bignum::FixedInt;
+using bignum::Int;
+using bignum::UInt256;
+
+static_assert ( std::is_nothrow_move_constructible<Int>::value, "Int moves must not throw" );
+static_assert ( std::is_nothrow_move_assignable<Int>::value, "Int moves must not throw" );
+
+static void test_int_arithmetic ( void )
+{
+  Int a ( "123456789012345678901234567890" ), b = -987654321;
+  Int c = a * b;
+
+  ASSERT ( c.str ( ) == "-121932631124828532112482853211126352690", "product failed" );
+  ASSERT ( c / b == a, "quotient failed" );
+  ASSERT ( ( c - 7 ) % b == -7 && ( -c + 7 ) % b == 7, "remainder sign does not follow the dividend" );
+  ASSERT ( Int ( -7 ) / 2 == -3 && Int ( 7 ) / -2 == -3, "division does not truncate toward zero" );
+
+  c += a;
+  c -= a;
+  ASSERT ( c == a * b, "compound add/subtract failed" );
+
+  a += a;
+  ASSERT ( a == Int ( "246913578024691357802469135780" ), "self add failed" );
+
+  ASSERT ( ( Int ( 5 ) << 100 ) >> 100 == 5, "shift failed" );
+  ASSERT ( Int ( 0 ) == -Int ( 0 ) && !Int ( 0 ) && Int ( 1 ), "zero handling failed" );
+
+  bool threw = false;
+  try { c /= 0; } catch ( std::domain_error const & ) { threw = true; }
+  ASSERT ( threw, "division by zero did not throw" );
+}
+
+static void test_int_ownership ( void )
+{
+  Int a ( "-0xdeadbeefcafe", 0 ), b ( a ), c;
+  BigInt const * storage = a.get ( );
+
+  // copies share bits until written
+  ASSERT ( b.get ( )->lsb == storage->lsb, "copy did not share its bits" );
+  ++ b;
+  ASSERT ( a.str ( 16 ) == "-deadbeefcafe" && b.str ( 16 ) == "-deadbeefcafd", "copy not independent" );
+
+  c = std::move ( a );
+  ASSERT ( c.get ( ) == storage && a == 0, "move did not transfer ownership" );
+
+  BigInt * raw = c.release ( );
+  ASSERT ( raw == storage && c == 0, "release failed" );
+  c = Int::adopt ( raw );
+  ASSERT ( c < b && b > c && c <= c && c != b, "comparison failed" );
+
+  bool threw = false;
+  try { Int bad ( std::string_view ( "12x" ) ); } catch ( std::invalid_argument const & ) { threw = true; }
+  ASSERT ( threw, "malformed text did not throw" );
+
+  threw = false;
+  try { Int bad ( "0x", 0 ); } catch ( std::invalid_argument const & ) { threw = true; }
+  ASSERT ( threw, "bare prefix did not throw" );
+}
+
+static void test_int_conversions ( void )
+{
+  std::string text = "31415926535897932384626433832795028841971";
+  std::string_view view ( text );
+  Int a ( view.substr ( 0, 20 ) ), b ( text, 10 );
+  std::ostringstream out;
+  std::unordered_set<Int> seen;
+
+  ASSERT ( a == Int ( "31415926535897932384" ), "string_view parse failed" );
+  ASSERT ( static_cast<std::string> ( b ) == text && bignum::to_string ( -b ) == "-" + text, "string conversion failed" );
+  ASSERT ( Int ( b.str ( 62 ), 62 ) == b, "base 62 round trip failed" );
+
+  out << std::hex << Int ( 48879 ) << ' ' << std::dec << Int ( -42 );
+  ASSERT ( out.str ( ) == "beef -42", "stream output failed" );
+
+  seen.insert ( b );
+  seen.insert ( Int ( text ) );
+  seen.insert ( b + 1 - 1 );
+  seen.insert ( -b );
+  ASSERT ( seen.size ( ) == 2, "hash does not follow value" );
+  ASSERT ( std::hash<Int> { } ( Int ( 0 ) ) == std::hash<Int> { } ( -Int ( 0 ) ), "zero hashes differ" );
+
+#ifdef BIGNUM_HAS_SPACESHIP
+  ASSERT ( ( a <=> b ) < 0 && ( b <=> b ) == 0, "three-way comparison failed" );
+#endif
+}
+
+static void test_int_expressions ( void )
+{
+  Int a ( "340282366920938463463374607431768211507" ), b ( "-18446744073709551557" );
+  Int c ( "99999999999999999999" ), d = 12345, m ( "1000000007" ), r;
+  Int ab ( a ), cd ( c );
+
+  ab *= b;
+  cd *= d;
+
+  r = a*b + c;
+  ASSERT ( r == ab + c, "a*b + c failed" );
+  r = c - a*b;
+  ASSERT ( r == c - ab, "c - a*b failed" );
+  r = a*b - c;
+  ASSERT ( r == ab - c, "a*b - c failed" );
+  r = a*b + c*d;
+  ASSERT ( r == ab + cd, "a*b + c*d failed" );
+  r = a*b - c*d;
+  ASSERT ( r == ab - cd, "a*b - c*d failed" );
+
+  // the destination may also be an operand
+  r = c;
+  r = r*d + r;
+  ASSERT ( r == cd + c, "aliased accumulate failed" );
+  r = c;
+  r = a*b + r;
+  ASSERT ( r == ab + c, "in-place accumulate failed" );
+
+  r = c;
+  r += a*b;
+  ASSERT ( r == ab + c, "+= a*b failed" );
+  r -= c*d;
+  ASSERT ( r == ab + c - cd, "-= c*d failed" );
+
+  r = ( a*b ) % m;
+  ASSERT ( r == ab % m && r < 0, "(a*b) % m failed" );
+  r = ( a*a ) % m;
+  ASSERT ( r == Int ( a*a ) % m && r > 0, "(a*a) % m failed" );
+
+  Int e = a*b + c;
+  ASSERT ( e == ab + c && -(a*b) == -ab, "expression construction failed" );
+}
+
+// the fixed-width type is usable in constant expressions
+constexpr UInt256 p256 = UInt256::parse ( "0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff" );
+constexpr UInt256 ten19 = UInt256::parse ( "10000000000000000000" );
+
+static_assert ( p256.word ( 3 ) == 0xffffffff00000001u && p256.word ( 0 ) == ~(uint64_t)0, "constexpr parse failed" );
+static_assert ( p256 + 1 - 1 == p256 && UInt256 ( 0 ) - 1 == ~UInt256 ( ), "constexpr add/sub failed" );
+static_assert ( ten19 * ten19 / ten19 == ten19 && ( ten19 * ten19 ).bit_length ( ) == 127, "constexpr mul/div failed" );
+static_assert ( p256 % ten19 == UInt256::parse ( "3631308867097853951" ), "constexpr remainder failed" );
+static_assert ( ( UInt256 ( 1 ) << 255 ) >> 255 == 1 && ( UInt256 ( 1 ) << 256 ).is_zero ( ), "constexpr shift failed" );
+static_assert ( FixedInt<70> ( 1 ) << 69 < ( FixedInt<70> ( 3 ) << 68 ) && ( FixedInt<70> ( 1 ) << 70 ) == 0, "odd width failed" );
+
+static void test_fixed_int ( void )
+{
+  Int big ( "115792089210356248762697446949407573530086143415290314195533631308867097853951" );
+  UInt256 p ( big ), q, r;
+
+  ASSERT ( p == p256 && p.to_int ( ) == big, "conversion from Int failed" );
+  ASSERT ( UInt256 ( -Int ( 1 ) ) == ~UInt256 ( ) && UInt256 ( big << 1 ) == p << 1, "conversion does not wrap" );
+
+  UInt256::divmod ( p, ten19, q, r );
+  ASSERT ( Int ( q ) == big / Int ( ten19 ) && Int ( r ) == big % Int ( ten19 ), "divmod disagrees with Int" );
+  ASSERT ( ( p * p ).str ( ) == Int ( big * big % ( Int ( 1 ) << 256 ) ).str ( ), "wrapping product disagrees with Int" );
+  ASSERT ( ( ~UInt256 ( ) / p ) == 1 && ( ~UInt256 ( ) % p ) == ~UInt256 ( ) - p, "division with the top bit set failed" );
+  ASSERT ( UInt256 ( ).to_int ( ) == 0 && p.str ( 16 ) == "ffffffff00000001000000000000000000000000ffffffffffffffffffffffff", "formatting failed" );
+
+  bool threw = false;
+  try { p /= UInt256 ( ); } catch ( std::domain_error const & ) { threw = true; }
+  ASSERT ( threw, "division by zero did not throw" );
+}
+
+static void test_int_out_of_memory ( void )
+{
+  Int a = Int ( 1 ) << 20000, b;
+  bool threw = false;
+
+  bigint_set_oom_mode ( BIGINT_OOM_STATUS );
+  bigint_set_memory_limit ( bigint_memory_in_use ( ) + 65536 );
+
+  try { b = a * a; } catch ( std::bad_alloc const & ) { threw = true; }
+  ASSERT ( threw && b == 0, "running out of memory did not throw" );
+
+  bigint_set_memory_limit ( 0 );
+  b = a * a;
+  ASSERT ( b == Int ( 1 ) << 40000, "product failed after the limit was lifted" );
+}
+
+static void test_fixed_int_out_of_memory ( void )
+{
+  UInt256 x = UInt256::parse ( "0xfedcba9876543210fedcba9876543210" );
+  Int y;
+  bool threw = false;
+
+  bigint_set_oom_mode ( BIGINT_OOM_STATUS );
+  bigint_set_memory_limit ( bigint_memory_in_use ( ) + 1 );
+
+  try { y = x.to_int ( ); } catch ( std::bad_alloc const & ) { threw = true; }
+
+  bigint_set_memory_limit ( 0 );
+  ASSERT ( threw && y == 0, "converting out of memory did not throw" );
+
+  y = x.to_int ( );
+  ASSERT ( y.str ( 16 ) == "fedcba9876543210fedcba9876543210", "conversion failed after the limit was lifted" );
+}
+
+void do_tests ( void )
+{
+  TEST ( test_int_arithmetic );
+  TEST ( test_int_ownership );
+  TEST ( test_int_conversions );
+  TEST ( test_int_expressions );
+  TEST ( test_fixed_int );
+  TEST ( test_int_out_of_memory );
+  TEST ( test_fixed_int_out_of_memory );
+}
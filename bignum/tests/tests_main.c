@@ -64,7 +64,7 @@ void test_failed ( char * message )
   exit(1);
 }
 
-int execute_test ( char * test_name, void(*test_func)(void) )
+int execute_test ( char const * test_name, void(*test_func)(void) )
 {
   if ( 0 != pipe(pipefd) )
   {